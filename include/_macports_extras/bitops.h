@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _MACPORTS_BITOPS_H_
+#define _MACPORTS_BITOPS_H_
+
+/*
+ * This header selects the implementation of the ffs/fls family at compile
+ * time.  It's used both by the library implementations and by strings.h.
+ *
+ * When the compiler provides __builtin_ctz and __builtin_clz (gcc 3.4+, or
+ * any clang), __MPLS_HAVE_BITOPS_BUILTINS is nonzero, and the __MPLS_FFS_*
+ * and __MPLS_FLS_* helpers are defined in terms of them.  Otherwise, the
+ * library uses its portable loops, and no helpers are defined.
+ *
+ * When the compiler additionally supports the gnu_inline attribute (gcc 4.2+
+ * for C, gcc 4.3+ for C++, or any clang), __MPLS_INLINE_BITOPS is nonzero,
+ * and strings.h provides "extern inline" definitions of the functions
+ * supplied by the library.  These are used only for inlining; the library
+ * still provides the out-of-line versions, e.g. for taking the address.
+ * Defining _MACPORTS_LEGACY_DISABLE_INLINE_BITOPS as nonzero suppresses the
+ * inline versions.
+ */
+
+#if defined(__clang__) \
+    || (defined(__GNUC__) \
+        && (__GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4)))
+#define __MPLS_HAVE_BITOPS_BUILTINS 1
+#else
+#define __MPLS_HAVE_BITOPS_BUILTINS 0
+#endif
+
+#if __MPLS_HAVE_BITOPS_BUILTINS
+
+#if defined(__clang__) \
+    || (defined(__cplusplus) \
+        && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 3))) \
+    || (!defined(__cplusplus) \
+        && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 2)))
+#define __MPLS_HAVE_GNU_INLINE 1
+#else
+#define __MPLS_HAVE_GNU_INLINE 0
+#endif
+
+/*
+ * The helpers are macros rather than static functions, since C99 doesn't
+ * allow a non-static inline function to reference a static function.  They
+ * evaluate their argument more than once, and expect it to be an unsigned
+ * type of the appropriate size.  All return the 1-based bit index, or 0 for
+ * a zero mask.
+ */
+
+#define __MPLS_FFS_UL(m)  ((m) ? __builtin_ctzl(m) + 1 : 0)
+#define __MPLS_FFS_ULL(m) ((m) ? __builtin_ctzll(m) + 1 : 0)
+#define __MPLS_FLS_U(m)   ((m) ? (int) sizeof(m) * 8 - __builtin_clz(m) : 0)
+#define __MPLS_FLS_UL(m)  ((m) ? (int) sizeof(m) * 8 - __builtin_clzl(m) : 0)
+#define __MPLS_FLS_ULL(m) ((m) ? (int) sizeof(m) * 8 - __builtin_clzll(m) : 0)
+
+#else /* !__MPLS_HAVE_BITOPS_BUILTINS */
+
+#define __MPLS_HAVE_GNU_INLINE 0
+
+#endif /* !__MPLS_HAVE_BITOPS_BUILTINS */
+
+#if __MPLS_HAVE_GNU_INLINE \
+    && !(defined(_MACPORTS_LEGACY_DISABLE_INLINE_BITOPS) \
+         && _MACPORTS_LEGACY_DISABLE_INLINE_BITOPS)
+#define __MPLS_INLINE_BITOPS 1
+#define __MPLS_BITOPS_INLINE \
+    extern __inline__ __attribute__((__gnu_inline__, __always_inline__))
+#else
+#define __MPLS_INLINE_BITOPS 0
+#endif
+
+#endif /* _MACPORTS_BITOPS_H_ */
@@ -55,6 +55,19 @@ extern int dprintf(int fd, const char * __restrict format, ...);
 extern int vdprintf(int fd, const char * __restrict format, va_list ap);
 __MP__END_DECLS
 
+/*
+ * Legacy-support extension: like dprintf() and vdprintf(), but the whole
+ * message is formatted before any output, and written with a single
+ * write() where possible, so messages up to PIPE_BUF bytes written to a
+ * pipe or FIFO are never interleaved with other writers.  Nothing is
+ * written if formatting fails.
+ */
+__MP__BEGIN_DECLS
+extern int dprintf_atomic(int fd, const char * __restrict format, ...);
+extern int vdprintf_atomic(int fd, const char * __restrict format,
+                           va_list ap);
+__MP__END_DECLS
+
 #endif /* __MPLS_SDK_SUPPORT_DPRINTF__ */
 
 /* getline */
@@ -79,6 +92,18 @@ extern ssize_t getdelim(char **lineptr, size_t *n, int delimiter, FILE *fp);
 extern ssize_t getline (char **lineptr, size_t *n, FILE *stream);
 __MP__END_DECLS
 
+/*
+ * Legacy-support extension: return the next line (including any delimiter)
+ * from 'fp' in '*start' and '*len', without copying it when it's entirely
+ * within the stream buffer.  The line is not NUL-terminated, and is valid
+ * until the next operation on the stream or the next call in the same
+ * thread.  Returns 0 on success, or -1 on error or EOF.
+ */
+__MP__BEGIN_DECLS
+extern int getdelim_view(FILE *fp, int delimiter, const char **start,
+                         size_t *len);
+__MP__END_DECLS
+
 #endif /*  __MPLS_SDK_SUPPORT_GETLINE__ */
 
 /* open_memstream */
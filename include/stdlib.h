@@ -86,6 +86,29 @@ __MP__BEGIN_DECLS
 extern void arc4random_buf( void* buf, size_t n );
 __MP__END_DECLS
 
+/*
+ * Legacy-support extension: fill 'out' with 'n' uniformly random values
+ * less than 'upper_bound'.
+ */
+__MP__BEGIN_DECLS
+extern void arc4random_uniform_buf( uint32_t upper_bound, uint32_t *out,
+                                    size_t n );
+__MP__END_DECLS
+
+/*
+ * Legacy-support extension: per-thread counters of key replacements,
+ * reseeds from the entropy source, and bytes returned.
+ */
+struct arc4random_stats_np {
+  unsigned long long rekeys;
+  unsigned long long stirs;
+  unsigned long long bytes;
+};
+
+__MP__BEGIN_DECLS
+extern void arc4random_stats_np( struct arc4random_stats_np *stats );
+__MP__END_DECLS
+
 #endif /*  __MPLS_SDK_SUPPORT_ARC4RANDOM__ */
 
 #endif /* _MACPORTS_STDLIB_H_ */
@@ -26,6 +26,9 @@
 /* Include the primary system strings.h */
 #include_next <strings.h>
 
+/* Compile-time selection of ffs/fls implementations */
+#include <_macports_extras/bitops.h>
+
 /* Darwin extensions */
 #if __DARWIN_C_LEVEL >= __DARWIN_C_FULL
 
@@ -33,6 +36,14 @@
 #if __MPLS_SDK_SUPPORT_FFSL__
 __MP__BEGIN_DECLS
 extern int ffsl(long int);
+#if __MPLS_INLINE_BITOPS
+__MPLS_BITOPS_INLINE int
+ffsl(long int __mask)
+{
+  unsigned long __umask = (unsigned long) __mask;
+  return __MPLS_FFS_UL(__umask);
+}
+#endif
 __MP__END_DECLS
 #endif
 
@@ -40,6 +51,14 @@ __MP__END_DECLS
 #if __MPLS_SDK_SUPPORT_FFSLL__
 __MP__BEGIN_DECLS
 extern int ffsll(long long int);
+#if __MPLS_INLINE_BITOPS
+__MPLS_BITOPS_INLINE int
+ffsll(long long int __mask)
+{
+  unsigned long long __umask = (unsigned long long) __mask;
+  return __MPLS_FFS_ULL(__umask);
+}
+#endif
 __MP__END_DECLS
 #endif
 
@@ -47,6 +66,14 @@ __MP__END_DECLS
 #if __MPLS_SDK_SUPPORT_FLS__
 __MP__BEGIN_DECLS
 extern int fls(int);
+#if __MPLS_INLINE_BITOPS
+__MPLS_BITOPS_INLINE int
+fls(int __mask)
+{
+  unsigned int __umask = (unsigned int) __mask;
+  return __MPLS_FLS_U(__umask);
+}
+#endif
 __MP__END_DECLS
 #endif
 
@@ -54,6 +81,14 @@ __MP__END_DECLS
 #if __MPLS_SDK_SUPPORT_FLSL__
 __MP__BEGIN_DECLS
 extern int flsl(long int);
+#if __MPLS_INLINE_BITOPS
+__MPLS_BITOPS_INLINE int
+flsl(long int __mask)
+{
+  unsigned long __umask = (unsigned long) __mask;
+  return __MPLS_FLS_UL(__umask);
+}
+#endif
 __MP__END_DECLS
 #endif
 
@@ -61,6 +96,14 @@ __MP__END_DECLS
 #if __MPLS_SDK_SUPPORT_FLSLL__
 __MP__BEGIN_DECLS
 extern int flsll(long long int);
+#if __MPLS_INLINE_BITOPS
+__MPLS_BITOPS_INLINE int
+flsll(long long int __mask)
+{
+  unsigned long long __umask = (unsigned long long) __mask;
+  return __MPLS_FLS_ULL(__umask);
+}
+#endif
 __MP__END_DECLS
 #endif
 
@@ -69,6 +69,12 @@ _CLOCK_UPTIME_RAW = 8,
 #define CLOCK_UPTIME_RAW _CLOCK_UPTIME_RAW
 _CLOCK_UPTIME_RAW_APPROX = 9,
 #define CLOCK_UPTIME_RAW_APPROX _CLOCK_UPTIME_RAW_APPROX
+
+/* Legacy-support extension: see clock_coarse_start_np() */
+_CLOCK_REALTIME_COARSE = 32,
+#define CLOCK_REALTIME_COARSE _CLOCK_REALTIME_COARSE
+_CLOCK_MONOTONIC_COARSE = 33,
+#define CLOCK_MONOTONIC_COARSE _CLOCK_MONOTONIC_COARSE
 #endif /* !defined(_POSIX_C_SOURCE) || defined(_DARWIN_C_SOURCE) */
 
 _CLOCK_PROCESS_CPUTIME_ID = 12,
@@ -84,6 +90,26 @@ extern int clock_getres ( clockid_t clk_id, struct timespec *ts );
 
 #if !defined(_POSIX_C_SOURCE) || defined(_DARWIN_C_SOURCE)
 __uint64_t clock_gettime_nsec_np(clockid_t __clock_id);
+
+/*
+ * Legacy-support extension: reads the count clocks in clk_ids as nearly
+ * simultaneously as possible, storing nanosecond values (as from
+ * clock_gettime_nsec_np()) in nanos.  If window is not NULL, it receives
+ * the span in nanoseconds within which all the readings were taken.
+ * Returns 0, or -1 with errno set if any clock failed (with a zero value
+ * for that clock).
+ */
+extern int clock_sample_np(int count, const clockid_t *clk_ids,
+                           __uint64_t *nanos, __uint64_t *window);
+
+/*
+ * Legacy-support extension: starts a helper thread which updates the
+ * CLOCK_REALTIME_COARSE and CLOCK_MONOTONIC_COARSE values every interval_ms
+ * milliseconds (at most 1000), so that reading them is just a load, or
+ * stops it if interval_ms is zero.  Without the helper thread, they're
+ * read directly from the precise clocks.  Returns 0, or -1 with errno set.
+ */
+extern int clock_coarse_start_np(unsigned int interval_ms);
 #endif
 
 extern int clock_settime(clockid_t clk_id, const struct timespec *ts);
@@ -55,6 +55,11 @@ __MP__BEGIN_DECLS
   extern int wcsncasecmp(const wchar_t *l, const wchar_t *r, size_t n);
 #endif
 
+/* open_wmemstream */
+#if __MPLS_SDK_SUPPORT_OPEN_MEMSTREAM__
+  extern FILE *open_wmemstream(wchar_t **ptr, size_t *sizeloc);
+#endif
+
 __MP__END_DECLS
 
 #endif /* __DARWIN_C_LEVEL >= 200809L */
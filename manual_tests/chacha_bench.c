@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Check and benchmark for the ChaCha keystream used by arc4random.
+ *
+ * This includes the private ChaCha source directly, and doesn't use the
+ * library.  It verifies that the multi-block keystream (if any) is identical
+ * to the scalar keystream for a variety of lengths and counter values
+ * (including the 32-bit counter carry), and then reports the throughput of
+ * each in MB/s.
+ *
+ * Usage: chacha_bench [-v] [<MB per run>]
+ */
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "../src/chacha_private.h"
+
+#define MAXLEN   4096
+#define DEF_MB   64
+#define BENCHBUF 1024   /* Same as arc4random's buffer */
+
+static const u32 ctr_starts[] = {
+  0, 1, 0xFFFFFFFDU, 0xFFFFFFFEU, 0xFFFFFFFFU,
+};
+
+static void
+setup_ctx(chacha_ctx *ctx, u32 ctr)
+{
+  u8 keyiv[32 + 8];
+  int i;
+
+  for (i = 0; i < (int) sizeof(keyiv); ++i) keyiv[i] = i * 7 + 3;
+  _chacha_keysetup(ctx, keyiv, 256, 0);
+  _chacha_ivsetup(ctx, keyiv + 32);
+  ctx->input[12] = ctr;
+}
+
+/* Compare keystream generators over all lengths and counter starts */
+static int
+check_same(int verbose)
+{
+  static u8 sbuf[MAXLEN], vbuf[MAXLEN];
+  chacha_ctx sctx, vctx;
+  size_t len;
+  int ci, errs = 0;
+
+  for (ci = 0; ci < (int) (sizeof(ctr_starts) / sizeof(ctr_starts[0])); ++ci) {
+    for (len = 0; len <= MAXLEN; ++len) {
+      setup_ctx(&sctx, ctr_starts[ci]);
+      setup_ctx(&vctx, ctr_starts[ci]);
+      memset(sbuf, 0, sizeof(sbuf)); memset(vbuf, 0, sizeof(vbuf));
+      _chacha_encrypt_bytes(&sctx, sbuf, sbuf, len);
+      _chacha_keystream(&vctx, vbuf, len);
+      if (memcmp(sbuf, vbuf, sizeof(sbuf))
+          || memcmp(&sctx, &vctx, sizeof(sctx))) {
+        if (verbose || !errs) {
+          printf("  Mismatch at length %d, counter start 0x%08X\n",
+                 (int) len, ctr_starts[ci]);
+        }
+        ++errs;
+      }
+    }
+  }
+  return errs;
+}
+
+static double
+now_secs(void)
+{
+  struct timeval tv;
+
+  (void) gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static double
+bench(int simd, size_t total)
+{
+  static u8 buf[BENCHBUF];
+  chacha_ctx ctx;
+  size_t done;
+  double start, elapsed;
+
+  setup_ctx(&ctx, 0);
+  start = now_secs();
+  for (done = 0; done < total; done += sizeof(buf)) {
+    if (simd) {
+      _chacha_keystream(&ctx, buf, sizeof(buf));
+    } else {
+      _chacha_encrypt_bytes(&ctx, buf, buf, sizeof(buf));
+    }
+  }
+  elapsed = now_secs() - start;
+  return elapsed > 0 ? total / elapsed / 1e6 : 0.0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int argn = 1, verbose = 0, errs;
+  long mb = DEF_MB;
+  char *progname = basename(argv[0]);
+  double scalar, multi;
+
+  if (argn < argc && !strcmp(argv[argn], "-v")) {
+    verbose = 1; ++argn;
+  }
+  if (argn < argc) mb = atol(argv[argn]);
+  if (mb <= 0) mb = DEF_MB;
+
+#ifdef CHACHA_SSE2
+  if (verbose) printf("  Multi-block engine is SSE2, %d blocks\n",
+                      CHACHA_PAR_BLOCKS);
+#else
+  if (verbose) printf("  No multi-block engine (scalar only)\n");
+#endif
+
+  errs = check_same(verbose);
+  if (verbose) {
+    printf("  Keystream comparison %s (%d errors)\n",
+           errs ? "failed" : "passed", errs);
+  }
+
+  scalar = bench(0, mb << 20);
+  multi = bench(1, mb << 20);
+  printf("  scalar: %8.1f MB/s, keystream: %8.1f MB/s, speedup %.2f\n",
+         scalar, multi, scalar > 0 ? multi / scalar : 0.0);
+
+  printf("%s %s.\n", progname, errs ? "failed" : "succeeded");
+  return errs ? 1 : 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Multithreaded microbenchmark for the arc4random per-thread state.
+ *
+ * For thread counts from 1 to 64 (doubling), each thread makes the same
+ * number of small arc4random calls, after one untimed warmup call to set
+ * up its state.  The report gives the mean ns per call as seen by each
+ * thread, and the aggregate ns per call (wall time / total calls).  Since
+ * the library only supplies arc4random_uniform() and arc4random_buf() (the
+ * OS supplies arc4random() itself), those are what's measured.
+ *
+ * Usage: libtest_arc4random_threads [-v] [<calls per thread>]
+ */
+
+#include <libgen.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define DEF_CALLS   1000000
+#define MAX_THREADS 64
+
+typedef struct thread_arg_s {
+  int uniform;
+  long calls;
+  double nsecs;
+  volatile uint32_t sink;
+} thread_arg_t;
+
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static int started;
+
+static double
+now_ns(void)
+{
+  struct timeval tv;
+
+  (void) gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1e9 + tv.tv_usec * 1e3;
+}
+
+static void *
+worker(void *varg)
+{
+  thread_arg_t *arg = (thread_arg_t *) varg;
+  long n;
+  uint32_t val, sum = 0;
+  double start;
+
+  /* Set up the state outside the timed loop */
+  arc4random_buf(&val, sizeof(val));
+
+  (void) pthread_mutex_lock(&start_lock);
+  while (!started) (void) pthread_cond_wait(&start_cond, &start_lock);
+  (void) pthread_mutex_unlock(&start_lock);
+
+  start = now_ns();
+  if (arg->uniform) {
+    for (n = 0; n < arg->calls; ++n) sum += arc4random_uniform(1000);
+  } else {
+    for (n = 0; n < arg->calls; ++n) {
+      arc4random_buf(&val, sizeof(val));
+      sum += val;
+    }
+  }
+  arg->nsecs = now_ns() - start;
+  arg->sink = sum;
+  return NULL;
+}
+
+static int
+run(int nthreads, int uniform, long calls)
+{
+  pthread_t threads[MAX_THREADS];
+  thread_arg_t args[MAX_THREADS];
+  int i;
+  double start, wall, per_thread = 0.0;
+
+  started = 0;
+  for (i = 0; i < nthreads; ++i) {
+    args[i].uniform = uniform;
+    args[i].calls = calls;
+    if (pthread_create(&threads[i], NULL, worker, &args[i])) {
+      perror("pthread_create");
+      return 1;
+    }
+  }
+  start = now_ns();
+  (void) pthread_mutex_lock(&start_lock);
+  started = 1;
+  (void) pthread_cond_broadcast(&start_cond);
+  (void) pthread_mutex_unlock(&start_lock);
+  for (i = 0; i < nthreads; ++i) {
+    (void) pthread_join(threads[i], NULL);
+    per_thread += args[i].nsecs;
+  }
+  wall = now_ns() - start;
+
+  printf("  %-20s %3d threads: %7.2f ns/call per thread, "
+         "%7.2f ns/call aggregate\n",
+         uniform ? "arc4random_uniform" : "arc4random_buf(4)", nthreads,
+         per_thread / ((double) nthreads * calls),
+         wall / ((double) nthreads * calls));
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int argn = 1, verbose = 0, nthreads, err = 0;
+  long calls = DEF_CALLS;
+  char *progname = basename(argv[0]);
+
+  if (argn < argc && !strcmp(argv[argn], "-v")) {
+    verbose = 1; ++argn;
+  }
+  if (argn < argc) calls = atol(argv[argn]);
+  if (calls <= 0) calls = DEF_CALLS;
+
+  if (verbose) printf("%s started, %ld calls per thread\n", progname, calls);
+
+  for (nthreads = 1; !err && nthreads <= MAX_THREADS; nthreads *= 2) {
+    err = run(nthreads, 1, calls);
+    if (!err) err = run(nthreads, 0, calls);
+  }
+
+  printf("%s %s.\n", progname, err ? "failed" : "completed");
+  return err;
+}
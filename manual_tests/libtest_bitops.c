@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Benchmark of the ffs/fls family.
+ *
+ * For ffsl, ffsll, fls, flsl, and flsll, this reports the time per call
+ * for:
+ *
+ *   direct:  a direct call, which uses the inline version from strings.h
+ *            when available.
+ *   pointer: a call via a function pointer, which always uses the library
+ *            (or OS) version.
+ *   loop:    the original bit-at-a-time loop.
+ *
+ * The masks are random, with a random number of low or high bits cleared,
+ * so that the loop cost is representative of varied inputs.  Times are in
+ * ns per call, and on x86 also in TSC cycles per call.
+ *
+ * Usage: libtest_bitops [-v] [<calls>]
+ */
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/time.h>
+
+#define DEF_CALLS 10000000
+#define NUM_MASKS 4096  /* Power of 2 */
+
+static unsigned long long masks[NUM_MASKS];
+static volatile int sink;
+
+/* Original implementations */
+
+static int
+loop_ffsll(long long mask)
+{
+  int bit = 0;
+  if (mask != 0) {
+    for (bit = 1; !(mask & 1); bit++) {
+      mask = (unsigned long long)mask >> 1;
+    }
+  }
+  return (bit);
+}
+
+static int
+loop_flsll(long long mask)
+{
+  int bit = 0;
+  if (mask != 0) {
+    for (bit = 1; mask != 1; bit++) {
+      mask = (unsigned long long)mask >> 1;
+    }
+  }
+  return (bit);
+}
+
+static int loop_ffsl(long mask) { return loop_ffsll((unsigned long) mask); }
+static int loop_fls(int mask) { return loop_flsll((unsigned int) mask); }
+static int loop_flsl(long mask) { return loop_flsll((unsigned long) mask); }
+
+static double
+now_ns(void)
+{
+  struct timeval tv;
+
+  (void) gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1e9 + tv.tv_usec * 1e3;
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+#define HAVE_TSC 1
+static unsigned long long
+read_tsc(void)
+{
+  unsigned int lo, hi;
+
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((unsigned long long) hi << 32) | lo;
+}
+#else
+#define HAVE_TSC 0
+#endif
+
+static void
+report(const char *name, const char *how, long calls,
+       double ns, unsigned long long cycles)
+{
+  printf("  %-6s %-8s %7.3f ns/call", name, how, ns / calls);
+  if (HAVE_TSC) printf(", %7.2f cycles/call", (double) cycles / calls);
+  printf("\n");
+}
+
+/*
+ * The loop is in a macro so that the direct calls are really direct (and
+ * hence possibly inlined).
+ */
+#define BENCH(name, how, call, type) \
+  do { \
+    long n; \
+    int sum = 0; \
+    unsigned long long c0 = 0, c1 = 0; \
+    double t0; \
+    t0 = now_ns(); \
+    if (HAVE_TSC) c0 = read_tsc(); \
+    for (n = 0; n < calls; ++n) { \
+      sum += call((type) masks[n & (NUM_MASKS - 1)]); \
+    } \
+    if (HAVE_TSC) c1 = read_tsc(); \
+    sink = sum; \
+    report(name, how, calls, now_ns() - t0, c1 - c0); \
+  } while (0)
+
+#define BENCH_FUNC(func, type) \
+  do { \
+    int (* volatile vfp)(type) = &func; \
+    int (*fp)(type) = vfp; \
+    BENCH(#func, "direct", func, type); \
+    BENCH(#func, "pointer", (*fp), type); \
+    BENCH(#func, "loop", loop_##func, type); \
+  } while (0)
+
+
+int
+main(int argc, char *argv[])
+{
+  int argn = 1, verbose = 0, i, shift;
+  long calls = DEF_CALLS;
+  char *progname = basename(argv[0]);
+  unsigned long long seed = 1, mask;
+
+  if (argn < argc && !strcmp(argv[argn], "-v")) {
+    verbose = 1; ++argn;
+  }
+  if (argn < argc) calls = atol(argv[argn]);
+  if (calls <= 0) calls = DEF_CALLS;
+
+  for (i = 0; i < NUM_MASKS; ++i) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    mask = seed;
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    shift = (int) (seed >> 58);
+    masks[i] = (seed & (1ULL << 32)) ? mask << shift : mask >> shift;
+  }
+
+  if (verbose) {
+    printf("%s started, %ld calls per test, inline versions %s\n",
+           progname, calls,
+#if defined(__MPLS_INLINE_BITOPS) && __MPLS_INLINE_BITOPS
+           "enabled"
+#else
+           "disabled"
+#endif
+           );
+  }
+
+  BENCH_FUNC(ffsl, long);
+  BENCH_FUNC(ffsll, long long);
+  BENCH_FUNC(fls, int);
+  BENCH_FUNC(flsl, long);
+  BENCH_FUNC(flsll, long long);
+
+  printf("%s completed.\n", progname);
+  return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Benchmark for dprintf().
+ *
+ * This compares the library's dprintf() with the original implementation
+ * (a temporary FILE per call), in calls/s, for short (log-line) and long
+ * (larger than the local buffer) messages, written to /dev/null and to a
+ * pipe drained by another thread.  On systems with a native dprintf(), the
+ * "library" figures are for that.
+ *
+ * Usage: libtest_dprintf [-v] [<thousand calls>]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "../src/stdio_internal.h"
+
+#define DEF_KCALLS 200
+#define LONG_LEN   2000
+
+/* The original implementation, as the reference */
+static int
+old_vdprintf(int fildes, const char * __restrict format, va_list ap) {
+  FILE *stream;
+  int ret;
+  char buf[BUFSIZ];
+
+  stream = fdopen(fildes, "w");
+  if (stream == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+  setbuffer(stream, buf, sizeof(buf));
+  if (__MPLS_FILE_OK(stream)) __MPLS_FILEP(stream)->_close = NULL;
+  ret = vfprintf(stream, format, ap);
+  if (fclose(stream)) ret = -1;
+  return ret;
+}
+
+static int
+old_dprintf(int fildes, const char * __restrict format, ...) {
+  va_list ap;
+  int ret;
+
+  va_start(ap, format);
+  ret = old_vdprintf(fildes, format, ap);
+  va_end(ap);
+  return ret;
+}
+
+typedef int dprintf_fn_t(int fd, const char * __restrict format, ...);
+
+static double
+now_secs(void)
+{
+  struct timeval tv;
+
+  (void) gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void *
+drain(void *arg)
+{
+  int fd = *(int *) arg;
+  char buf[65536];
+
+  while (read(fd, buf, sizeof(buf)) > 0) ;
+  return NULL;
+}
+
+static int
+bench(const char *name, dprintf_fn_t *func, int fd, int longmsg, long calls)
+{
+  long n;
+  double start, elapsed;
+
+  start = now_secs();
+  for (n = 0; n < calls; ++n) {
+    if ((longmsg ? (*func)(fd, "%ld: %*s\n", n, LONG_LEN, "long message")
+                 : (*func)(fd, "%ld: short message, value %08lx\n",
+                           n, (unsigned long) n * 2654435761UL)) < 0) {
+      perror(name);
+      return 1;
+    }
+  }
+  elapsed = now_secs() - start;
+  printf("  %-28s %s: %10.0f calls/s\n",
+         name, longmsg ? "long " : "short", calls / elapsed);
+  return 0;
+}
+
+static int
+bench_fd(const char *what, int fd, long calls)
+{
+  char name[64];
+  int longmsg, err = 0;
+
+  for (longmsg = 0; !err && longmsg <= 1; ++longmsg) {
+    (void) snprintf(name, sizeof(name), "original, %s", what);
+    err = bench(name, old_dprintf, fd, longmsg, calls);
+    (void) snprintf(name, sizeof(name), "library, %s", what);
+    if (!err) err = bench(name, dprintf, fd, longmsg, calls);
+  }
+  return err;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int argn = 1, verbose = 0, err, fd, pipes[2];
+  long calls = DEF_KCALLS;
+  char *progname = basename(argv[0]);
+  pthread_t reader;
+
+  if (argn < argc && !strcmp(argv[argn], "-v")) {
+    verbose = 1; ++argn;
+  }
+  if (argn < argc) calls = atol(argv[argn]);
+  if (calls <= 0) calls = DEF_KCALLS;
+  calls *= 1000;
+
+  if (verbose) printf("%s started, %ld calls per case\n", progname, calls);
+
+  if ((fd = open("/dev/null", O_WRONLY)) < 0) {
+    perror("/dev/null");
+    return 1;
+  }
+  err = bench_fd("/dev/null", fd, calls);
+  (void) close(fd);
+
+  if (!err) {
+    if (pipe(pipes) || pthread_create(&reader, NULL, drain, &pipes[0])) {
+      perror("pipe setup");
+      return 1;
+    }
+    err = bench_fd("pipe", pipes[1], calls);
+    (void) close(pipes[1]);
+    (void) pthread_join(reader, NULL);
+    (void) close(pipes[0]);
+  }
+
+  printf("%s %s.\n", progname, err ? "failed" : "completed");
+  return err;
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Benchmark for formatted output to fmemopen() streams.
+ *
+ * This fprintf()s the given number of millions of short records into an
+ * fmemopen() region, and compares that with snprintf() into the same
+ * region.  There are two profiles:
+ *
+ *   message: Each record is formatted at the start of a small region, as
+ *            when building a message, with a seek and a flush per record.
+ *
+ *   stream:  Records are written sequentially into a large region, which
+ *            is rewound when nearly full.
+ *
+ * Each fmemopen() profile is run with the stream as opened (buffered, with
+ * the buffer limited to the space left in the region), with buffering
+ * turned off by the caller (the former default), and with full buffering
+ * set by the caller, which loses exact short counts.  A final read profile
+ * measures getc(), 32 bytes per record, from a read-only stream.
+ *
+ * Usage: libtest_fmemopen [-v] [<million records>]
+ */
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define DEF_MRECS   2
+#define MSG_SIZE    256
+#define STREAM_SIZE (4 << 20)
+#define REC_MAX     64
+
+#define RECORD_FMT  "%ld,record,%08lx\n"
+#define RECORD_ARGS(n) (n), (unsigned long) (n) * 2654435761UL
+
+static char region[STREAM_SIZE];
+
+static double
+now_secs(void)
+{
+  struct timeval tv;
+
+  (void) gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void
+report(const char *name, long recs, double bytes, double elapsed)
+{
+  printf("  %-24s %7.1f ns/record, %7.1f MB/s\n",
+         name, elapsed * 1e9 / recs, bytes / elapsed / 1e6);
+}
+
+static int
+bench_snprintf(int stream, long recs)
+{
+  size_t pos = 0, size = stream ? STREAM_SIZE : MSG_SIZE;
+  double start, bytes = 0;
+  long n;
+  int len;
+
+  start = now_secs();
+  for (n = 0; n < recs; ++n) {
+    if (!stream || size - pos < REC_MAX) pos = 0;
+    len = snprintf(region + pos, size - pos, RECORD_FMT, RECORD_ARGS(n));
+    if (len < 0) {
+      perror("snprintf");
+      return 1;
+    }
+    pos += len; bytes += len;
+  }
+  report(stream ? "stream, snprintf" : "message, snprintf",
+         recs, bytes, now_secs() - start);
+  return 0;
+}
+
+/* Buffering set by the caller */
+#define AS_OPENED  0
+#define UNBUFFERED 1
+#define BUFFERED   2
+
+static const char *mode_names[][2] = {
+  {"message, as opened", "stream, as opened"},
+  {"message, unbuffered", "stream, unbuffered"},
+  {"message, buffered", "stream, buffered"},
+};
+
+static int
+bench_fmemopen(int stream, int mode, long recs)
+{
+  size_t pos = 0, size = stream ? STREAM_SIZE : MSG_SIZE;
+  double start, bytes = 0;
+  FILE *fp;
+  long n;
+  int len;
+
+  if (!(fp = fmemopen(region, size, "w"))) {
+    perror("fmemopen");
+    return 1;
+  }
+  if (mode != AS_OPENED
+      && setvbuf(fp, NULL, mode == BUFFERED ? _IOFBF : _IONBF, BUFSIZ)) {
+    perror("setvbuf");
+    return 1;
+  }
+
+  start = now_secs();
+  for (n = 0; n < recs; ++n) {
+    if (!stream || size - pos < REC_MAX) {
+      if (fseek(fp, 0, SEEK_SET)) {
+        perror("fseek");
+        return 1;
+      }
+      pos = 0;
+    }
+    if ((len = fprintf(fp, RECORD_FMT, RECORD_ARGS(n))) < 0) {
+      perror("fprintf");
+      return 1;
+    }
+    if (!stream && fflush(fp)) {
+      perror("fflush");
+      return 1;
+    }
+    pos += len; bytes += len;
+  }
+  if (fclose(fp)) {
+    perror("fclose");
+    return 1;
+  }
+  report(mode_names[mode][stream], recs, bytes, now_secs() - start);
+  return 0;
+}
+
+static int
+bench_read(long recs)
+{
+  double start, bytes;
+  FILE *fp;
+  long n, sum = 0;
+  int c;
+
+  memset(region, 'x', sizeof(region));
+  if (!(fp = fmemopen(region, sizeof(region), "r"))) {
+    perror("fmemopen");
+    return 1;
+  }
+  bytes = (double) recs * 32;
+
+  start = now_secs();
+  for (n = 0; n < recs * 32; ++n) {
+    if ((c = getc(fp)) == EOF) {
+      rewind(fp);
+      c = getc(fp);
+    }
+    sum += c;
+  }
+  report("read, getc", recs, bytes, now_secs() - start);
+  (void) fclose(fp);
+  return sum ? 0 : 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int argn = 1, verbose = 0, err = 0, stream, mode;
+  long mrecs = DEF_MRECS, recs;
+  char *progname = basename(argv[0]);
+
+  if (argn < argc && !strcmp(argv[argn], "-v")) {
+    verbose = 1; ++argn;
+  }
+  if (argn < argc) mrecs = atol(argv[argn]);
+  if (mrecs <= 0) mrecs = DEF_MRECS;
+  recs = mrecs * 1000000;
+
+  if (verbose) {
+    printf("%s started, %ld million records\n", progname, mrecs);
+  }
+
+  for (stream = 0; !err && stream <= 1; ++stream) {
+    err = bench_snprintf(stream, recs);
+    for (mode = AS_OPENED; !err && mode <= BUFFERED; ++mode) {
+      err = bench_fmemopen(stream, mode, recs);
+    }
+  }
+  if (!err) err = bench_read(recs);
+
+  printf("%s %s.\n", progname, err ? "failed" : "completed");
+  return err;
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Benchmark of getline().
+ *
+ * This writes a temporary file of the given size (default 256 MB; use
+ * several GB to approximate real log ingestion) in $TMPDIR (or /tmp), for
+ * each of two line-length profiles:
+ *
+ *   short: lines of 20-100 bytes, like typical log lines.
+ *   long:  lines of 0.5-2 MB.
+ *
+ * It then reads the file with getline(), with the getdelim_view() extension
+ * (where available), and with a copy of the original fgetc()-based
+ * implementation, reporting MB/s and lines/s for each.  The
+ * file is read once beforehand to warm the page cache (if it fits), and
+ * getline() is timed both before and after the original, to show any
+ * remaining cache effects.
+ *
+ * Usage: libtest_getdelim [-v] [<file MB>]
+ */
+
+#include <errno.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define DEF_MB 256
+
+/* The original implementation */
+static ssize_t
+old_getdelim(char **buf, size_t *bufsiz, int delimiter, FILE *fp)
+{
+	char *ptr, *eptr;
+
+
+	if (*buf == NULL || *bufsiz == 0) {
+		*bufsiz = BUFSIZ;
+		if ((*buf = malloc(*bufsiz)) == NULL)
+			return -1;
+	}
+
+	for (ptr = *buf, eptr = *buf + *bufsiz;;) {
+		int c = fgetc(fp);
+		if (c == -1) {
+			if (feof(fp))
+				return ptr == *buf ? -1 : ptr - *buf;
+			else
+				return -1;
+		}
+		*ptr++ = c;
+		if (c == delimiter) {
+			*ptr = '\0';
+			return ptr - *buf;
+		}
+		if (ptr + 2 >= eptr) {
+			char *nbuf;
+			size_t nbufsiz = *bufsiz * 2;
+			ssize_t d = ptr - *buf;
+			if ((nbuf = realloc(*buf, nbufsiz)) == NULL)
+				return -1;
+			*buf = nbuf;
+			*bufsiz = nbufsiz;
+			eptr = nbuf + nbufsiz;
+			ptr = nbuf + d;
+		}
+	}
+}
+
+#if __MPLS_SDK_SUPPORT_GETLINE__
+/* getdelim_view(), in getdelim() form (the line is not copied) */
+static ssize_t
+view_getdelim(char **buf, size_t *bufsiz, int delimiter, FILE *fp)
+{
+  const char *start;
+  size_t len;
+
+  (void) buf; (void) bufsiz;
+  return getdelim_view(fp, delimiter, &start, &len) ? -1 : (ssize_t) len;
+}
+#endif
+
+static double
+now_secs(void)
+{
+  struct timeval tv;
+
+  (void) gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* Write the test file, returning nonzero on failure */
+static int
+write_file(FILE *fp, long long size, size_t minlen, size_t maxlen)
+{
+  static char chunk[65536];
+  unsigned long seed = 1;
+  long long done = 0;
+  size_t len, n, part;
+  int i;
+
+  for (i = 0; i < (int) sizeof(chunk); ++i) chunk[i] = 'a' + i % 26;
+  while (done < size) {
+    seed = seed * 1103515245UL + 12345UL;
+    len = minlen + (seed >> 8) % (maxlen - minlen + 1);
+    for (n = len; n > 0; n -= part) {
+      part = n < sizeof(chunk) ? n : sizeof(chunk);
+      if (fwrite(chunk, 1, part, fp) != part) return 1;
+      done += part;
+    }
+    if (putc('\n', fp) == EOF) return 1;
+    ++done;
+  }
+  return fflush(fp) != 0;
+}
+
+typedef ssize_t (getdelim_fn_t)(char **, size_t *, int, FILE *);
+
+static int
+read_file(FILE *fp, getdelim_fn_t *func, const char *name,
+          const char *profile, int report)
+{
+  char *line = NULL;
+  size_t linecap = 0;
+  long long bytes = 0, lines = 0;
+  ssize_t len;
+  double start, elapsed;
+
+  rewind(fp);
+  start = now_secs();
+  while ((len = (*func)(&line, &linecap, '\n', fp)) > 0) {
+    bytes += len;
+    ++lines;
+  }
+  elapsed = now_secs() - start;
+  free(line);
+  if (ferror(fp)) {
+    perror("read");
+    return 1;
+  }
+  if (report) {
+    printf("  %-5s %-8s %8.1f MB/s, %11.0f lines/s (%lld lines)\n",
+           profile, name, bytes / elapsed / 1e6, lines / elapsed, lines);
+  }
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int argn = 1, verbose = 0, err = 0, prof, fd;
+  long mb = DEF_MB;
+  char *progname = basename(argv[0]);
+  const char *tmpdir = getenv("TMPDIR");
+  char path[1024];
+  FILE *fp;
+  static const struct {
+    const char *name;
+    size_t minlen, maxlen;
+  } profiles[] = {
+    { "short", 20, 100 },
+    { "long", 512 * 1024, 2048 * 1024 },
+  };
+
+  if (argn < argc && !strcmp(argv[argn], "-v")) {
+    verbose = 1; ++argn;
+  }
+  if (argn < argc) mb = atol(argv[argn]);
+  if (mb <= 0) mb = DEF_MB;
+  if (!tmpdir || !*tmpdir) tmpdir = "/tmp";
+
+  if (verbose) printf("%s started, file size %ld MB\n", progname, mb);
+
+  for (prof = 0; !err && prof < 2; ++prof) {
+    (void) snprintf(path, sizeof(path), "%s/%s.XXXXXX", tmpdir, progname);
+    if ((fd = mkstemp(path)) < 0 || !(fp = fdopen(fd, "w+"))) {
+      perror(path);
+      return 1;
+    }
+    (void) unlink(path);
+    if (write_file(fp, (long long) mb << 20,
+                   profiles[prof].minlen, profiles[prof].maxlen)) {
+      perror("write");
+      err = 1;
+    }
+    if (!err) err = read_file(fp, getdelim, "warmup", "", 0);
+    if (!err) err = read_file(fp, getdelim, "getline",
+                              profiles[prof].name, 1);
+#if __MPLS_SDK_SUPPORT_GETLINE__
+    if (!err) err = read_file(fp, view_getdelim, "view",
+                              profiles[prof].name, 1);
+#endif
+    if (!err) err = read_file(fp, old_getdelim, "original",
+                              profiles[prof].name, 1);
+    if (!err) err = read_file(fp, getdelim, "getline",
+                              profiles[prof].name, 1);
+    (void) fclose(fp);
+  }
+
+  printf("%s %s.\n", progname, err ? "failed" : "completed");
+  return err;
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Benchmark of memmem() against the original naive implementation.
+ *
+ * The corpus is generated, so no data files are needed:
+ *
+ *   text:  pseudo-random lowercase "words", with needles that occur only
+ *          at the very end (short and long lengths).
+ *   bin:   pseudo-random bytes, with the same kind of needles.
+ *   patho: all 'a', with needles of 'a' containing one 'b' in the middle,
+ *          which is the O(n*m) worst case for the naive code.
+ *
+ * Each result is in MB/s of haystack scanned.
+ *
+ * Usage: libtest_memmem [-v] [<haystack MB>]
+ */
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define DEF_MB     4
+#define MIN_SECS   0.2
+
+typedef void *(memmem_fn_t)(const void *, size_t, const void *, size_t);
+
+/* The original implementation */
+static void *
+old_memmem(const void *l, size_t l_len, const void *s, size_t s_len)
+{
+  register char *cur, *last;
+  const char *cl = (const char *)l;
+  const char *cs = (const char *)s;
+
+  if (l_len == 0 || s_len == 0)
+    return NULL;
+  if (l_len < s_len)
+    return NULL;
+  if (s_len == 1)
+    return memchr(l, (int)*cs, l_len);
+
+  last = (char *)cl + l_len - s_len;
+  for (cur = (char *)cl; cur <= last; cur++)
+    if (cur[0] == cs[0] && memcmp(cur, cs, s_len) == 0)
+      return cur;
+
+  return NULL;
+}
+
+static const size_t needle_lens[] = { 2, 4, 8, 16, 32, 64, 256, 1024 };
+#define NUM_NEEDLES (sizeof(needle_lens) / sizeof(needle_lens[0]))
+
+static double
+now_secs(void)
+{
+  struct timeval tv;
+
+  (void) gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* MB/s for one function, repeating until MIN_SECS has elapsed */
+static double
+rate(memmem_fn_t *func, const unsigned char *hay, size_t hlen,
+     const unsigned char *needle, size_t nlen, int *found)
+{
+  double start = now_secs(), elapsed;
+  long reps = 0;
+  void *res = NULL;
+
+  do {
+    res = (*func)(hay, hlen, needle, nlen);
+    ++reps;
+  } while ((elapsed = now_secs() - start) < MIN_SECS);
+  *found = res != NULL;
+  return (double) hlen * reps / elapsed / 1e6;
+}
+
+static void
+run(const char *corpus, const unsigned char *hay, size_t hlen,
+    const unsigned char *needle, size_t nlen)
+{
+  double new, old;
+  int nfound, ofound;
+
+  new = rate(memmem, hay, hlen, needle, nlen, &nfound);
+  old = rate(old_memmem, hay, hlen, needle, nlen, &ofound);
+  printf("  %-6s needle %5d: new %9.1f MB/s, old %9.1f MB/s, ratio %7.2f%s\n",
+         corpus, (int) nlen, new, old, old > 0 ? new / old : 0.0,
+         nfound == ofound ? "" : "  (RESULTS DIFFER)");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int argn = 1, verbose = 0;
+  long mb = DEF_MB;
+  char *progname = basename(argv[0]);
+  size_t hlen, i, n, nlen;
+  unsigned char *hay, *needle;
+  unsigned long seed = 1;
+
+  if (argn < argc && !strcmp(argv[argn], "-v")) {
+    verbose = 1; ++argn;
+  }
+  if (argn < argc) mb = atol(argv[argn]);
+  if (mb <= 0) mb = DEF_MB;
+  hlen = mb << 20;
+
+  if (!(hay = malloc(hlen)) || !(needle = malloc(hlen))) {
+    perror("malloc");
+    return 1;
+  }
+  if (verbose) printf("%s started, haystack %ld MB\n", progname, mb);
+
+  /* Text: words of 1-8 letters from a small alphabet */
+  for (i = 0; i < hlen; ) {
+    seed = seed * 1103515245UL + 12345UL;
+    n = 1 + (seed >> 16) % 8;
+    while (n-- && i < hlen) {
+      seed = seed * 1103515245UL + 12345UL;
+      hay[i++] = 'a' + (seed >> 16) % 16;
+    }
+    if (i < hlen) hay[i++] = ' ';
+  }
+  for (n = 0; n < NUM_NEEDLES; ++n) {
+    nlen = needle_lens[n];
+    memcpy(needle, hay + hlen - nlen, nlen);
+    run("text", hay, hlen, needle, nlen);
+  }
+
+  /* Binary: uniformly random bytes */
+  for (i = 0; i < hlen; ++i) {
+    seed = seed * 1103515245UL + 12345UL;
+    hay[i] = seed >> 16;
+  }
+  for (n = 0; n < NUM_NEEDLES; ++n) {
+    nlen = needle_lens[n];
+    memcpy(needle, hay + hlen - nlen, nlen);
+    run("bin", hay, hlen, needle, nlen);
+  }
+
+  /* Pathological: runs of 'a', with a near-miss needle */
+  memset(hay, 'a', hlen);
+  for (n = 0; n < NUM_NEEDLES; ++n) {
+    nlen = needle_lens[n];
+    memset(needle, 'a', nlen);
+    needle[nlen / 2] = 'b';
+    run("patho", hay, hlen, needle, nlen);
+  }
+
+  free(needle);
+  free(hay);
+  printf("%s completed.\n", progname);
+  return 0;
+}
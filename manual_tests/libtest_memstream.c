@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Benchmark and large-size test for open_memstream().
+ *
+ * The benchmark fprintf()s the given number of millions of short records
+ * into a memstream, and reports records/s and MB/s.  The growth policy can
+ * be varied with the MPLS_MEMSTREAM_INITCAP and MPLS_MEMSTREAM_GROWTH
+ * environment variables.
+ *
+ * With -b, it also writes a stream larger than 4 GiB, and checks its size
+ * and contents, if this is a 64-bit build and there appears to be enough
+ * physical memory.
+ *
+ * Usage: libtest_memstream [-v] [-b] [<million records>]
+ */
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#endif
+
+#define DEF_MRECS 4
+#define BIG_SIZE  ((4ULL << 30) + (256ULL << 20) + 12345)
+#define BIG_CHUNK (1 << 20)
+
+static double
+now_secs(void)
+{
+  struct timeval tv;
+
+  (void) gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static unsigned long long
+phys_mem(void)
+{
+#ifdef __APPLE__
+  unsigned long long mem = 0;
+  size_t len = sizeof(mem);
+
+  if (sysctlbyname("hw.memsize", &mem, &len, NULL, 0)) {
+    unsigned int mem32 = 0;
+
+    len = sizeof(mem32);
+    if (sysctlbyname("hw.physmem", &mem32, &len, NULL, 0)) return 0;
+    mem = mem32;
+  }
+  return mem;
+#else
+  return (unsigned long long) sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+static int
+bench(long mrecs)
+{
+  char *buffer = NULL;
+  size_t size = 0;
+  FILE *fp;
+  long n, recs = mrecs * 1000000;
+  double start, elapsed;
+
+  start = now_secs();
+  if (!(fp = open_memstream(&buffer, &size))) {
+    perror("open_memstream");
+    return 1;
+  }
+  for (n = 0; n < recs; ++n) {
+    if (fprintf(fp, "%ld,record,%08lx\n", n, (unsigned long) n * 2654435761UL)
+        < 0) {
+      perror("fprintf");
+      return 1;
+    }
+  }
+  if (fclose(fp)) {
+    perror("fclose");
+    return 1;
+  }
+  elapsed = now_secs() - start;
+  printf("  %ld records, %.1f MB: %.0f records/s, %.1f MB/s\n",
+         recs, size / 1e6, recs / elapsed, size / elapsed / 1e6);
+  free(buffer);
+  return 0;
+}
+
+static int
+big_test(int verbose)
+{
+  char *buffer = NULL, *chunk;
+  size_t size = 0, n, pos;
+  unsigned long long mem = phys_mem(), done;
+  FILE *fp;
+  int err = 0;
+
+  if (sizeof(size_t) < 8) {
+    printf("  Skipping >4 GiB test in 32-bit build\n");
+    return 0;
+  }
+  if (mem < BIG_SIZE + (BIG_SIZE >> 1)) {
+    printf("  Skipping >4 GiB test with %.1f GiB of memory\n",
+           mem / (double) (1ULL << 30));
+    return 0;
+  }
+
+  if (!(chunk = malloc(BIG_CHUNK))) {
+    perror("malloc");
+    return 1;
+  }
+  for (n = 0; n < BIG_CHUNK; ++n) chunk[n] = n % 251;
+
+  if (!(fp = open_memstream(&buffer, &size))) {
+    perror("open_memstream");
+    free(chunk);
+    return 1;
+  }
+  for (done = 0; !err && done < BIG_SIZE; done += n) {
+    n = BIG_SIZE - done < BIG_CHUNK ? BIG_SIZE - done : BIG_CHUNK;
+    if (fwrite(chunk, 1, n, fp) != n) {
+      perror("fwrite");
+      err = 1;
+    }
+  }
+  if (fclose(fp)) {
+    perror("fclose");
+    err = 1;
+  }
+  free(chunk);
+  if (err) {
+    free(buffer);
+    return 1;
+  }
+
+  if (size != BIG_SIZE) {
+    printf("  Size is %llu, expected %llu\n",
+           (unsigned long long) size, BIG_SIZE);
+    err = 1;
+  }
+  /* Check a byte in each chunk, and the end */
+  for (pos = 0; !err && pos < size; pos += BIG_CHUNK - 1) {
+    if ((unsigned char) buffer[pos] != (pos % BIG_CHUNK) % 251) {
+      printf("  Wrong data at offset %llu\n", (unsigned long long) pos);
+      err = 1;
+    }
+  }
+  if (!err && buffer[size] != 0) {
+    printf("  Missing terminator\n");
+    err = 1;
+  }
+  if (verbose || err) {
+    printf("  >4 GiB test %s\n", err ? "failed" : "passed");
+  }
+  free(buffer);
+  return err;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int argn = 1, verbose = 0, big = 0, err;
+  long mrecs = DEF_MRECS;
+  char *progname = basename(argv[0]);
+
+  if (argn < argc && !strcmp(argv[argn], "-v")) {
+    verbose = 1; ++argn;
+  }
+  if (argn < argc && !strcmp(argv[argn], "-b")) {
+    big = 1; ++argn;
+  }
+  if (argn < argc) mrecs = atol(argv[argn]);
+  if (mrecs <= 0) mrecs = DEF_MRECS;
+
+  if (verbose) printf("%s started, %ld million records\n", progname, mrecs);
+
+  err = bench(mrecs);
+  if (!err && big) err = big_test(verbose);
+
+  printf("%s %s.\n", progname, err ? "failed" : "completed");
+  return err;
+}
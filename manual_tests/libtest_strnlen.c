@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Benchmark of strnlen(), wcsnlen(), and stpncpy().
+ *
+ * For string lengths from 0 to 4096 (roughly doubling), this reports the
+ * mean ns per call over all alignments from 0 to 15 bytes (or 0 to 3
+ * characters for wide strings), for the library version and for a simple
+ * character-at-a-time loop like the original.  The limit is twice the
+ * string length, so the terminator is what ends the scan.
+ *
+ * Usage: libtest_strnlen [-v] [<calls per case>]
+ */
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <wchar.h>
+
+#define DEF_CALLS 100000
+#define MAXLEN    4096
+#define ALIGNS    16
+
+static const size_t lengths[] = {
+  0, 1, 2, 3, 4, 7, 8, 15, 16, 31, 32, 63, 64, 128, 256, 1024, MAXLEN,
+};
+#define NUM_LENGTHS (sizeof(lengths) / sizeof(lengths[0]))
+
+static volatile size_t sink;
+
+/* Simple versions, like the originals */
+
+static size_t
+loop_strnlen(const char *s, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < len && s[i]; i++)
+    ;
+  return i;
+}
+
+static size_t
+loop_wcsnlen(const wchar_t *s, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < len && s[i]; i++)
+    ;
+  return i;
+}
+
+static char *
+loop_stpncpy(char *dst, const char *src, size_t maxlen)
+{
+  size_t srclen = loop_strnlen(src, maxlen);
+
+  memcpy(dst, src, srclen);
+  memset(dst + srclen, 0, maxlen - srclen);
+  return dst + srclen;
+}
+
+static double
+now_ns(void)
+{
+  struct timeval tv;
+
+  (void) gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1e9 + tv.tv_usec * 1e3;
+}
+
+typedef size_t (strnlen_fn_t)(const char *, size_t);
+typedef size_t (wcsnlen_fn_t)(const wchar_t *, size_t);
+typedef char *(stpncpy_fn_t)(char *, const char *, size_t);
+
+static double
+time_strnlen(strnlen_fn_t *func, const char *buf, size_t len, long calls)
+{
+  double start = now_ns();
+  size_t sum = 0;
+  long n;
+  int align;
+
+  for (align = 0; align < ALIGNS; ++align) {
+    for (n = 0; n < calls; ++n) sum += (*func)(buf + align, len * 2);
+  }
+  sink = sum;
+  return (now_ns() - start) / ((double) calls * ALIGNS);
+}
+
+static double
+time_wcsnlen(wcsnlen_fn_t *func, const wchar_t *buf, size_t len, long calls)
+{
+  double start = now_ns();
+  size_t sum = 0;
+  long n;
+  int align;
+
+  for (align = 0; align < ALIGNS / (int) sizeof(wchar_t); ++align) {
+    for (n = 0; n < calls; ++n) sum += (*func)(buf + align, len * 2);
+  }
+  sink = sum;
+  return (now_ns() - start) / ((double) calls * (ALIGNS / sizeof(wchar_t)));
+}
+
+static double
+time_stpncpy(stpncpy_fn_t *func, char *dst, const char *buf, size_t len,
+             long calls)
+{
+  double start = now_ns();
+  size_t sum = 0;
+  long n;
+  int align;
+
+  for (align = 0; align < ALIGNS; ++align) {
+    for (n = 0; n < calls; ++n) {
+      sum += (*func)(dst, buf + align, len + 1) - dst;
+    }
+  }
+  sink = sum;
+  return (now_ns() - start) / ((double) calls * ALIGNS);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int argn = 1, verbose = 0;
+  long calls = DEF_CALLS, ncalls;
+  char *progname = basename(argv[0]);
+  static char buf[MAXLEN + ALIGNS + 1], dst[MAXLEN + 2];
+  static wchar_t wbuf[MAXLEN + ALIGNS + 1];
+  size_t i, j, len;
+  int align;
+  double lib, loop;
+
+  if (argn < argc && !strcmp(argv[argn], "-v")) {
+    verbose = 1; ++argn;
+  }
+  if (argn < argc) calls = atol(argv[argn]);
+  if (calls <= 0) calls = DEF_CALLS;
+
+  if (verbose) printf("%s started, %ld calls per case\n", progname, calls);
+
+  for (i = 0; i < NUM_LENGTHS; ++i) {
+    len = lengths[i];
+    /* Fewer calls for long strings, to keep the runtime reasonable */
+    ncalls = len > 64 ? calls * 64 / (long) len : calls;
+    if (ncalls < 1) ncalls = 1;
+
+    /* A string of the given length at every alignment */
+    memset(buf, 'x', sizeof(buf));
+    for (align = 0; align < ALIGNS; ++align) buf[align + len] = '\0';
+    for (j = 0; j < sizeof(wbuf) / sizeof(wbuf[0]); ++j) wbuf[j] = L'x';
+    for (align = 0; align < ALIGNS; ++align) wbuf[align + len] = L'\0';
+
+    lib = time_strnlen(strnlen, buf, len, ncalls);
+    loop = time_strnlen(loop_strnlen, buf, len, ncalls);
+    printf("  strnlen %5d: lib %8.2f ns, loop %8.2f ns, ratio %6.2f\n",
+           (int) len, lib, loop, lib > 0 ? loop / lib : 0.0);
+
+    lib = time_wcsnlen(wcsnlen, wbuf, len, ncalls);
+    loop = time_wcsnlen(loop_wcsnlen, wbuf, len, ncalls);
+    printf("  wcsnlen %5d: lib %8.2f ns, loop %8.2f ns, ratio %6.2f\n",
+           (int) len, lib, loop, lib > 0 ? loop / lib : 0.0);
+
+    lib = time_stpncpy(stpncpy, dst, buf, len, ncalls);
+    loop = time_stpncpy(loop_stpncpy, dst, buf, len, ncalls);
+    printf("  stpncpy %5d: lib %8.2f ns, loop %8.2f ns, ratio %6.2f\n",
+           (int) len, lib, loop, lib > 0 ? loop / lib : 0.0);
+  }
+
+  printf("%s completed.\n", progname);
+  return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Benchmark for open_wmemstream().
+ *
+ * This fwprintf()s the given number of millions of short records into a
+ * wide memstream, and reports records/s and millions of characters/s,
+ * with fprintf() into an ordinary memstream as the baseline.  The wide
+ * case is run in the C locale, and, if available, in a UTF-8 locale with
+ * both ASCII and non-ASCII records.  The growth policy can be varied with
+ * the MPLS_MEMSTREAM_INITCAP and MPLS_MEMSTREAM_GROWTH environment
+ * variables.
+ *
+ * Usage: libtest_wmemstream [-v] [<million records>]
+ */
+
+#include <libgen.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <wchar.h>
+
+#define DEF_MRECS 2
+
+static double
+now_secs(void)
+{
+  struct timeval tv;
+
+  (void) gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void
+report(const char *name, long recs, size_t chars, double elapsed)
+{
+  printf("  %-26s %.0f records/s, %6.1f Mchars/s\n",
+         name, recs / elapsed, chars / elapsed / 1e6);
+}
+
+static int
+bench_narrow(long recs)
+{
+  char *buffer = NULL;
+  size_t size = 0;
+  FILE *fp;
+  long n;
+  double start;
+
+  start = now_secs();
+  if (!(fp = open_memstream(&buffer, &size))) {
+    perror("open_memstream");
+    return 1;
+  }
+  for (n = 0; n < recs; ++n) {
+    if (fprintf(fp, "%ld,record,%08lx\n", n, (unsigned long) n * 2654435761UL)
+        < 0) {
+      perror("fprintf");
+      return 1;
+    }
+  }
+  if (fclose(fp)) {
+    perror("fclose");
+    return 1;
+  }
+  report("fprintf, memstream", recs, size, now_secs() - start);
+  free(buffer);
+  return 0;
+}
+
+static int
+bench_wide(const char *name, const wchar_t *word, long recs)
+{
+  wchar_t *buffer = NULL;
+  size_t size = 0;
+  FILE *fp;
+  long n;
+  double start;
+
+  start = now_secs();
+  if (!(fp = open_wmemstream(&buffer, &size))) {
+    perror("open_wmemstream");
+    return 1;
+  }
+  for (n = 0; n < recs; ++n) {
+    if (fwprintf(fp, L"%ld,%ls,%08lx\n",
+                 n, word, (unsigned long) n * 2654435761UL) < 0) {
+      perror("fwprintf");
+      return 1;
+    }
+  }
+  if (fclose(fp)) {
+    perror("fclose");
+    return 1;
+  }
+  report(name, recs, size, now_secs() - start);
+  free(buffer);
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int argn = 1, verbose = 0, err;
+  long mrecs = DEF_MRECS, recs;
+  char *progname = basename(argv[0]);
+  const char *utf8;
+
+  if (argn < argc && !strcmp(argv[argn], "-v")) {
+    verbose = 1; ++argn;
+  }
+  if (argn < argc) mrecs = atol(argv[argn]);
+  if (mrecs <= 0) mrecs = DEF_MRECS;
+  recs = mrecs * 1000000;
+
+  if (verbose) printf("%s started, %ld million records\n", progname, mrecs);
+
+  err = bench_narrow(recs);
+  if (!err) err = bench_wide("fwprintf, C", L"record", recs);
+
+  utf8 = setlocale(LC_CTYPE, "en_US.UTF-8");
+  if (!utf8) utf8 = setlocale(LC_CTYPE, "C.UTF-8");
+  if (!utf8) {
+    if (verbose) printf("  No UTF-8 locale, skipping UTF-8 cases\n");
+  } else {
+    if (!err) err = bench_wide("fwprintf, UTF-8, ASCII", L"record", recs);
+    if (!err) {
+      err = bench_wide("fwprintf, UTF-8, non-ASCII",
+                       L"r\x00E9\x0441\x043E\x4E2D\x6587", recs);
+    }
+  }
+
+  printf("%s %s.\n", progname, err ? "failed" : "completed");
+  return err;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Benchmark for the mach_time to timespec conversion.
+ *
+ * This includes the private conversion header directly, and doesn't use the
+ * library.  It converts a buffer of randomized mach timestamps (spanning
+ * uptimes from seconds to years) to timespecs, with the original arithmetic
+ * (portable multiply and a 64-bit divide) and with the current arithmetic,
+ * for each of the known mach_time scale factors.  It checks that the results
+ * are identical, and reports the cost of each in ns per conversion.
+ *
+ * Usage: time_conv_bench [-v] [<million conversions>]
+ */
+
+#include <libgen.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "../src/time_conv.h"
+
+#define DEF_MCONV 20
+#define NUM_TIMES 4096  /* Small enough to stay in cache */
+
+static const struct { uint32_t numer, denom; const char *name; } scales[] = {
+  {1, 1, "x86"},
+  {125, 3, "arm64"},
+  {1000000000, 33333333, "PowerPC"},
+};
+
+static uint64_t times[NUM_TIMES];
+static struct timespec old_ts[NUM_TIMES], new_ts[NUM_TIMES];
+
+/* Deterministic generator, so runs are comparable */
+static uint64_t rand_state = 1;
+
+static uint64_t
+next_rand(void)
+{
+  rand_state = rand_state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return rand_state ^ (rand_state >> 29);
+}
+
+/* The original conversion, as the reference */
+static void
+old_mach2timespec(uint64_t mach_time, uint64_t mult, struct timespec *ts)
+{
+  uint64_t nanos, secs;
+  uint32_t lownanos, lowsecs;
+
+  nanos = mult == NULL_SCALE ? mach_time
+          : mmul64_portable(mach_time, mult) >> EXTRA_SHIFT;
+  secs = nanos / BILLION32;
+  lownanos = nanos; lowsecs = secs;
+  ts->tv_sec = secs; ts->tv_nsec = lownanos - lowsecs * BILLION32;
+}
+
+static void
+new_mach2timespec(uint64_t mach_time, uint64_t mult, struct timespec *ts)
+{
+  nanos2timespec(mach2nanos_mult(mach_time, mult), ts);
+}
+
+typedef void conv_fn_t(uint64_t mach_time, uint64_t mult, struct timespec *ts);
+
+static double
+now_secs(void)
+{
+  struct timeval tv;
+
+  (void) gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static double
+bench(conv_fn_t *func, uint64_t mult, struct timespec *out, long total)
+{
+  long done;
+  int i;
+  double start, elapsed;
+
+  start = now_secs();
+  for (done = 0; done < total; done += NUM_TIMES) {
+    for (i = 0; i < NUM_TIMES; ++i) (*func)(times[i], mult, &out[i]);
+  }
+  elapsed = now_secs() - start;
+  return done ? elapsed * 1e9 / done : 0.0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int argn = 1, verbose = 0, errs = 0, si, i;
+  long mconv = DEF_MCONV;
+  char *progname = basename(argv[0]);
+  uint64_t mult;
+  double old_ns, new_ns;
+
+  if (argn < argc && !strcmp(argv[argn], "-v")) {
+    verbose = 1; ++argn;
+  }
+  if (argn < argc) mconv = atol(argv[argn]);
+  if (mconv <= 0) mconv = DEF_MCONV;
+
+  if (verbose) {
+    printf("  Using %s 128-bit multiply\n",
+           MPLS_HAVE_UINT128 ? "native" : "portable");
+  }
+
+  /* Up to 2^58 mach units, i.e. beyond any plausible uptime */
+  for (i = 0; i < NUM_TIMES; ++i) {
+    times[i] = next_rand() >> (6 + next_rand() % 24);
+  }
+
+  for (si = 0; si < (int) (sizeof(scales) / sizeof(scales[0])); ++si) {
+    mult = mach_mult_from_scale(scales[si].numer, scales[si].denom);
+    old_ns = bench(old_mach2timespec, mult, old_ts, mconv * 1000000);
+    new_ns = bench(new_mach2timespec, mult, new_ts, mconv * 1000000);
+    for (i = 0; i < NUM_TIMES; ++i) {
+      if (old_ts[i].tv_sec != new_ts[i].tv_sec
+          || old_ts[i].tv_nsec != new_ts[i].tv_nsec) {
+        if (verbose || !errs) {
+          printf("  %s mismatch for %llu: %lld.%09ld vs. %lld.%09ld\n",
+                 scales[si].name, (unsigned long long) times[i],
+                 (long long) old_ts[i].tv_sec, (long) old_ts[i].tv_nsec,
+                 (long long) new_ts[i].tv_sec, (long) new_ts[i].tv_nsec);
+        }
+        ++errs;
+      }
+    }
+    printf("  %-8s original: %6.2f ns, current: %6.2f ns, speedup %.2f\n",
+           scales[si].name, old_ns, new_ns,
+           new_ns > 0 ? old_ns / new_ns : 0.0);
+  }
+
+  printf("%s %s.\n", progname, errs ? "failed" : "succeeded");
+  return errs ? 1 : 0;
+}
@@ -22,12 +22,16 @@
 #include "MacportsLegacySupport.h"
 #if __MPLS_LIB_SUPPORT_ARC4RANDOM__
 
+#include "compiler.h"
+#include "util.h"
+
 /*
  * ChaCha based random number generator from OpenBSD.
  *
  * Made fully portable and thread-safe by Sudhi Herle.
  */
 
+#include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
 #include <signal.h>
@@ -47,241 +51,70 @@
 #define ARC4R_KEYSZ     32
 #define ARC4R_IVSZ      8
 #define ARC4R_BLOCKSZ   64
-#define ARC4R_RSBUFSZ   (16*ARC4R_BLOCKSZ)
 
-typedef struct
-{
-    uint32_t input[16]; /* could be compressed */
-} chacha_ctx;
+/*
+ * Keystream buffering and reseed policy.
+ *
+ * ARC4R_RSBLOCKS is the maximum number of keystream blocks generated per
+ * refill of a thread's buffer, and ARC4R_RESEED is the default number of
+ * output bytes between reseeds from getentropy().  Both may be overridden
+ * at build time.  At runtime, the environment variables below may lower the
+ * buffer depth (in blocks) and set the reseed interval (in bytes).  They're
+ * read once per process, when the first thread state is seeded; invalid or
+ * out-of-range values are ignored, as are both variables in setuid or
+ * setgid programs.
+ */
+#ifndef ARC4R_RSBLOCKS
+#define ARC4R_RSBLOCKS  16
+#endif
+#ifndef ARC4R_RESEED
+#define ARC4R_RESEED    1600000
+#endif
+#define ARC4R_RSBUFSZ   (ARC4R_RSBLOCKS*ARC4R_BLOCKSZ)
+
+#define ARC4R_RSBLOCKS_VAR "MPLS_ARC4RANDOM_BLOCKS"
+#define ARC4R_RESEED_VAR   "MPLS_ARC4RANDOM_RESEED"
+
+/*
+ * Requests of at least ARC4R_BULK_MIN bytes have their whole blocks
+ * generated directly into the caller's buffer, rekeying after every
+ * ARC4R_BULK_CHUNK bytes.
+ */
+#define ARC4R_BULK_MIN   (16*ARC4R_BLOCKSZ)
+#define ARC4R_BULK_CHUNK (256*ARC4R_BLOCKSZ)
+
+#include "chacha_private.h"
 
 struct rand_state
 {
     size_t          rs_have;    /* valid bytes at end of rs_buf */
     size_t          rs_count;   /* bytes till reseed */
-    pid_t           rs_pid;     /* My PID */
+    size_t          rs_bufsz;   /* keystream bytes per refill */
+    uint32_t        rs_gen;     /* fork generation when last stirred */
+    uint64_t        rs_rekeys;  /* count of key replacements */
+    uint64_t        rs_stirs;   /* count of reseeds */
+    uint64_t        rs_bytes;   /* count of bytes returned */
     chacha_ctx      rs_chacha;  /* chacha context for random keystream */
     u_char          rs_buf[ARC4R_RSBUFSZ];  /* keystream blocks */
 };
 typedef struct rand_state rand_state;
 
-#define KEYSTREAM_ONLY
-
-typedef unsigned char u8;
-typedef uint32_t      u32;
-
-
-#define U8C(v) (v##U)
-#define U32C(v) (v##U)
-
-#define U8V(v) ((u8)(v) & U8C(0xFF))
-#define U32V(v) ((u32)(v) & U32C(0xFFFFFFFF))
-
-#define ROTL32(v, n) \
-  (U32V((v) << (n)) | ((v) >> (32 - (n))))
-
-#define U8TO32_LITTLE(p) \
-  (((u32)((p)[0])      ) | \
-   ((u32)((p)[1]) <<  8) | \
-   ((u32)((p)[2]) << 16) | \
-   ((u32)((p)[3]) << 24))
-
-#define U32TO8_LITTLE(p, v) \
-  do { \
-    (p)[0] = U8V((v)      ); \
-    (p)[1] = U8V((v) >>  8); \
-    (p)[2] = U8V((v) >> 16); \
-    (p)[3] = U8V((v) >> 24); \
-  } while (0)
-
-#define ROTATE(v,c) (ROTL32(v,c))
-#define XOR(v,w) ((v) ^ (w))
-#define PLUS(v,w) (U32V((v) + (w)))
-#define PLUSONE(v) (PLUS((v),1))
-
-#define QUARTERROUND(a,b,c,d) \
-  a = PLUS(a,b); d = ROTATE(XOR(d,a),16); \
-  c = PLUS(c,d); b = ROTATE(XOR(b,c),12); \
-  a = PLUS(a,b); d = ROTATE(XOR(d,a), 8); \
-  c = PLUS(c,d); b = ROTATE(XOR(b,c), 7);
-
-static const char sigma[16] = "expand 32-byte k";
-static const char tau[16] = "expand 16-byte k";
+#define minimum(a, b) ((a) < (b) ? (a) : (b))
 
-static void
-_chacha_keysetup(chacha_ctx *x,const u8 *k,u32 kbits,u32 ivbits)
-{
-    const char *constants;
-
-    (void)ivbits;
-
-    x->input[4] = U8TO32_LITTLE(k + 0);
-    x->input[5] = U8TO32_LITTLE(k + 4);
-    x->input[6] = U8TO32_LITTLE(k + 8);
-    x->input[7] = U8TO32_LITTLE(k + 12);
-    if (kbits == 256) { /* recommended */
-        k += 16;
-        constants = sigma;
-    } else { /* kbits == 128 */
-        constants = tau;
-    }
-    x->input[8] = U8TO32_LITTLE(k + 0);
-    x->input[9] = U8TO32_LITTLE(k + 4);
-    x->input[10] = U8TO32_LITTLE(k + 8);
-    x->input[11] = U8TO32_LITTLE(k + 12);
-    x->input[0] = U8TO32_LITTLE(constants + 0);
-    x->input[1] = U8TO32_LITTLE(constants + 4);
-    x->input[2] = U8TO32_LITTLE(constants + 8);
-    x->input[3] = U8TO32_LITTLE(constants + 12);
-}
+/* Process-wide policy, set up by _rs_getpolicy() */
+static size_t         Rbufsz  = ARC4R_RSBUFSZ;
+static size_t         Rreseed = ARC4R_RESEED;
+static pthread_once_t Ponce   = PTHREAD_ONCE_INIT;
 
 static void
-_chacha_ivsetup(chacha_ctx *x,const u8 *iv)
+_rs_getpolicy(void)
 {
-  x->input[12] = 0;
-  x->input[13] = 0;
-  x->input[14] = U8TO32_LITTLE(iv + 0);
-  x->input[15] = U8TO32_LITTLE(iv + 4);
+    Rbufsz = __mpls_getenv_size(ARC4R_RSBLOCKS_VAR, 1, ARC4R_RSBLOCKS,
+                                ARC4R_RSBLOCKS) * ARC4R_BLOCKSZ;
+    Rreseed = __mpls_getenv_size(ARC4R_RESEED_VAR, ARC4R_BLOCKSZ, SIZE_MAX,
+                                 ARC4R_RESEED);
 }
 
-static void
-_chacha_encrypt_bytes(chacha_ctx *x,const u8 *m,u8 *c,u32 bytes)
-{
-  u32 x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
-  u32 j0, j1, j2, j3, j4, j5, j6, j7, j8, j9, j10, j11, j12, j13, j14, j15;
-  u8 *ctarget = NULL;
-  u8 tmp[64];
-  u_int i;
-
-  if (!bytes) return;
-
-  j0 = x->input[0];
-  j1 = x->input[1];
-  j2 = x->input[2];
-  j3 = x->input[3];
-  j4 = x->input[4];
-  j5 = x->input[5];
-  j6 = x->input[6];
-  j7 = x->input[7];
-  j8 = x->input[8];
-  j9 = x->input[9];
-  j10 = x->input[10];
-  j11 = x->input[11];
-  j12 = x->input[12];
-  j13 = x->input[13];
-  j14 = x->input[14];
-  j15 = x->input[15];
-
-  for (;;) {
-    if (bytes < 64) {
-      for (i = 0;i < bytes;++i) tmp[i] = m[i];
-      m = tmp;
-      ctarget = c;
-      c = tmp;
-    }
-    x0 = j0;
-    x1 = j1;
-    x2 = j2;
-    x3 = j3;
-    x4 = j4;
-    x5 = j5;
-    x6 = j6;
-    x7 = j7;
-    x8 = j8;
-    x9 = j9;
-    x10 = j10;
-    x11 = j11;
-    x12 = j12;
-    x13 = j13;
-    x14 = j14;
-    x15 = j15;
-    for (i = 20;i > 0;i -= 2) {
-      QUARTERROUND( x0, x4, x8,x12)
-      QUARTERROUND( x1, x5, x9,x13)
-      QUARTERROUND( x2, x6,x10,x14)
-      QUARTERROUND( x3, x7,x11,x15)
-      QUARTERROUND( x0, x5,x10,x15)
-      QUARTERROUND( x1, x6,x11,x12)
-      QUARTERROUND( x2, x7, x8,x13)
-      QUARTERROUND( x3, x4, x9,x14)
-    }
-    x0 = PLUS(x0,j0);
-    x1 = PLUS(x1,j1);
-    x2 = PLUS(x2,j2);
-    x3 = PLUS(x3,j3);
-    x4 = PLUS(x4,j4);
-    x5 = PLUS(x5,j5);
-    x6 = PLUS(x6,j6);
-    x7 = PLUS(x7,j7);
-    x8 = PLUS(x8,j8);
-    x9 = PLUS(x9,j9);
-    x10 = PLUS(x10,j10);
-    x11 = PLUS(x11,j11);
-    x12 = PLUS(x12,j12);
-    x13 = PLUS(x13,j13);
-    x14 = PLUS(x14,j14);
-    x15 = PLUS(x15,j15);
-
-#ifndef KEYSTREAM_ONLY
-    x0 = XOR(x0,U8TO32_LITTLE(m + 0));
-    x1 = XOR(x1,U8TO32_LITTLE(m + 4));
-    x2 = XOR(x2,U8TO32_LITTLE(m + 8));
-    x3 = XOR(x3,U8TO32_LITTLE(m + 12));
-    x4 = XOR(x4,U8TO32_LITTLE(m + 16));
-    x5 = XOR(x5,U8TO32_LITTLE(m + 20));
-    x6 = XOR(x6,U8TO32_LITTLE(m + 24));
-    x7 = XOR(x7,U8TO32_LITTLE(m + 28));
-    x8 = XOR(x8,U8TO32_LITTLE(m + 32));
-    x9 = XOR(x9,U8TO32_LITTLE(m + 36));
-    x10 = XOR(x10,U8TO32_LITTLE(m + 40));
-    x11 = XOR(x11,U8TO32_LITTLE(m + 44));
-    x12 = XOR(x12,U8TO32_LITTLE(m + 48));
-    x13 = XOR(x13,U8TO32_LITTLE(m + 52));
-    x14 = XOR(x14,U8TO32_LITTLE(m + 56));
-    x15 = XOR(x15,U8TO32_LITTLE(m + 60));
-#endif
-
-    j12 = PLUSONE(j12);
-    if (!j12) {
-      j13 = PLUSONE(j13);
-      /* stopping at 2^70 bytes per nonce is user's responsibility */
-    }
-
-    U32TO8_LITTLE(c + 0,x0);
-    U32TO8_LITTLE(c + 4,x1);
-    U32TO8_LITTLE(c + 8,x2);
-    U32TO8_LITTLE(c + 12,x3);
-    U32TO8_LITTLE(c + 16,x4);
-    U32TO8_LITTLE(c + 20,x5);
-    U32TO8_LITTLE(c + 24,x6);
-    U32TO8_LITTLE(c + 28,x7);
-    U32TO8_LITTLE(c + 32,x8);
-    U32TO8_LITTLE(c + 36,x9);
-    U32TO8_LITTLE(c + 40,x10);
-    U32TO8_LITTLE(c + 44,x11);
-    U32TO8_LITTLE(c + 48,x12);
-    U32TO8_LITTLE(c + 52,x13);
-    U32TO8_LITTLE(c + 56,x14);
-    U32TO8_LITTLE(c + 60,x15);
-
-    if (bytes <= 64) {
-      if (bytes < 64) {
-        for (i = 0;i < bytes;++i) ctarget[i] = c[i];
-      }
-      x->input[12] = j12;
-      x->input[13] = j13;
-      return;
-    }
-    bytes -= 64;
-    c += 64;
-#ifndef KEYSTREAM_ONLY
-    m += 64;
-#endif
-  }
-}
-
-#define minimum(a, b) ((a) < (b) ? (a) : (b))
-
-
 static inline void
 _rs_init(rand_state* st, u8 *buf, size_t n)
 {
@@ -297,7 +130,7 @@ static inline void
 _rs_rekey(rand_state* st, u8 *dat, size_t datlen)
 {
     /* fill rs_buf with the keystream */
-    _chacha_encrypt_bytes(&st->rs_chacha, st->rs_buf, st->rs_buf, sizeof st->rs_buf);
+    _chacha_keystream(&st->rs_chacha, st->rs_buf, st->rs_bufsz);
 
     /* mix in optional user provided data */
     if (dat) {
@@ -313,7 +146,8 @@ _rs_rekey(rand_state* st, u8 *dat, size_t datlen)
     /* immediately reinit for backtracking resistance */
     _rs_init(st, st->rs_buf, ARC4R_KEYSZ + ARC4R_IVSZ);
     memset(st->rs_buf, 0, ARC4R_KEYSZ + ARC4R_IVSZ);
-    st->rs_have = (sizeof st->rs_buf) - ARC4R_KEYSZ - ARC4R_IVSZ;
+    st->rs_have = st->rs_bufsz - ARC4R_KEYSZ - ARC4R_IVSZ;
+    st->rs_rekeys++;
 }
 
 
@@ -322,9 +156,15 @@ _rs_stir(rand_state* st)
 {
     u8 rnd[ARC4R_KEYSZ + ARC4R_IVSZ];
 
+    pthread_once(&Ponce, _rs_getpolicy);
+    st->rs_bufsz = Rbufsz;
 
-    int r = getentropy(rnd, sizeof rnd);
-    assert(r == 0);
+    /*
+     * There's no way to report an error to the caller, and continuing
+     * without entropy would be far worse than stopping.
+     */
+    if (getentropy(rnd, sizeof rnd) != 0)
+        abort();
 
     _rs_rekey(st, rnd, sizeof(rnd));
 
@@ -332,20 +172,57 @@ _rs_stir(rand_state* st)
     st->rs_have = 0;
     memset(st->rs_buf, 0, sizeof st->rs_buf);
 
-    st->rs_count = 1600000;
+    st->rs_count = Rreseed;
+    st->rs_stirs++;
 }
 
 
+/* A request may exceed a small reseed interval, so the count stops at 0 */
 static inline void
 _rs_stir_if_needed(rand_state* st, size_t len)
 {
     if (st->rs_count <= len)
         _rs_stir(st);
 
-    st->rs_count -= len;
+    st->rs_count = st->rs_count > len ? st->rs_count - len : 0;
 }
 
 
+/*
+ * Bulk path for large requests: generate keystream straight into the
+ * caller's buffer, avoiding the copy and clear through rs_buf.  After each
+ * chunk, the key is immediately replaced from a fresh block, as in
+ * _rs_rekey(), so the output already produced can't be recovered from the
+ * state.  Any keystream still buffered in rs_buf comes from an earlier key,
+ * so it remains valid for later requests.  A chunk never runs past the
+ * reseed point, so a small reseed interval is honored here too.
+ *
+ * The length must be a multiple of the block size.
+ */
+static void
+_rs_random_bulk(rand_state* rs, u8 *buf, size_t n)
+{
+    u8 blk[ARC4R_BLOCKSZ];
+    size_t m;
+
+    while (n > 0) {
+        m = minimum(n, ARC4R_BULK_CHUNK);
+        if (rs->rs_count <= m)
+            _rs_stir(rs);
+        /* The interval is at least one block */
+        m = minimum(m, rs->rs_count & ~((size_t) ARC4R_BLOCKSZ - 1));
+        rs->rs_count -= m;
+        _chacha_keystream(&rs->rs_chacha, buf, m);
+        buf += m;
+        n   -= m;
+
+        _chacha_keystream(&rs->rs_chacha, blk, sizeof(blk));
+        _rs_init(rs, blk, ARC4R_KEYSZ + ARC4R_IVSZ);
+        memset(blk, 0, sizeof(blk));
+        rs->rs_rekeys++;
+    }
+}
+
 static inline void
 _rs_random_buf(rand_state* rs, void *_buf, size_t n)
 {
@@ -353,11 +230,19 @@ _rs_random_buf(rand_state* rs, void *_buf, size_t n)
     u8 *keystream;
     size_t m;
 
+    rs->rs_bytes += n;
+    if (n >= ARC4R_BULK_MIN) {
+        m = n & ~((size_t) ARC4R_BLOCKSZ - 1);
+        _rs_random_bulk(rs, buf, m);
+        buf += m;
+        n   -= m;
+    }
+
     _rs_stir_if_needed(rs, n);
     while (n > 0) {
         if (rs->rs_have > 0) {
             m = minimum(n, rs->rs_have);
-            keystream = rs->rs_buf + sizeof(rs->rs_buf) - rs->rs_have;
+            keystream = rs->rs_buf + rs->rs_bufsz - rs->rs_have;
             memcpy(buf, keystream, m);
             memset(keystream, 0, m);
             buf += m;
@@ -377,45 +262,113 @@ _rs_random_u32(rand_state* rs)
     _rs_stir_if_needed(rs, sizeof(val));
     if (rs->rs_have < sizeof(val))
         _rs_rekey(rs, NULL, 0);
-    keystream = rs->rs_buf + sizeof(rs->rs_buf) - rs->rs_have;
+    keystream = rs->rs_buf + rs->rs_bufsz - rs->rs_have;
     memcpy(&val, keystream, sizeof(val));
     memset(keystream, 0, sizeof(val));
     rs->rs_have -= sizeof(val);
+    rs->rs_bytes += sizeof(val);
 
     return val;
 }
 
 
-#if defined(__Darwin__) || defined(__APPLE__)
-
 /*
- * Multi-threaded support using pthread API. Needed for OS X:
+ * Per-thread state management.
+ *
+ * The state is allocated on first use and located via a pthread key, which
+ * on OS X is a cheap lookup.  (TLS isn't available before 10.7, which is
+ * all this code is built for.)  The common path is just the lookup and a
+ * comparison of the state's fork generation against the current one.
  *
- *   https://www.reddit.com/r/cpp/comments/3bg8jc/anyone_know_if_and_when_applexcode_will_support/
+ * Fork detection uses a generation counter bumped by a pthread_atfork()
+ * child handler, rather than calling getpid() on every call.  A state
+ * seeded in an earlier generation is restirred before use, so that parent
+ * and child never share keystream.  The generation starts at 1, so a
+ * zeroed state is always treated as unseeded.
+ *
+ * When a thread exits, a key destructor wipes its state, so that no key
+ * material outlives the thread.  The states are then kept on a small
+ * lock-free freelist for reuse by later threads (after a fresh stir), so
+ * that thread-per-request programs don't churn through the allocator.
+ * The freelist is a fixed array of slots, each claimed or released with a
+ * single compare-and-swap, which avoids the ABA problem of a linked stack.
  */
-static pthread_key_t     Rkey;
-static pthread_once_t    Ronce   = PTHREAD_ONCE_INIT;
-static volatile uint32_t Rforked = 0;
+static pthread_once_t    Ronce = PTHREAD_ONCE_INIT;
+static volatile uint32_t Rgen  = 1;
 
 /*
- * Fork handler to reset my context
+ * Fork handler to invalidate all inherited states.  It runs in the child,
+ * where the forking thread is the only thread.
  */
 static void
-_atfork()
+_atfork(void)
 {
-    // the pthread_atfork() callbacks called once per process.
-    // We set it to be called by the child process.
-    Rforked++;
+    Rgen++;
 }
 
+/* Wipe a state in a way the compiler can't optimize away */
+static void * (* volatile _rs_memset)(void *, int, size_t) = memset;
+
+#ifndef ARC4R_FREESLOTS
+#define ARC4R_FREESLOTS 8
+#endif
+
 /*
- * Run once and only once by pthread lib. We use the opportunity to
- * create the thread-specific key.
+ * The key is published as key+1, so that a single load both checks for
+ * initialization and provides the key, without needing a read barrier.
+ */
+static volatile unsigned long Rkeyp = 0;
+
+/* Freelist of wiped states */
+static rand_state * volatile Rfree[ARC4R_FREESLOTS];
+
+static rand_state*
+_spop(void)
+{
+    rand_state* z;
+    int i;
+
+    for (i = 0; i < ARC4R_FREESLOTS; i++) {
+        if ((z = Rfree[i]) && __sync_bool_compare_and_swap(&Rfree[i], z, 0))
+            return z;
+    }
+    return NULL;
+}
+
+static void
+_spush(rand_state* z)
+{
+    int i;
+
+    for (i = 0; i < ARC4R_FREESLOTS; i++) {
+        if (!Rfree[i] && __sync_bool_compare_and_swap(&Rfree[i], 0, z))
+            return;
+    }
+    free(z);
+}
+
+/*
+ * Thread exit destructor: wipe the state and recycle it.
+ */
+static void
+_sdestroy(void *arg)
+{
+    rand_state* z = (rand_state *)arg;
+
+    _rs_memset(z, 0, sizeof *z);
+    _spush(z);
+}
+
+/*
+ * Run once and only once by pthread lib, to register the fork handler
+ * and create the thread-specific key.
  */
 static void
-_screate()
+_screate(void)
 {
-    pthread_key_create(&Rkey, 0);
+    pthread_key_t key;
+
+    pthread_key_create(&key, _sdestroy);
     pthread_atfork(0, 0, _atfork);
 
     /*
@@ -424,62 +377,51 @@ _screate()
      */
     uint8_t buf[8];
     getentropy(buf, sizeof buf);
-}
 
+    __sync_synchronize();
+    Rkeyp = (unsigned long) key + 1;
+}
 
 /*
- * Get the per-thread rand state. Initialize if needed.
+ * Set up a new state, or restir one inherited across a fork.
  */
 static rand_state*
-_sget()
+_snew(rand_state* z, pthread_key_t key)
 {
-    pthread_once(&Ronce, _screate);
-
-    volatile pthread_key_t* k = &Rkey;
-    rand_state * z = (rand_state *)pthread_getspecific(*k);
     if (!z) {
-        z = (rand_state*)calloc(sizeof *z, 1);
+        if (!(z = _spop()))
+            z = (rand_state*)calloc(sizeof *z, 1);
         assert(z);
 
-        _rs_stir(z);
-        z->rs_pid = getpid();
-
-        pthread_setspecific(*k, z);
+        pthread_setspecific(key, z);
     }
 
-    /* Detect if a fork has happened */
-    if (Rforked > 0 || getpid() != z->rs_pid) {
-        Rforked   = 0;
-        z->rs_pid = getpid();
-        _rs_stir(z);
-    }
+    _rs_stir(z);
+    z->rs_gen = Rgen;
 
     return z;
 }
 
-#else
-
 /*
- * Use gcc extension to declare a thread-local variable.
- *
- * On most systems (including x86_64), thread-local access is
- * essentially free for non .so use cases.
- *
+ * Get the per-thread rand state. Initialize if needed.
  */
-static __thread rand_state st = { .rs_count = 0, .rs_pid = 0 };
 static inline rand_state*
-_sget()
+_sget(void)
 {
-    rand_state* s = &st;
+    unsigned long keyp = Rkeyp;
+    rand_state* z;
 
-    if (s->rs_count == 0 || getpid() != s->rs_pid) {
-        _rs_stir(s);
-        s->rs_pid = getpid();
+    if (MPLS_SLOWPATH(!keyp)) {
+        pthread_once(&Ronce, _screate);
+        keyp = Rkeyp;
     }
-    return s;
-}
 
-#endif /* __Darwin__ */
+    z = (rand_state *)pthread_getspecific(keyp - 1);
+    if (MPLS_SLOWPATH(!z || z->rs_gen != Rgen))
+        z = _snew(z, keyp - 1);
+
+    return z;
+}
 
 
 /*
@@ -535,4 +477,73 @@ arc4random_uniform(uint32_t upper_bound)
 }
 
 
+/*
+ * Fill out[0..n-1] with uniformly distributed random numbers less than
+ * upper_bound (legacy-support extension).
+ *
+ * This looks up the thread state once, draws all the initial values as a
+ * single buffer, and maps each one to the range with Lemire's
+ * multiply-shift method ("Fast Random Integer Generation in an Interval",
+ * 2019) rather than a division.  The result is the high word of
+ * r * upper_bound, and the value is rejected (and redrawn) when the low word
+ * is below 2**32 % upper_bound.  For each result k, the accepted values of
+ * r are exactly those whose low word lies in [2**32 % upper_bound, 2**32)
+ * among the run of r mapping to k, and there are exactly
+ * floor(2**32 / upper_bound) of them in every run.  So, like
+ * arc4random_uniform(), every result is equally likely, and a retry has the
+ * same probability of being needed.
+ *
+ * A count of zero does nothing (and 'out' may then be NULL), while a count
+ * whose size in bytes overflows is treated like any other invalid buffer,
+ * and aborts.
+ */
+void
+arc4random_uniform_buf(uint32_t upper_bound, uint32_t *out, size_t n)
+{
+    rand_state* z;
+    uint64_t m;
+    uint32_t min;
+    size_t i;
+
+    if (n == 0)
+        return;
+
+    /* No real buffer can be this big, so it's a caller bug */
+    if (n > SIZE_MAX / sizeof(*out))
+        abort();
+
+    if (upper_bound < 2) {
+        memset(out, 0, n * sizeof(*out));
+        return;
+    }
+
+    z = _sget();
+    _rs_random_buf(z, out, n * sizeof(*out));
+
+    /* 2**32 % x == (2**32 - x) % x */
+    min = -upper_bound % upper_bound;
+
+    for (i = 0; i < n; ++i) {
+        m = (uint64_t) out[i] * upper_bound;
+        while ((uint32_t) m < min)
+            m = (uint64_t) _rs_random_u32(z) * upper_bound;
+        out[i] = (uint32_t) (m >> 32);
+    }
+}
+
+
+/*
+ * Report the calling thread's counters (legacy-support extension).
+ */
+void
+arc4random_stats_np(struct arc4random_stats_np *stats)
+{
+    rand_state* z = _sget();
+
+    stats->rekeys = z->rs_rekeys;
+    stats->stirs  = z->rs_stirs;
+    stats->bytes  = z->rs_bytes;
+}
+
+
 #endif /* __MPLS_LIB_SUPPORT_ARC4RANDOM__ */
@@ -34,4 +34,20 @@
   #define MPLS_SLOWPATH(x) (x)
 #endif
 
+/*
+ * Memory barriers for lock-free (seqlock-style) publication of data.
+ *
+ * On x86, loads aren't reordered with other loads, nor stores with other
+ * stores, so only the compiler needs to be restrained.  Elsewhere (i.e.
+ * PowerPC), we use a full hardware barrier, since the __sync builtins
+ * available in gcc 4.2 don't offer anything lighter.
+ */
+#if defined(__i386__) || defined(__x86_64__)
+  #define MPLS_READ_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+  #define MPLS_WRITE_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+#else
+  #define MPLS_READ_BARRIER() __sync_synchronize()
+  #define MPLS_WRITE_BARRIER() __sync_synchronize()
+#endif
+
 #endif /* __MACPORTS_COMPILER_H */
@@ -23,8 +23,11 @@
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 
+#include "stdio_internal.h"
+
 /*
  * KLUDGE: Arrange to disable underlying close() in fclose().
  *
@@ -53,54 +56,22 @@
  * to operate normally (including the important fflush()).
  *
  * The issue with this approach is knowing the offset for the _close element.
- * Fortunately, a few things work in our favor:
- *   1) The '_close' element is immediately preceded by a '_cookie' element,
- *      which is actually a self pointer to the FILE itself.  This allows
- *      a fairly reliable consistency check.
- *   2) The layout of FILE (at least up through '_close') has never changed
- *      across all the OS versions, avoiding the need for version conditions.
- *   3) This code is only applicable to OS versions 10.6 and earlier, which
- *      have been frozen for ages, avoiding any future compatibility issues.
- *
- * So what we do here is to define enough of the FILE layout to cover the
- * fields of interest (skipping the rest), use a check on the '_cookie'
+ * See stdio_internal.h for why we can rely on it.  What we do here is to
+ * use the truncated FILE layout from there, use a check on the '_cookie'
  * element as a sanity check, and then (if it passes) set the '_close'
  * element to NULL.  If the sanity check fails, we leave '_close' alone,
  * which reintroduces the unwanted close() of the fd, but that's a more
  * obvious failure than releasing locks (and is tested by the accompanying
  * tests).
- *
- * Note that Apple didn't get around to hiding the private definitions
- * until the 11.x SDK, so we prefix our versions with '__mpls' to avoid
- * conflicts.
  */
 
-/* stdio buffers */
-struct __mpls__sbuf {
-	unsigned char	*_base;
-	int		_size;
-};
-
-/* stdio FILE object (truncated) */
-struct __mpls__sFILE {
-	unsigned char *_p;	/* current position in (some) buffer */
-	int	_r;		/* read space left for getc() */
-	int	_w;		/* write space left for putc() */
-	short	_flags;		/* flags, below; this FILE is free if 0 */
-	short	_file;		/* fileno, if Unix descriptor, else -1 */
-	struct	__mpls__sbuf _bf;	/* the buffer (at least 1 byte, if !NULL) */
-	int	_lbfsize;	/* 0 or -_bf._size, for inline putc */
-
-	/* operations */
-	void	*_cookie;	/* cookie passed to io functions */
-	int	(*_close)(void *);
-	/* We don't need the rest */
-};
-
-int
-vdprintf(int fildes, const char * __restrict format, va_list ap) {
+/*
+ * Output via a temporary stream, as described above.  This is only used
+ * when the formatted output can't be buffered in memory.
+ */
+static int
+vdprintf_stream(int fildes, const char * __restrict format, va_list ap) {
   FILE *stream;
-  struct __mpls__sFILE *filep;
   int ret;
   char buf[BUFSIZ];
 
@@ -113,8 +84,7 @@ vdprintf(int fildes, const char * __restrict format, va_list ap) {
   setbuffer(stream, buf, sizeof(buf));
 
   /* If the FILE looks as expected, clear the _close pointer. */
-  filep = (struct __mpls__sFILE *) stream;
-  if (filep->_cookie == filep) filep->_close = NULL;
+  if (__MPLS_FILE_OK(stream)) __MPLS_FILEP(stream)->_close = NULL;
 
   /* Do the output. */
   ret = vfprintf(stream, format, ap);
@@ -125,6 +95,117 @@ vdprintf(int fildes, const char * __restrict format, va_list ap) {
   return ret;
 }
 
+/*
+ * Write all of a buffer, continuing after short writes and EINTR.
+ * Returns 0 on success, or -1 (with errno set) on error.
+ */
+static int
+write_all(int fildes, const char *buf, size_t len) {
+  ssize_t n;
+
+  while (len > 0) {
+    n = write(fildes, buf, len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+/*
+ * The normal path formats the output into a local buffer (or a heap buffer
+ * if it doesn't fit), and writes it with a single write(), unless that's
+ * cut short.  This avoids creating a FILE for each call, and keeps each
+ * call's output together when writes are atomic (e.g. on pipes, up to
+ * PIPE_BUF bytes).
+ *
+ * Only if the heap buffer can't be allocated does vdprintf() fall back to
+ * the stream path, which writes in BUFSIZ pieces.  The vdprintf_atomic()
+ * extension fails instead, so that its output is never split by us.
+ */
+
+#define DPRINTF_LOCALBUF 1024
+
+/*
+ * Format into the local buffer, or a heap buffer if it doesn't fit.
+ * Returns the length, with *bufp set to the buffer used, or -1 on error,
+ * with *bufp NULL if the heap buffer couldn't be allocated.  The va_list
+ * is only consumed in the heap case.
+ */
+static int
+format_msg(char *localbuf, size_t localsize, char **bufp,
+           const char * __restrict format, va_list ap) {
+  va_list ap2;
+  int len;
+
+  *bufp = localbuf;
+  va_copy(ap2, ap);
+  len = vsnprintf(localbuf, localsize, format, ap2);
+  va_end(ap2);
+  if (len < (int) localsize) return len;
+
+  /* The size can't be computed as an int when len == INT_MAX */
+  if ((*bufp = malloc((size_t) len + 1)) == NULL) return -1;
+  return vsnprintf(*bufp, (size_t) len + 1, format, ap);
+}
+
+/*
+ * Common code for vdprintf() and vdprintf_atomic(), which differ only in
+ * whether they fall back to the stream path when the heap buffer can't be
+ * allocated.
+ */
+static int
+vdprintf_common(int fildes, const char * __restrict format, va_list ap,
+                int fallback) {
+  char localbuf[DPRINTF_LOCALBUF], *buf;
+  int len, ret;
+
+  len = format_msg(localbuf, sizeof(localbuf), &buf, format, ap);
+  if (buf == NULL) {
+    if (fallback) return vdprintf_stream(fildes, format, ap);
+    return -1;  /* errno == ENOMEM */
+  }
+
+  ret = len;
+  if (len > 0 && write_all(fildes, buf, len)) ret = -1;
+
+  if (buf != localbuf) free(buf);
+  return ret;
+}
+
+int
+vdprintf(int fildes, const char * __restrict format, va_list ap) {
+  return vdprintf_common(fildes, format, ap, 1);
+}
+
+/*
+ * Legacy-support extension: vdprintf() with the whole message formatted
+ * before any output, and written with one write() if possible.  Messages
+ * up to PIPE_BUF bytes are thus never interleaved with other writers on a
+ * pipe or FIFO.  If formatting fails (including for lack of memory),
+ * nothing is written.  If the write is cut short (only possible for larger
+ * messages, or other kinds of fd), the rest is written as by vdprintf().
+ */
+int
+vdprintf_atomic(int fildes, const char * __restrict format, va_list ap) {
+  return vdprintf_common(fildes, format, ap, 0);
+}
+
+int
+dprintf_atomic(int fildes, const char * __restrict format, ...) {
+  va_list ap;
+  int ret;
+
+  va_start(ap, format);
+  ret = vdprintf_atomic(fildes, format, ap);
+  va_end(ap);
+
+  return ret;
+}
+
 int
 dprintf(int fildes, const char * __restrict format, ...) {
   va_list ap;
@@ -38,6 +38,29 @@
 
 extern int __sflags(const char *, int *);
 
+/*
+ * Buffering policy.
+ *
+ * Read-only streams are fully buffered with a stdio-allocated buffer, since
+ * reads can't overrun the region.
+ *
+ * Writable streams are fully buffered as well, but with a buffer of our own,
+ * whose usable size (in the FILE) is kept no larger than the space left in
+ * the region at the position where the buffered data will be written.
+ * Thus stdio never accepts more output than fits, and a write past the end
+ * still returns the exact short object count, as with an unbuffered stream.
+ * The usable size is adjusted by fmemopen_fitbuf() in every callback, since
+ * those are the only points at which the position changes.  When the region
+ * is full, the size is one byte with no write space, so that the next write
+ * of any kind reaches the write callback and fails.  The one exception is a
+ * single putc() directly after reading to the end of a full region, which
+ * stdio accepts into the one byte, so the error is reported by the flush.
+ *
+ * If the caller replaces the buffer with setvbuf(), it's left alone.
+ */
+
+#define FMEMOPEN_BUFSIZE(size) ((size) < BUFSIZ ? (size) : BUFSIZ)
+
 struct fmemopen_cookie
 {
   char  *buf;  /* pointer to the memory region */
@@ -46,6 +69,9 @@ struct fmemopen_cookie
   size_t   size;  /* buffer length in bytes */
   size_t   len;  /* data length in bytes */
   size_t   off;  /* current offset into the buffer */
+  FILE    *fp;    /* the stream, if writable */
+  unsigned char *iobuf;   /* our stdio buffer, if writable */
+  size_t   iosize;  /* size of iobuf */
 };
 
 static int  fmemopen_read(void *cookie, char *buf, int nbytes);
@@ -53,12 +79,36 @@ static int  fmemopen_write(void *cookie, const char *buf, int nbytes);
 static fpos_t  fmemopen_seek(void *cookie, fpos_t offset, int whence);
 static int  fmemopen_close(void *cookie);
 
+/* Limit the stdio buffer to the space left in the region (see above) */
+static void
+fmemopen_fitbuf(struct fmemopen_cookie *ck)
+{
+  FILE *f = ck->fp;
+  size_t pos, room, used;
+
+  if (f == NULL || f->_bf._base != ck->iobuf)
+    return;
+
+  /* Appended data always goes at the end of the data. */
+  pos = f->_flags & __SAPP ? ck->len : ck->off;
+  room = pos < ck->size ? ck->size - pos : 0;
+  if (room > ck->iosize)
+    room = ck->iosize;
+
+  f->_bf._size = room ? room : 1;
+  if (f->_flags & __SWR) {
+    used = f->_p - f->_bf._base;
+    f->_w = room > used ? room - used : 0;
+  }
+}
+
 FILE *
 fmemopen(void * __restrict buf, size_t size, const char * __restrict mode)
 {
   struct fmemopen_cookie *ck;
   FILE *f;
-  int flags, rc;
+  int flags, rc, rdonly;
+  size_t iosize;
 
   /*
    * POSIX says we shall return EINVAL if size is 0.
@@ -87,13 +137,21 @@ fmemopen(void * __restrict buf, size_t size, const char * __restrict mode)
     return (NULL);
   }
   
-  ck = malloc(sizeof(struct fmemopen_cookie));
+  /* O_RDONLY is 0, so it can't be tested as a bit. */
+  rdonly = (flags & O_ACCMODE) == O_RDONLY;
+
+  /* Writable streams get our own stdio buffer, following the cookie. */
+  iosize = rdonly ? 0 : FMEMOPEN_BUFSIZE(size);
+  ck = malloc(sizeof(struct fmemopen_cookie) + iosize);
   if (ck == NULL) {
     return (NULL);
   }
 
   ck->off  = 0;
   ck->size = size;
+  ck->fp = NULL;
+  ck->iobuf = (unsigned char *) (ck + 1);
+  ck->iosize = iosize;
 
   /* Check whether we have to allocate the buffer ourselves. */
   ck->own = ((ck->buf = buf) == NULL);
@@ -143,7 +201,7 @@ fmemopen(void * __restrict buf, size_t size, const char * __restrict mode)
 
   f = funopen(ck,
       flags & O_WRONLY ? NULL : fmemopen_read, 
-      flags & O_RDONLY ? NULL : fmemopen_write,
+      rdonly ? NULL : fmemopen_write,
       fmemopen_seek, fmemopen_close);
 
   if (f == NULL) {
@@ -156,11 +214,14 @@ fmemopen(void * __restrict buf, size_t size, const char * __restrict mode)
   if (mode[0] == 'a')
     f->_flags |= __SAPP;
 
-  /*
-   * Turn off buffering, so a write past the end of the buffer
-   * correctly returns a short object count.
-   */
-  setvbuf(f, NULL, _IONBF, 0);
+  /* Set up the buffering.  See above. */
+  if (rdonly) {
+    setvbuf(f, NULL, _IOFBF, FMEMOPEN_BUFSIZE(size));
+  } else {
+    setvbuf(f, (char *) ck->iobuf, _IOFBF, iosize);
+    ck->fp = f;
+    fmemopen_fitbuf(ck);
+  }
 
   return (f);
 }
@@ -179,6 +240,7 @@ fmemopen_read(void *cookie, char *buf, int nbytes)
   memcpy(buf, ck->buf + ck->off, nbytes);
 
   ck->off += nbytes;
+  fmemopen_fitbuf(ck);
 
   return (nbytes);
 }
@@ -188,6 +250,15 @@ fmemopen_write(void *cookie, const char *buf, int nbytes)
 {
   struct fmemopen_cookie *ck = cookie;
 
+  /*
+   * Writing to a full buffer is an error, so that it's reported by fflush()
+   * and fclose() if the caller has set up a larger buffer.
+   */
+  if (nbytes > 0 && ck->off >= ck->size) {
+    errno = ENOSPC;
+    return (-1);
+  }
+
   if (nbytes > ck->size - ck->off)
     nbytes = ck->size - ck->off;
 
@@ -210,6 +281,8 @@ fmemopen_write(void *cookie, const char *buf, int nbytes)
   if (!ck->bin && ck->off < ck->size && ck->buf[ck->off - 1] != '\0')
     ck->buf[ck->off] = '\0';
 
+  fmemopen_fitbuf(ck);
+
   return (nbytes);
 }
 
@@ -249,6 +322,8 @@ fmemopen_seek(void *cookie, fpos_t offset, int whence)
     return (-1);
   }
 
+  fmemopen_fitbuf(ck);
+
   return (ck->off);
 }
 
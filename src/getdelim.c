@@ -38,23 +38,119 @@
 #include "getdelim.h"
 
 #include <limits.h>
+#include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 
+#include "compiler.h"
+#include "stdio_internal.h"
+
 #ifndef SIZE_MAX
 # define SIZE_MAX ((size_t) -1)
 #endif
 #ifndef SSIZE_MAX
 # define SSIZE_MAX ((ssize_t) (SIZE_MAX / 2))
 #endif
-#if !defined(HAVE_FLOCKFILE) || !HAVE_FLOCKFILE
-# undef flockfile
-# define flockfile(x) ((void) 0)
-#endif
-#if !defined(HAVE_FUNLOCKFILE) || !HAVE_FUNLOCKFILE
-# undef funlockfile
-# define funlockfile(x) ((void) 0)
-#endif
+
+/*
+ * The stream is locked once for the whole call.  For ordinary streams
+ * (see stdio_internal.h), the buffered data is scanned in place with
+ * memchr(), and copied in whole chunks up to and including the delimiter.
+ * When the buffer is empty, getc_unlocked() refills it through the normal
+ * stdio path (which also takes care of any ungetc() data), and the
+ * character it returns is stored individually.  Other streams just use
+ * getc_unlocked() for everything.
+ *
+ * The line buffer grows by doubling, or to the needed size if larger.
+ *
+ * getdelim_view() is a legacy-support extension which avoids the copy when
+ * the whole line is already in the stream buffer, by returning a pointer
+ * into it.  Otherwise (the line straddles a refill, or it's not an ordinary
+ * stream), it falls back to the getdelim() code, using a per-thread line
+ * buffer.  The result is valid until the next operation on the stream, or
+ * the next getdelim_view() call in the same thread, whichever comes first.
+ */
+
+/* Make room for NEED bytes plus a terminator */
+static int
+grow(char **buf, size_t *bufsiz, size_t need)
+{
+	size_t nbufsiz;
+	char *nbuf;
+
+	if (MPLS_FASTPATH(need < *bufsiz))
+		return 0;
+	if (need >= (size_t) SSIZE_MAX) {
+		errno = EOVERFLOW;
+		return -1;
+	}
+	nbufsiz = *bufsiz <= (size_t) SSIZE_MAX / 2 ? *bufsiz * 2 : 0;
+	if (nbufsiz <= need)
+		nbufsiz = need + 1;
+	if ((nbuf = realloc(*buf, nbufsiz)) == NULL)
+		return -1;
+	*buf = nbuf;
+	*bufsiz = nbufsiz;
+	return 0;
+}
+
+/* The body of getdelim(), with the stream already locked */
+static ssize_t
+getdelim_locked(char **buf, size_t *bufsiz, int delimiter, FILE *fp)
+{
+	struct __mpls__sFILE *f = __MPLS_FILEP(fp);
+	unsigned char *p, *q;
+	size_t len = 0, n;
+	ssize_t ret = -1;
+	int c, bulk = __MPLS_FILE_OK(fp);
+
+	if (*buf == NULL || *bufsiz == 0) {
+		char *nbuf;
+
+		if ((nbuf = realloc(*buf, BUFSIZ)) == NULL)
+			return -1;
+		*buf = nbuf;
+		*bufsiz = BUFSIZ;
+	}
+
+	for (;;) {
+		if (bulk && f->_r > 0) {
+			p = f->_p;
+			n = f->_r;
+			if ((q = memchr(p, delimiter, n)) != NULL)
+				n = q - p + 1;
+			if (grow(buf, bufsiz, len + n) < 0)
+				break;
+			memcpy(*buf + len, p, n);
+			len += n;
+			f->_p += n;
+			f->_r -= n;
+			if (q != NULL) {
+				ret = len;
+				break;
+			}
+			continue;
+		}
+
+		c = getc_unlocked(fp);
+		if (c == EOF) {
+			if (len > 0 && feof(fp))
+				ret = len;
+			break;
+		}
+		if (grow(buf, bufsiz, len + 1) < 0)
+			break;
+		(*buf)[len++] = c;
+		if (c == delimiter) {
+			ret = len;
+			break;
+		}
+	}
+
+	(*buf)[len] = '\0';
+	return ret;
+}
 
 /* Read up to (and including) a DELIMITER from FP into *LINEPTR (and
    NUL-terminate it).  *LINEPTR is a pointer returned from malloc (or
@@ -65,40 +161,110 @@
 ssize_t
 getdelim(char **buf, size_t *bufsiz, int delimiter, FILE *fp)
 {
-	char *ptr, *eptr;
+	ssize_t ret;
 
+	if (buf == NULL || bufsiz == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
 
-	if (*buf == NULL || *bufsiz == 0) {
-		*bufsiz = BUFSIZ;
-		if ((*buf = malloc(*bufsiz)) == NULL)
-			return -1;
+	flockfile(fp);
+	ret = getdelim_locked(buf, bufsiz, (unsigned char) delimiter, fp);
+	funlockfile(fp);
+	return ret;
+}
+
+/* Per-thread line buffer for getdelim_view() */
+typedef struct view_buf_s {
+	char	*buf;
+	size_t	bufsiz;
+} view_buf_t;
+
+static pthread_key_t view_key;
+static pthread_once_t view_once = PTHREAD_ONCE_INIT;
+static int view_key_err;
+
+static void
+view_buf_free(void *arg)
+{
+	view_buf_t *vb = arg;
+
+	free(vb->buf);
+	free(vb);
+}
+
+static void
+view_key_init(void)
+{
+	view_key_err = pthread_key_create(&view_key, view_buf_free);
+}
+
+static view_buf_t *
+get_view_buf(void)
+{
+	view_buf_t *vb;
+
+	if (pthread_once(&view_once, view_key_init) || view_key_err) {
+		errno = ENOMEM;
+		return NULL;
 	}
+	if (MPLS_FASTPATH((vb = pthread_getspecific(view_key)) != NULL))
+		return vb;
+	if ((vb = calloc(1, sizeof(*vb))) == NULL)
+		return NULL;
+	if (pthread_setspecific(view_key, vb)) {
+		free(vb);
+		errno = ENOMEM;
+		return NULL;
+	}
+	return vb;
+}
 
-	for (ptr = *buf, eptr = *buf + *bufsiz;;) {
-		int c = fgetc(fp);
-		if (c == -1) {
-			if (feof(fp))
-				return ptr == *buf ? -1 : ptr - *buf;
-			else
-				return -1;
-		}
-		*ptr++ = c;
-		if (c == delimiter) {
-			*ptr = '\0';
-			return ptr - *buf;
-		}
-		if (ptr + 2 >= eptr) {
-			char *nbuf;
-			size_t nbufsiz = *bufsiz * 2;
-			ssize_t d = ptr - *buf;
-			if ((nbuf = realloc(*buf, nbufsiz)) == NULL)
-				return -1;
-			*buf = nbuf;
-			*bufsiz = nbufsiz;
-			eptr = nbuf + nbufsiz;
-			ptr = nbuf + d;
+/* Return a view of the next line (including any delimiter), not
+   NUL-terminated, in *START and *LEN.  Returns 0 on success, or -1 on
+   error or EOF.  */
+
+int
+getdelim_view(FILE *fp, int delimiter, const char **start, size_t *len)
+{
+	struct __mpls__sFILE *f = __MPLS_FILEP(fp);
+	unsigned char *p, *q;
+	view_buf_t *vb;
+	ssize_t ret;
+
+	if (start == NULL || len == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	delimiter = (unsigned char) delimiter;
+
+	flockfile(fp);
+
+	/* If the whole line is buffered, just point at it */
+	if (__MPLS_FILE_OK(fp) && f->_r > 0) {
+		p = f->_p;
+		if ((q = memchr(p, delimiter, f->_r)) != NULL) {
+			*start = (const char *) p;
+			*len = q - p + 1;
+			f->_p += *len;
+			f->_r -= *len;
+			funlockfile(fp);
+			return 0;
 		}
 	}
+
+	/* Otherwise, copy it */
+	if ((vb = get_view_buf()) == NULL) {
+		funlockfile(fp);
+		return -1;
+	}
+	ret = getdelim_locked(&vb->buf, &vb->bufsiz, delimiter, fp);
+	funlockfile(fp);
+	if (ret < 0)
+		return -1;
+	*start = vb->buf;
+	*len = ret;
+	return 0;
 }
 
 #endif /* __MPLS_LIB_SUPPORT_GETLINE__ */
@@ -1,4 +1,3 @@
-
 /*
  * Copyright (c) 2021
  *
@@ -19,71 +18,152 @@
 #include "MacportsLegacySupport.h"
 #if __MPLS_LIB_SUPPORT_GETENTROPY__
 
+#include <dlfcn.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
-#include <stdlib.h>
-#include <string.h>
 #include <unistd.h>
-#include <sys/types.h>
 #include <sys/random.h>
-#include <stdio.h>
-#include <stdarg.h>
-#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "compiler.h"
+
+/*
+ * getentropy() for systems without it.
+ *
+ * There are two backends:
+ *
+ *   1) The OS getentropy(), when running on a system that has one (10.12+),
+ *      even though we were built for an earlier target.  It's located with
+ *      dlsym() on first use, and the result (including absence) is cached.
+ *
+ *   2) Otherwise, reads from /dev/urandom via a cached fd.  The fd is opened
+ *      close-on-exec and published with a compare-and-swap, so concurrent
+ *      first calls are safe (the loser closes its own fd).  Since the
+ *      application may close the fd or dup2() something else over it, the
+ *      fd is checked with fstat() before each use, and if it's no longer the
+ *      random device, a new one is opened.  The stale fd number is never
+ *      closed, since it now belongs to someone else.
+ *
+ * As in the OS version, requests larger than GETENTROPY_MAX bytes fail with
+ * EIO, and all errors are reported via errno and a -1 return, never by
+ * exiting.
+ */
+
+#define GETENTROPY_MAX  256
+#define RANDOM_DEV      "/dev/urandom"
+
+typedef int (getentropy_fn_t)(void *buf, size_t buflen);
 
-void
-_error(int doexit, int err, const char* fmt, ...)
+/* Sentinel for "looked up, and absent" */
+#define NO_OS_FUNC ((getentropy_fn_t *) 1)
+
+static getentropy_fn_t * volatile os_getentropy = NULL;
+
+static volatile int rnd_fd = -1;
+static volatile dev_t rnd_rdev;
+
+static getentropy_fn_t *
+get_os_getentropy(void)
 {
-    va_list ap;
+  getentropy_fn_t *func = os_getentropy;
 
-    fflush(stdout);
-    fflush(stderr);
-    va_start(ap, fmt);
-    vfprintf(stderr, fmt, ap);
-    va_end(ap);
+  if (MPLS_FASTPATH(func)) return func;
 
-    if (err > 0)
-        fprintf(stderr, "\n  %s (Errno %d)\n", strerror(err), err);
+  func = (getentropy_fn_t *) dlsym(RTLD_NEXT, "getentropy");
+  if (!func || func == &getentropy) func = NO_OS_FUNC;
+  return os_getentropy = func;
+}
 
-    if (doexit) {
-        fflush(stderr);
-        exit(1);
-    }
+/* Check whether an fd (still) refers to the random device */
+static int
+is_random_fd(int fd, dev_t rdev)
+{
+  struct stat st;
+
+  return fstat(fd, &st) == 0 && S_ISCHR(st.st_mode) && st.st_rdev == rdev;
 }
 
+/* Open the random device, returning fd or -1 */
 static int
-_randopen(const char* name)
+open_random(void)
 {
-    int fd = open(name, O_RDONLY);
-    if (fd < 0) {
-      _error(1, errno, "Cannot open system random number dev %s", name);
-    }
+  int fd, flags = O_RDONLY | O_NOCTTY;
+  struct stat st;
+
+#ifdef O_CLOEXEC
+  flags |= O_CLOEXEC;
+#endif
 
-    return fd;
+  do {
+    fd = open(RANDOM_DEV, flags);
+  } while (fd < 0 && errno == EINTR);
+  if (fd < 0) return -1;
+
+#ifndef O_CLOEXEC
+  (void) fcntl(fd, F_SETFD, FD_CLOEXEC);
+#endif
+
+  if (fstat(fd, &st) < 0 || !S_ISCHR(st.st_mode)) {
+    (void) close(fd);
+    errno = EIO;
+    return -1;
+  }
+  rnd_rdev = st.st_rdev;
+  return fd;
+}
+
+/* Get a usable fd for the random device, opening it if needed */
+static int
+get_random_fd(void)
+{
+  int fd, newfd;
+
+  while (1) {
+    fd = rnd_fd;
+    if (MPLS_FASTPATH(fd >= 0 && is_random_fd(fd, rnd_rdev))) return fd;
+
+    if ((newfd = open_random()) < 0) return -1;
+    if (__sync_bool_compare_and_swap(&rnd_fd, fd, newfd)) return newfd;
+
+    /* Someone else got there first - use theirs */
+    (void) close(newfd);
+  }
 }
 
 int
 getentropy(void* buf, size_t n)
 {
-  
-    static int fd = -1;
-    uint8_t* b    = (uint8_t*)buf;
-
-    if (fd < 0)
-        fd = _randopen("/dev/urandom");
-
-    while (n > 0)
-    {
-        ssize_t m = (read)(fd, b, n);
-
-        if (m < 0) {
-            if (errno == EINTR) continue;
-            _error(1, errno, "Fatal read error while reading rand dev");
-        }
-        b += m;
-        n -= m;
+  getentropy_fn_t *func;
+  uint8_t *b = (uint8_t *) buf;
+  ssize_t m;
+  int fd;
+
+  if (n > GETENTROPY_MAX) {
+    errno = EIO;
+    return -1;
+  }
+
+  if ((func = get_os_getentropy()) != NO_OS_FUNC) return (*func)(buf, n);
+
+  if ((fd = get_random_fd()) < 0) return -1;
+
+  while (n > 0) {
+    m = read(fd, b, n);
+    if (m < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    if (m == 0) {
+      errno = EIO;
+      return -1;
     }
+    b += m;
+    n -= m;
+  }
 
-    return 0;
+  return 0;
 }
 
 #endif /* __MPLS_LIB_SUPPORT_GETENTROPY__ */
@@ -26,25 +26,241 @@
  * SUCH DAMAGE.
  */
 
+/*
+ * The Two-Way search is adapted for MacportsLegacySupport from:
+ *  https://git.musl-libc.org/cgit/musl/tree/src/string/memmem.c
+ * License text (excerpt below):
+ *  https://git.musl-libc.org/cgit/musl/tree/COPYRIGHT
+ *
+ * musl as a whole is licensed under the following standard MIT license:
+ *
+ * Copyright © 2005-2020 Rich Felker, et al.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
 /* MP support header */
 #include "MacportsLegacySupport.h"
 #if __MPLS_LIB_SUPPORT_MEMMEM__
 
 #include <sys/cdefs.h>
+#include <stddef.h>
 #include <string.h>
 
-#include "strnlen.h"
+#include "compiler.h"
 
 /*
  * Find the first occurrence of the byte string s in byte string l.
+ *
+ * There are three strategies, depending on the needle length:
+ *
+ *   1) A one-byte needle is just memchr().
+ *
+ *   2) Short needles use a prefilter that looks for positions where both
+ *      the first and the last byte of the needle match, before comparing
+ *      the rest.  With SSE2, this tests 16 positions at a time; otherwise
+ *      it uses memchr() to find the first byte.  On adversarial inputs,
+ *      nearly every position can pass the prefilter, so the verification
+ *      work is tracked, and if it gets out of proportion to the distance
+ *      scanned, the rest of the search is handed to Two-Way.
+ *
+ *   3) Long needles use the Crochemore-Perrin Two-Way algorithm, combined
+ *      with a bad-character shift table on the last byte of the window.
+ *      The shift table gives sublinear skipping on typical data, while
+ *      Two-Way bounds the worst case to linear time and constant space.
+ *
+ * As in the original code, an empty needle or haystack never matches.
+ */
+
+#if defined(__SSE2__) && !defined(MEMMEM_NO_SIMD)
+#define MEMMEM_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/* Longest needle handled by the prefilter */
+#define SHORT_NEEDLE    32
+
+/*
+ * Limit on the prefilter's verification work (in needle lengths compared),
+ * relative to the haystack distance covered, before switching to Two-Way.
  */
+#define VERIFY_RATIO    4
+#define VERIFY_SLACK    256
+
+#define MAX(a,b) ((a)>(b)?(a):(b))
+#define BITOP(a,b,op) \
+  ((a)[(size_t)(b)/(8*sizeof *(a))] op (size_t)1<<((size_t)(b)%(8*sizeof *(a))))
+
+static const unsigned char *
+twoway_memmem(const unsigned char *h, const unsigned char *z,
+              const unsigned char *n, size_t l)
+{
+  size_t i, ip, jp, k, p, ms, p0, mem, mem0;
+  size_t byteset[32 / sizeof(size_t)] = { 0 };
+  size_t shift[256];
+
+  /* Fill the byte set and the shift table */
+  for (i = 0; i < l; i++) {
+    BITOP(byteset, n[i], |=);
+    shift[n[i]] = i + 1;
+  }
+
+  /* Compute maximal suffix */
+  ip = -1; jp = 0; k = p = 1;
+  while (jp + k < l) {
+    if (n[ip+k] == n[jp+k]) {
+      if (k == p) {
+        jp += p;
+        k = 1;
+      } else k++;
+    } else if (n[ip+k] > n[jp+k]) {
+      jp += k;
+      k = 1;
+      p = jp - ip;
+    } else {
+      ip = jp++;
+      k = p = 1;
+    }
+  }
+  ms = ip;
+  p0 = p;
+
+  /* And with the opposite comparison */
+  ip = -1; jp = 0; k = p = 1;
+  while (jp + k < l) {
+    if (n[ip+k] == n[jp+k]) {
+      if (k == p) {
+        jp += p;
+        k = 1;
+      } else k++;
+    } else if (n[ip+k] < n[jp+k]) {
+      jp += k;
+      k = 1;
+      p = jp - ip;
+    } else {
+      ip = jp++;
+      k = p = 1;
+    }
+  }
+  if (ip + 1 > ms + 1) ms = ip;
+  else p = p0;
+
+  /* Periodic needle? */
+  if (memcmp(n, n + p, ms + 1)) {
+    mem0 = 0;
+    p = MAX(ms, l - ms - 1) + 1;
+  } else mem0 = l - p;
+  mem = 0;
+
+  /* Search loop */
+  for (;;) {
+    /* If remainder of haystack is shorter than needle, done */
+    if ((size_t) (z - h) < l) return NULL;
+
+    /* Check last byte first; advance by shift on mismatch */
+    if (BITOP(byteset, h[l-1], &)) {
+      k = l - shift[h[l-1]];
+      if (k) {
+        if (k < mem) k = mem;
+        h += k;
+        mem = 0;
+        continue;
+      }
+    } else {
+      h += l;
+      mem = 0;
+      continue;
+    }
+
+    /* Compare right half */
+    for (k = MAX(ms + 1, mem); k < l && n[k] == h[k]; k++);
+    if (k < l) {
+      h += k - ms;
+      mem = 0;
+      continue;
+    }
+    /* Compare left half */
+    for (k = ms + 1; k > mem && n[k-1] == h[k-1]; k--);
+    if (k <= mem) return h;
+    h += p;
+    mem = mem0;
+  }
+}
+
+/*
+ * First/last byte prefilter for short needles (2 <= l <= SHORT_NEEDLE).
+ * The haystack [h, z) must be at least as long as the needle.
+ */
+static const unsigned char *
+short_memmem(const unsigned char *h, const unsigned char *z,
+             const unsigned char *n, size_t l)
+{
+  const unsigned char *cur = h, *last = z - l;
+  const unsigned char first = n[0], lastc = n[l-1];
+  size_t work = 0;
+
+#ifdef MEMMEM_SSE2
+  const __m128i vfirst = _mm_set1_epi8(first);
+  const __m128i vlast = _mm_set1_epi8(lastc);
+  __m128i a, b;
+  unsigned int mask;
+  int bit;
+
+  /* Both loads stay within the haystack for all 16 positions */
+  while (last - cur >= 15) {
+    a = _mm_loadu_si128((const __m128i *) cur);
+    b = _mm_loadu_si128((const __m128i *) (cur + l - 1));
+    mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, vfirst),
+                                           _mm_cmpeq_epi8(b, vlast)));
+    while (mask) {
+      bit = __builtin_ctz(mask);
+      if (!memcmp(cur + bit + 1, n + 1, l - 2)) return cur + bit;
+      if (MPLS_SLOWPATH((work += l)
+                        > (size_t) (cur - h) * VERIFY_RATIO + VERIFY_SLACK)) {
+        return twoway_memmem(cur + bit + 1, z, n, l);
+      }
+      mask &= mask - 1;
+    }
+    cur += 16;
+  }
+#endif /* MEMMEM_SSE2 */
+
+  while (cur <= last) {
+    if (!(cur = memchr(cur, first, last - cur + 1))) return NULL;
+    if (cur[l-1] == lastc && !memcmp(cur + 1, n + 1, l - 2)) return cur;
+    ++cur;
+    if (MPLS_SLOWPATH((work += l)
+                      > (size_t) (cur - h) * VERIFY_RATIO + VERIFY_SLACK)) {
+      return twoway_memmem(cur, z, n, l);
+    }
+  }
+
+  return NULL;
+}
 
 void *
 memmem(const void *l, size_t l_len, const void *s, size_t s_len)
 {
-  register char *cur, *last;
-  const char *cl = (const char *)l;
-  const char *cs = (const char *)s;
+  const unsigned char *cl = (const unsigned char *)l;
+  const unsigned char *cs = (const unsigned char *)s;
+  const unsigned char *cur;
 
   /* we need something to compare */
   if (l_len == 0 || s_len == 0)
@@ -58,14 +274,14 @@ memmem(const void *l, size_t l_len, const void *s, size_t s_len)
   if (s_len == 1)
     return memchr(l, (int)*cs, l_len);
 
-  /* the last position where its possible to find "s" in "l" */
-  last = (char *)cl + l_len - s_len;
+  if (s_len <= SHORT_NEEDLE)
+    return (void *)short_memmem(cl, cl + l_len, cs, s_len);
 
-  for (cur = (char *)cl; cur <= last; cur++)
-    if (cur[0] == cs[0] && memcmp(cur, cs, s_len) == 0)
-      return cur;
+  /* skip to the first possible match before setting up Two-Way */
+  if (!(cur = memchr(cl, *cs, l_len - s_len + 1)))
+    return NULL;
 
-  return NULL;
+  return (void *)twoway_memmem(cur, cl + l_len, cs, s_len);
 }
 
 #endif /* __MPLS_LIB_SUPPORT_MEMMEM__ */
@@ -35,6 +35,14 @@
  *     Moving the file position past the  end of the data already written fills
  *     the intervening space with zeros.
  *
+ *     The stream  is also open for reading,  so it may be used  as a growable
+ *     scratch buffer:  data written may be  read back in place,  at any file
+ *     position, and overwritten.  As  with any  update stream,  an fseek(3) or
+ *     fflush(3)  is needed  when switching  between reading  and writing.  The
+ *     size  stored  at  sizep  on  fclose(3)  is  truncated  to  the  current
+ *     position,  so after  reading,  use  fseek(3) and  fflush(3)  to set the
+ *     position first.
+ *
  * RETURN VALUE
  *     Upon  successful  completion open_memstream()  returns  a FILE  pointer.
  *     Otherwise, NULL is returned and errno is set to indicate the error.
@@ -50,20 +58,62 @@
 #if __MPLS_LIB_SUPPORT_OPEN_MEMSTREAM__
 
 #include "stdio.h"
+#include "wchar.h"
 
+#include <limits.h>
+#include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <pthread.h>
+
+#include "compiler.h"
+#include "stdio_internal.h"
+#include "util.h"
 
 #define min(X, Y) (((X) < (Y)) ? (X) : (Y))
 
+/*
+ * Buffer growth policy.
+ *
+ * MEMSTREAM_INITCAP is the initial buffer capacity in bytes, and
+ * MEMSTREAM_GROWTH is the factor (in percent) by which the capacity grows
+ * when more space is needed.  Both may be overridden at build time, and
+ * at runtime with the environment variables below, which are read once
+ * per process; invalid or out-of-range values are ignored, as are both
+ * variables in setuid or setgid programs.
+ *
+ * Only the terminating null byte is cleared when the buffer grows, except
+ * that seeking past the end zero-fills the gap, as required.
+ */
+
+#ifndef MEMSTREAM_INITCAP
+#define MEMSTREAM_INITCAP 4096
+#endif
+#ifndef MEMSTREAM_GROWTH
+#define MEMSTREAM_GROWTH  200
+#endif
+
+#define MEMSTREAM_INITCAP_MIN 16
+#define MEMSTREAM_INITCAP_MAX (1UL << 30)
+#define MEMSTREAM_GROWTH_MIN  110
+#define MEMSTREAM_GROWTH_MAX  1000
+
+#define MEMSTREAM_INITCAP_VAR "MPLS_MEMSTREAM_INITCAP"
+#define MEMSTREAM_GROWTH_VAR  "MPLS_MEMSTREAM_GROWTH"
+
+static size_t         ms_initcap = MEMSTREAM_INITCAP;
+static size_t         ms_growth  = MEMSTREAM_GROWTH;
+static pthread_once_t ms_once    = PTHREAD_ONCE_INIT;
+
 struct memstream
 {
-    int      position;
-    int      size;
-    int      capacity;
+    size_t   position;
+    size_t   size;
+    size_t   capacity;
     char    *contents;
     char   **ptr;
     size_t  *sizeloc;
@@ -73,9 +123,9 @@ struct memstream
   static void memstream_print(struct memstream *ms)
   {
       printf("memstream %p {", ms);
-      printf(" %i", ms->position);
-      printf(" %i", ms->size);
-      printf(" %i", ms->capacity);
+      printf(" %lu", (unsigned long) ms->position);
+      printf(" %lu", (unsigned long) ms->size);
+      printf(" %lu", (unsigned long) ms->capacity);
       printf(" %p", ms->contents);
       printf(" }\n");
   }
@@ -87,24 +137,49 @@ struct memstream
 
 #define memstream_check(MS) if (!(MS)->contents) { errno= ENOMEM;  return -1; }
 
-static int memstream_grow(struct memstream *ms, int minsize)
+static void memstream_getpolicy(void)
+{
+    ms_initcap= __mpls_getenv_size(MEMSTREAM_INITCAP_VAR,
+				   MEMSTREAM_INITCAP_MIN, MEMSTREAM_INITCAP_MAX,
+				   MEMSTREAM_INITCAP);
+    ms_growth= __mpls_getenv_size(MEMSTREAM_GROWTH_VAR,
+				  MEMSTREAM_GROWTH_MIN, MEMSTREAM_GROWTH_MAX,
+				  MEMSTREAM_GROWTH);
+}
+
+/* Grow the buffer to hold at least minsize bytes plus the terminator */
+static int memstream_grow(struct memstream *ms, size_t minsize)
 {
-    int newcap= ms->capacity * 2;					memstream_check(ms);
-    while (newcap <= minsize) newcap *= 2;				memstream_info(("grow %p to %i\n", ms, newcap));
-    ms->contents= realloc(ms->contents, newcap);
-    if (!ms->contents) return -1;	/* errno == ENOMEM */
-    memset(ms->contents + ms->capacity, 0, newcap - ms->capacity);
+    size_t newcap;
+    char *newbuf;							memstream_check(ms);
+    if (minsize >= SIZE_MAX - 1) { errno= ENOMEM;  return -1; }
+    newcap= ms->capacity <= SIZE_MAX / ms_growth
+	    ? ms->capacity * ms_growth / 100 : SIZE_MAX;
+    if (newcap <= minsize) newcap= minsize + 1;				memstream_info(("grow %p to %lu\n", ms, (unsigned long) newcap));
+    newbuf= realloc(ms->contents, newcap);
+    if (!newbuf) return -1;	/* errno == ENOMEM */
+    ms->contents= newbuf;
     ms->capacity= newcap;
     *ms->ptr= ms->contents;		/* size has not changed */
     return 0;
 }
 
+/* Extend the data to newsize, zero-filling any gap */
+static void memstream_extend(struct memstream *ms, size_t newsize)
+{
+    if (newsize > ms->size) {
+	memset(ms->contents + ms->size, 0, newsize - ms->size);
+	*ms->sizeloc= ms->size= newsize;
+    }
+    ms->contents[ms->size]= 0;
+}
+
 static int memstream_read(void *cookie, char *buf, int count)
 {
     struct memstream *ms= (struct memstream *)cookie;			memstream_check(ms);
-    int n= min(ms->size - ms->position, count);				memstream_info(("memstream_read %p %i\n", ms, count));
+    size_t n= min(ms->size - ms->position, (size_t) count);		memstream_info(("memstream_read %p %i\n", ms, count));
     if (n < 1) return 0;
-    memcpy(buf, ms->contents, n);
+    memcpy(buf, ms->contents + ms->position, n);
     ms->position += n;							memstream_print(ms);
     return n;
 }
@@ -112,12 +187,16 @@ static int memstream_read(void *cookie, char *buf, int count)
 static int memstream_write(void *cookie, const char *buf, int count)
 {
     struct memstream *ms= (struct memstream *)cookie;			memstream_check(ms);
-    if (ms->capacity <= ms->position + count)
+    if (MPLS_SLOWPATH(count < 0)) { errno= EINVAL;  return -1; }
+    if (ms->capacity - ms->position <= (size_t) count)
 	if (memstream_grow(ms, ms->position + count) < 0)		/* errno == ENOMEM */
 	    return -1;
     memcpy(ms->contents + ms->position, buf, count);			memstream_info(("memstream_write %p %i\n", ms, count));
     ms->position += count;
-    if (ms->size < ms->position) *ms->sizeloc= ms->size= ms->position;	memstream_print(ms);
+    if (ms->size < ms->position) {
+	*ms->sizeloc= ms->size= ms->position;
+	ms->contents[ms->size]= 0;
+    }									memstream_print(ms);
 									assert(ms->size < ms->capacity);
 									assert(ms->contents[ms->size] == 0);
     return count;
@@ -127,16 +206,21 @@ static fpos_t memstream_seek(void *cookie, fpos_t offset, int whence)
 {
     struct memstream *ms= (struct memstream *)cookie;
     fpos_t pos= 0;							memstream_check(ms);
-									memstream_info(("memstream_seek %p %i %i\n", ms, (int)offset, whence));
+									memstream_info(("memstream_seek %p %lld %i\n", ms, (long long)offset, whence));
     switch (whence) {
 	case SEEK_SET:	pos= offset;			break;
 	case SEEK_CUR:	pos= ms->position + offset;	break;
 	case SEEK_END:	pos= ms->size + offset;		break;
 	default:	errno= EINVAL;			return -1;
     }
-    if (pos >= ms->capacity) memstream_grow(ms, pos);
+    if (pos < 0 || (unsigned long long) pos >= SIZE_MAX - 1) {
+	errno= EINVAL;
+	return -1;
+    }
+    if ((size_t) pos >= ms->capacity && memstream_grow(ms, pos) < 0)
+	return -1;	/* errno == ENOMEM */
     ms->position= pos;
-    if (ms->size < ms->position) *ms->sizeloc= ms->size= ms->position;	memstream_print(ms);  memstream_info(("=> %i\n", (int)pos));
+    memstream_extend(ms, ms->position);					memstream_print(ms);  memstream_info(("=> %lld\n", (long long)pos));
 									assert(ms->size < ms->capacity && ms->contents[ms->size] == 0);
     return pos;
 }
@@ -157,9 +241,11 @@ FILE *open_memstream(char **ptr, size_t *sizeloc)
     if (ptr && sizeloc) {
 	struct memstream *ms= calloc(1, sizeof(struct memstream));
 	FILE *fp= 0;							if (!ms) return 0;	/* errno == ENOMEM */
+	(void) pthread_once(&ms_once, memstream_getpolicy);
 	ms->position= ms->size= 0;
-	ms->capacity= 4096;
-	ms->contents= calloc(ms->capacity, 1);				if (!ms->contents) { free(ms);  return 0; } /* errno == ENOMEM */
+	ms->capacity= ms_initcap;
+	ms->contents= malloc(ms->capacity);				if (!ms->contents) { free(ms);  return 0; } /* errno == ENOMEM */
+	ms->contents[0]= 0;
 	ms->ptr= ptr;
 	ms->sizeloc= sizeloc;
 	memstream_print(ms);
@@ -177,4 +263,519 @@ FILE *open_memstream(char **ptr, size_t *sizeloc)
     return 0;
 }
 
+/*
+ * open_wmemstream()
+ *
+ * The wide-character version uses the same growth policy, with sizes
+ * counted in wide characters (the initial capacity in bytes is divided by
+ * sizeof(wchar_t)).  Stdio converts wide output to multibyte characters in
+ * the current locale before it reaches a funopen() write function, which
+ * would lose any character the locale can't represent (in the C locale,
+ * anything beyond 0xFF).  So the wide output functions are replaced below
+ * with versions that recognize a wmemstream and store the characters
+ * directly, independent of the locale.
+ *
+ * As in other implementations, the stream is write-only and wide-oriented,
+ * and seek offsets count wide characters.  The stream is unbuffered, so no
+ * output waits in stdio, and ftell() is exact at any time.  Byte output
+ * (which is undefined on a wide-oriented stream) still goes through the
+ * write function, which converts it back from the current locale, keeping
+ * the conversion state across calls.
+ */
+
+struct wmemstream
+{
+    size_t     position;
+    size_t     size;
+    size_t     capacity;
+    wchar_t   *contents;
+    wchar_t  **ptr;
+    size_t    *sizeloc;
+    mbstate_t  mbstate;
+    int        partial;	/* mbstate holds an incomplete character */
+};
+
+#define WMEMSTREAM_MAXCAP (SIZE_MAX / sizeof(wchar_t))
+
+/* Grow the buffer to hold at least minsize characters plus the terminator */
+static int wmemstream_grow(struct wmemstream *ms, size_t minsize)
+{
+    size_t newcap;
+    wchar_t *newbuf;
+    if (minsize >= WMEMSTREAM_MAXCAP - 1) { errno= ENOMEM;  return -1; }
+    newcap= ms->capacity <= WMEMSTREAM_MAXCAP / ms_growth
+	    ? ms->capacity * ms_growth / 100 : WMEMSTREAM_MAXCAP;
+    if (newcap <= minsize) newcap= minsize + 1;
+    newbuf= realloc(ms->contents, newcap * sizeof(wchar_t));
+    if (!newbuf) return -1;	/* errno == ENOMEM */
+    ms->contents= newbuf;
+    ms->capacity= newcap;
+    *ms->ptr= ms->contents;		/* size has not changed */
+    return 0;
+}
+
+static int wmemstream_write(void *cookie, const char *buf, int count)
+{
+    struct wmemstream *ms= (struct wmemstream *)cookie;
+    const unsigned char *p= (const unsigned char *)buf, *end= p + count;
+    wchar_t *q, wc;
+    size_t n;
+    if (MPLS_SLOWPATH(count < 0)) { errno= EINVAL;  return -1; }
+    /* Each byte yields at most one character */
+    if (ms->capacity - ms->position <= (size_t) count)
+	if (wmemstream_grow(ms, ms->position + count) < 0)		/* errno == ENOMEM */
+	    return -1;
+    q= ms->contents + ms->position;
+    while (p < end) {
+	if (MPLS_FASTPATH(*p < 0x80 && !ms->partial)) {
+	    *q++= *p++;
+	    continue;
+	}
+	n= mbrtowc(&wc, (const char *)p, end - p, &ms->mbstate);
+	if (n == (size_t) -2) {		/* incomplete, and all consumed */
+	    ms->partial= 1;
+	    p= end;
+	    break;
+	}
+	ms->partial= 0;
+	if (n == (size_t) -1) {		/* errno == EILSEQ */
+	    memset(&ms->mbstate, 0, sizeof(ms->mbstate));
+	    if (p == (const unsigned char *)buf) return -1;
+	    break;
+	}
+	*q++= wc;
+	p+= n ? n : 1;
+    }
+    ms->position= q - ms->contents;
+    if (ms->size < ms->position) {
+	*ms->sizeloc= ms->size= ms->position;
+	ms->contents[ms->size]= 0;
+    }
+									assert(ms->size < ms->capacity);
+									assert(ms->contents[ms->size] == 0);
+    return (const char *)p - buf;
+}
+
+static fpos_t wmemstream_seek(void *cookie, fpos_t offset, int whence)
+{
+    struct wmemstream *ms= (struct wmemstream *)cookie;
+    fpos_t pos= 0;
+    switch (whence) {
+	case SEEK_SET:	pos= offset;			break;
+	case SEEK_CUR:	pos= ms->position + offset;	break;
+	case SEEK_END:	pos= ms->size + offset;		break;
+	default:	errno= EINVAL;			return -1;
+    }
+    if (pos < 0 || (unsigned long long) pos >= WMEMSTREAM_MAXCAP - 1) {
+	errno= EINVAL;
+	return -1;
+    }
+    if ((size_t) pos >= ms->capacity && wmemstream_grow(ms, pos) < 0)
+	return -1;	/* errno == ENOMEM */
+    ms->position= pos;
+    if (ms->position > ms->size) {
+	memset(ms->contents + ms->size, 0,
+	       (ms->position - ms->size) * sizeof(wchar_t));
+	*ms->sizeloc= ms->size= ms->position;
+    }
+    ms->contents[ms->size]= 0;
+    memset(&ms->mbstate, 0, sizeof(ms->mbstate));
+    ms->partial= 0;
+    return pos;
+}
+
+static int wmemstream_close(void *cookie)
+{
+    struct wmemstream *ms= (struct wmemstream *)cookie;
+    ms->size= min(ms->size, ms->position);
+    *ms->ptr= ms->contents;
+    *ms->sizeloc= ms->size;						assert(ms->size < ms->capacity);
+    ms->contents[ms->size]= 0;
+    free(ms);
+    return 0;
+}
+
+FILE *open_wmemstream(wchar_t **ptr, size_t *sizeloc)
+{
+    if (ptr && sizeloc) {
+	struct wmemstream *ms= calloc(1, sizeof(struct wmemstream));
+	FILE *fp= 0;							if (!ms) return 0;	/* errno == ENOMEM */
+	(void) pthread_once(&ms_once, memstream_getpolicy);
+	ms->position= ms->size= 0;
+	ms->capacity= ms_initcap / sizeof(wchar_t);
+	ms->contents= malloc(ms->capacity * sizeof(wchar_t));		if (!ms->contents) { free(ms);  return 0; } /* errno == ENOMEM */
+	ms->contents[0]= 0;
+	ms->ptr= ptr;
+	ms->sizeloc= sizeloc;
+	fp= funopen(ms, NULL, wmemstream_write, wmemstream_seek, wmemstream_close);
+	if (!fp) {
+	    free(ms->contents);
+	    free(ms);
+	    return 0;	/* errno set by funopen */
+	}
+	(void) setvbuf(fp, NULL, _IONBF, 0);
+	(void) fwide(fp, 1);
+	*ptr= ms->contents;
+	*sizeloc= ms->size;
+	return fp;
+    }
+    errno= EINVAL;
+    return 0;
+}
+
+/*
+ * Wide output to a wmemstream
+ *
+ * Each wide output function checks for a wmemstream by its close function,
+ * and passes any other stream to the OS version.  Literal text and wide
+ * character arguments are stored directly.  Other conversions are done by
+ * the narrow snprintf() with the same flags, width, precision, and length,
+ * and the result (digits, signs, and the locale's radix and grouping
+ * characters) is converted to wide characters, as is a narrow %s or %c
+ * argument, as the standard specifies.  Formats with positional (%n$)
+ * arguments are left to stdio, and thus to the multibyte path.
+ */
+
+static struct wmemstream *wmemstream_of(FILE *fp)
+{
+    struct __mpls__sFILE *f= __MPLS_FILEP(fp);
+    return f->_close == wmemstream_close ? (struct wmemstream *)f->_cookie : 0;
+}
+
+/* Make room for n characters at the current position */
+static wchar_t *wmemstream_reserve(struct wmemstream *ms, size_t n)
+{
+    if (ms->capacity - ms->position <= n) {
+	if (n >= WMEMSTREAM_MAXCAP - ms->position) { errno= ENOMEM;  return 0; }
+	if (wmemstream_grow(ms, ms->position + n) < 0)		/* errno == ENOMEM */
+	    return 0;
+    }
+    memset(&ms->mbstate, 0, sizeof(ms->mbstate));
+    ms->partial= 0;
+    return ms->contents + ms->position;
+}
+
+/* Account for n characters stored at the current position */
+static void wmemstream_advance(struct wmemstream *ms, size_t n)
+{
+    ms->position+= n;
+    if (ms->size < ms->position) {
+	*ms->sizeloc= ms->size= ms->position;
+	ms->contents[ms->size]= 0;
+    }
+									assert(ms->size < ms->capacity);
+									assert(ms->contents[ms->size] == 0);
+}
+
+static int wmemstream_put(struct wmemstream *ms, const wchar_t *s, size_t n)
+{
+    wchar_t *q= wmemstream_reserve(ms, n);				if (!q) return -1;
+    memcpy(q, s, n * sizeof(wchar_t));
+    wmemstream_advance(ms, n);
+    return 0;
+}
+
+static int wmemstream_pad(struct wmemstream *ms, size_t n)
+{
+    wchar_t *q= wmemstream_reserve(ms, n);				if (!q) return -1;
+    size_t i;
+    for (i= 0; i < n; ++i) q[i]= L' ';
+    wmemstream_advance(ms, n);
+    return 0;
+}
+
+/* Convert (or just count, if out is null) up to max characters of a string */
+static size_t wmemstream_mbsconv(wchar_t *out, const char *s, size_t max)
+{
+    mbstate_t mbs;
+    wchar_t wc;
+    size_t i, n;
+    memset(&mbs, 0, sizeof(mbs));
+    for (i= 0; i < max; ++i, s+= n) {
+	n= mbrtowc(&wc, s, MB_LEN_MAX, &mbs);
+	if (!n) break;
+	if (n >= (size_t) -2) { errno= EILSEQ;  return (size_t) -1; }
+	if (out) out[i]= wc;
+    }
+    return i;
+}
+
+/* Store the multibyte result of a narrow conversion */
+static int wmemstream_putmbs(struct wmemstream *ms, const char *s, size_t n)
+{
+    wchar_t *q= wmemstream_reserve(ms, n), *q0= q;			if (!q) return -1;
+    const char *end= s + n;
+    mbstate_t mbs;
+    size_t len;
+    memset(&mbs, 0, sizeof(mbs));
+    while (s < end) {
+	len= mbrtowc(q, s, end - s, &mbs);
+	if (len == 0 || len >= (size_t) -2) {	/* can't happen; keep the byte */
+	    *q= (unsigned char) *s;
+	    len= 1;
+	    memset(&mbs, 0, sizeof(mbs));
+	}
+	++q;
+	s+= len;
+    }
+    wmemstream_advance(ms, q - q0);
+    return q - q0;
+}
+
+/* Format one narrow conversion, growing the buffer as needed */
+static int wmemstream_format(char **bufp, size_t *sizep, char *local,
+			     const char *spec, ...)
+{
+    va_list ap, ap2;
+    char *buf;
+    int n;
+    va_start(ap, spec);
+    va_copy(ap2, ap);
+    n= vsnprintf(*bufp, *sizep, spec, ap);
+    if (n >= 0 && (size_t) n >= *sizep) {
+	if (!(buf= malloc(n + 1))) n= -1;	/* errno == ENOMEM */
+	else {
+	    if (*bufp != local) free(*bufp);
+	    *bufp= buf;
+	    *sizep= n + 1;
+	    n= vsnprintf(*bufp, *sizep, spec, ap2);
+	}
+    }
+    va_end(ap2);
+    va_end(ap);
+    return n;
+}
+
+enum wmemstream_len { LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_J, LEN_Z, LEN_T, LEN_LD };
+
+static const char *const wmemstream_lenspec[]=
+    { "", "hh", "h", "l", "ll", "j", "z", "t", "L" };
+
+static int wmemstream_positional(const wchar_t *fmt)
+{
+    const wchar_t *p= fmt;
+    while ((p= wcschr(p, L'%'))) {
+	if (*++p == L'%') { ++p;  continue; }
+	while (*p >= L'0' && *p <= L'9') ++p;
+	if (*p == L'$') return 1;
+    }
+    return 0;
+}
+
+static int wmemstream_vprintf(struct wmemstream *ms, const wchar_t *fmt, va_list ap)
+{
+    char local[128], *out= local, spec[32], *s;
+    size_t outsize= sizeof(local), count= 0, len;
+    const wchar_t *p= fmt, *start, *ws;
+    const char *ns= 0;
+    enum wmemstream_len lm;
+    int width, prec, left, n, ret= -1;
+    wchar_t wc;
+
+    while (*p) {
+	if (*p != L'%') {
+	    for (start= p; *p && *p != L'%'; ++p) ;
+	    if (wmemstream_put(ms, start, p - start) < 0) goto out;
+	    count+= p - start;
+	    continue;
+	}
+	if (p[1] == L'%') {
+	    if (wmemstream_put(ms, p, 1) < 0) goto out;
+	    ++count;
+	    p+= 2;
+	    continue;
+	}
+
+	/* Flags */
+	s= spec;
+	*s++= '%';
+	left= 0;
+	for (++p; ; ++p) {
+	    if (*p == L'-') left= 1;
+	    else if (*p != L'+' && *p != L' ' && *p != L'#' && *p != L'0' && *p != L'\'') break;
+	    if (!memchr(spec, (char) *p, s - spec)) *s++= (char) *p;	/* repeats are redundant */
+	}
+
+	/* Width and precision */
+	if (*p == L'*') {
+	    width= va_arg(ap, int);
+	    ++p;
+	    if (width < 0) {
+		if (width == INT_MIN) { errno= EOVERFLOW;  goto out; }
+		width= -width;
+		if (!memchr(spec, '-', s - spec)) *s++= '-';
+		left= 1;
+	    }
+	} else {
+	    for (width= 0; *p >= L'0' && *p <= L'9'; ++p) {
+		if (width > (INT_MAX - 9) / 10) { errno= EOVERFLOW;  goto out; }
+		width= width * 10 + (*p - L'0');
+	    }
+	}
+	prec= -1;
+	if (*p == L'.') {
+	    if (*++p == L'*') {
+		prec= va_arg(ap, int);
+		++p;
+	    } else {
+		for (prec= 0; *p >= L'0' && *p <= L'9'; ++p) {
+		    if (prec > (INT_MAX - 9) / 10) { errno= EOVERFLOW;  goto out; }
+		    prec= prec * 10 + (*p - L'0');
+		}
+	    }
+	}
+
+	/* Length */
+	switch (*p) {
+	    case L'h':	lm= p[1] == L'h' ? (++p, LEN_HH) : LEN_H;	++p;	break;
+	    case L'l':	lm= p[1] == L'l' ? (++p, LEN_LL) : LEN_L;	++p;	break;
+	    case L'q':	lm= LEN_LL;	++p;	break;
+	    case L'j':	lm= LEN_J;	++p;	break;
+	    case L'z':	lm= LEN_Z;	++p;	break;
+	    case L't':	lm= LEN_T;	++p;	break;
+	    case L'L':	lm= LEN_LD;	++p;	break;
+	    default:	lm= LEN_NONE;		break;
+	}
+	sprintf(s, "*.*%s%c", wmemstream_lenspec[lm], (char) *p);
+
+	/* Conversion */
+	ws= 0;
+	switch (*p++) {
+	    case L'd': case L'i': case L'o': case L'u': case L'x': case L'X':
+		switch (lm) {
+		    case LEN_L:	 n= wmemstream_format(&out, &outsize, local, spec, width, prec, va_arg(ap, long));	break;
+		    case LEN_LL: n= wmemstream_format(&out, &outsize, local, spec, width, prec, va_arg(ap, long long));	break;
+		    case LEN_J:	 n= wmemstream_format(&out, &outsize, local, spec, width, prec, va_arg(ap, intmax_t));	break;
+		    case LEN_Z:	 n= wmemstream_format(&out, &outsize, local, spec, width, prec, va_arg(ap, size_t));	break;
+		    case LEN_T:	 n= wmemstream_format(&out, &outsize, local, spec, width, prec, va_arg(ap, ptrdiff_t));	break;
+		    default:	 n= wmemstream_format(&out, &outsize, local, spec, width, prec, va_arg(ap, int));	break;
+		}
+		break;
+	    case L'e': case L'E': case L'f': case L'F':
+	    case L'g': case L'G': case L'a': case L'A':
+		if (lm == LEN_LD)
+		    n= wmemstream_format(&out, &outsize, local, spec, width, prec, va_arg(ap, long double));
+		else
+		    n= wmemstream_format(&out, &outsize, local, spec, width, prec, va_arg(ap, double));
+		break;
+	    case L'p':
+		n= wmemstream_format(&out, &outsize, local, spec, width, prec, va_arg(ap, void *));
+		break;
+	    case L'n':
+		switch (lm) {
+		    case LEN_HH: *va_arg(ap, signed char *)= count;	break;
+		    case LEN_H:	 *va_arg(ap, short *)= count;		break;
+		    case LEN_L:	 *va_arg(ap, long *)= count;		break;
+		    case LEN_LL: *va_arg(ap, long long *)= count;	break;
+		    case LEN_J:	 *va_arg(ap, intmax_t *)= count;	break;
+		    case LEN_Z:	 *va_arg(ap, size_t *)= count;		break;
+		    case LEN_T:	 *va_arg(ap, ptrdiff_t *)= count;	break;
+		    default:	 *va_arg(ap, int *)= count;		break;
+		}
+		continue;
+	    case L'c': case L'C':
+		if (lm == LEN_L || p[-1] == L'C') wc= (wchar_t) va_arg(ap, wint_t);
+		else if ((wc= btowc(va_arg(ap, int))) == (wchar_t) WEOF) { errno= EILSEQ;  goto out; }
+		ws= &wc;
+		len= 1;
+		goto field;
+	    case L's': case L'S':
+		if (lm == LEN_L || p[-1] == L'S') {
+		    if (!(ws= va_arg(ap, const wchar_t *))) ws= L"(null)";
+		    for (len= 0; (prec < 0 || len < (size_t) prec) && ws[len]; ++len) ;
+		} else {
+		    if (!(ns= va_arg(ap, const char *))) ns= "(null)";
+		    len= wmemstream_mbsconv(0, ns, prec < 0 ? SIZE_MAX : (size_t) prec);
+		    if (len == (size_t) -1) goto out;		/* errno == EILSEQ */
+		}
+	    field:
+		if (!left && (size_t) width > len && wmemstream_pad(ms, width - len) < 0) goto out;
+		if (ws) {
+		    if (wmemstream_put(ms, ws, len) < 0) goto out;
+		} else {
+		    wchar_t *q= wmemstream_reserve(ms, len);		if (!q) goto out;
+		    (void) wmemstream_mbsconv(q, ns, len);
+		    wmemstream_advance(ms, len);
+		}
+		if (left && (size_t) width > len && wmemstream_pad(ms, width - len) < 0) goto out;
+		count+= (size_t) width > len ? (size_t) width : len;
+		continue;
+	    default:			/* as in BSD, print the character itself */
+		if (!(wc= p[-1])) { --p;  continue; }
+		ws= &wc;
+		len= 1;
+		goto field;
+	}
+	if (n < 0 || (n= wmemstream_putmbs(ms, out, n)) < 0) goto out;
+	count+= n;
+    }
+    if (count > INT_MAX) errno= EOVERFLOW;
+    else ret= count;
+ out:
+    if (out != local) free(out);
+    return ret;
+}
+
+/* Finish a direct operation, recording any error as stdio would */
+static void wmemstream_unlock(FILE *fp, int ret)
+{
+    if (ret < 0) __MPLS_FILEP(fp)->_flags|= __SERR;
+    funlockfile(fp);
+}
+
+wint_t fputwc(wchar_t wc, FILE *fp)
+{
+    struct wmemstream *ms= wmemstream_of(fp);
+    int ret;
+    GET_OS_FUNC(fputwc)
+    if (MPLS_FASTPATH(!ms)) return (*os_fputwc)(wc, fp);
+    flockfile(fp);
+    ret= wmemstream_put(ms, &wc, 1);
+    wmemstream_unlock(fp, ret);
+    return ret < 0 ? WEOF : (wint_t) wc;
+}
+
+/* In case the SDK makes it a macro, as FreeBSD's does */
+#undef putwc
+
+wint_t putwc(wchar_t wc, FILE *fp)
+{
+    return fputwc(wc, fp);
+}
+
+int fputws(const wchar_t * __restrict s, FILE * __restrict fp)
+{
+    struct wmemstream *ms= wmemstream_of(fp);
+    int ret;
+    GET_OS_FUNC(fputws)
+    if (MPLS_FASTPATH(!ms)) return (*os_fputws)(s, fp);
+    flockfile(fp);
+    ret= wmemstream_put(ms, s, wcslen(s));
+    wmemstream_unlock(fp, ret);
+    return ret;
+}
+
+int vfwprintf(FILE * __restrict fp, const wchar_t * __restrict fmt, va_list ap)
+{
+    struct wmemstream *ms= wmemstream_of(fp);
+    int ret;
+    GET_OS_FUNC(vfwprintf)
+    if (MPLS_FASTPATH(!ms) || wmemstream_positional(fmt))
+	return (*os_vfwprintf)(fp, fmt, ap);
+    flockfile(fp);
+    ret= wmemstream_vprintf(ms, fmt, ap);
+    wmemstream_unlock(fp, ret);
+    return ret;
+}
+
+int fwprintf(FILE * __restrict fp, const wchar_t * __restrict fmt, ...)
+{
+    va_list ap;
+    int ret;
+    va_start(ap, fmt);
+    ret= vfwprintf(fp, fmt, ap);
+    va_end(ap);
+    return ret;
+}
+
 #endif /* __MPLS_LIB_SUPPORT_OPEN_MEMSTREAM__ */
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2024 Frederick H. G. Wright II <fw@fwright.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __MACPORTS_STDIO_INTERNAL_H
+#define __MACPORTS_STDIO_INTERNAL_H
+
+#include <stdio.h>
+
+/*
+ * Private knowledge of the stdio FILE layout.
+ *
+ * A few functions need access to FILE internals which aren't available
+ * through any public interface.  Fortunately:
+ *   1) The '_cookie' element is, for ordinary (non-funopen) streams, a self
+ *      pointer to the FILE itself.  This allows a fairly reliable
+ *      consistency check.
+ *   2) The layout of FILE (at least up through '_close') has never changed
+ *      across all the OS versions, avoiding the need for version conditions.
+ *   3) This code is only applicable to OS versions 10.6 and earlier, which
+ *      have been frozen for ages, avoiding any future compatibility issues.
+ *
+ * So we define enough of the FILE layout to cover the fields of interest
+ * (skipping the rest), and callers should apply __MPLS_FILE_OK() before
+ * relying on it, falling back to public interfaces if it fails.
+ *
+ * Note that Apple didn't get around to hiding the private definitions
+ * until the 11.x SDK, so we prefix our versions with '__mpls' to avoid
+ * conflicts.
+ */
+
+/* stdio buffers */
+struct __mpls__sbuf {
+	unsigned char	*_base;
+	int		_size;
+};
+
+/* stdio FILE object (truncated) */
+struct __mpls__sFILE {
+	unsigned char *_p;	/* current position in (some) buffer */
+	int	_r;		/* read space left for getc() */
+	int	_w;		/* write space left for putc() */
+	short	_flags;		/* flags, below; this FILE is free if 0 */
+	short	_file;		/* fileno, if Unix descriptor, else -1 */
+	struct	__mpls__sbuf _bf;	/* the buffer (at least 1 byte, if !NULL) */
+	int	_lbfsize;	/* 0 or -_bf._size, for inline putc */
+
+	/* operations */
+	void	*_cookie;	/* cookie passed to io functions */
+	int	(*_close)(void *);
+	/* We don't need the rest */
+};
+
+#define __MPLS_FILEP(fp) ((struct __mpls__sFILE *) (fp))
+
+/* Sanity check for an ordinary stream with the expected layout */
+#define __MPLS_FILE_OK(fp) (__MPLS_FILEP(fp)->_cookie == (void *) (fp))
+
+#endif /* __MACPORTS_STDIO_INTERNAL_H */
@@ -32,9 +32,23 @@
 // MP support header
 #include "MacportsLegacySupport.h"
 
+/*
+ * When the compiler has the bit-scan builtins, these use them (via the
+ * helpers in bitops.h), typically compiling to one or two instructions.
+ * Otherwise, they fall back to the original loops.
+ *
+ * This deliberately doesn't include strings.h, whose inline definitions
+ * would conflict with the ones here.
+ */
+#include <_macports_extras/bitops.h>
+
 #if __MPLS_LIB_SUPPORT_FFSL__
 int ffsl(long mask)
 {
+#if __MPLS_HAVE_BITOPS_BUILTINS
+  unsigned long umask = (unsigned long)mask;
+  return __MPLS_FFS_UL(umask);
+#else
   int bit = 0;
   if (mask != 0) {
     for (bit = 1; !(mask & 1); bit++) {
@@ -42,12 +56,17 @@ int ffsl(long mask)
     }
   }
   return (bit);
+#endif
 }
 #endif
 
 #if __MPLS_LIB_SUPPORT_FFSLL__
 int ffsll(long long mask)
 {
+#if __MPLS_HAVE_BITOPS_BUILTINS
+  unsigned long long umask = (unsigned long long)mask;
+  return __MPLS_FFS_ULL(umask);
+#else
   int bit = 0;
   if (mask != 0) {
     for (bit = 1; !(mask & 1); bit++) {
@@ -55,12 +74,17 @@ int ffsll(long long mask)
     }
   }
   return (bit);
+#endif
 }
 #endif
 
 #if __MPLS_LIB_SUPPORT_FLS__
 int fls(int mask)
 {
+#if __MPLS_HAVE_BITOPS_BUILTINS
+  unsigned int umask = (unsigned int)mask;
+  return __MPLS_FLS_U(umask);
+#else
   int bit = 0;
   if (mask != 0) {
     for (bit = 1; mask != 1; bit++) {
@@ -68,12 +92,17 @@ int fls(int mask)
     }
   }
   return (bit);
+#endif
 }
 #endif
 
 #if __MPLS_LIB_SUPPORT_FLSL__
 int flsl(long mask)
 {
+#if __MPLS_HAVE_BITOPS_BUILTINS
+  unsigned long umask = (unsigned long)mask;
+  return __MPLS_FLS_UL(umask);
+#else
   int bit = 0;
   if (mask != 0) {
     for (bit = 1; mask != 1; bit++) {
@@ -81,12 +110,17 @@ int flsl(long mask)
     }
   }
   return (bit);
+#endif
 }
 #endif
 
 #if __MPLS_LIB_SUPPORT_FLSLL__
 int flsll(long long mask)
 {
+#if __MPLS_HAVE_BITOPS_BUILTINS
+  unsigned long long umask = (unsigned long long)mask;
+  return __MPLS_FLS_ULL(umask);
+#else
   int bit = 0;
   if (mask != 0) {
     for (bit = 1; mask != 1; bit++) {
@@ -94,5 +128,6 @@ int flsll(long long mask)
     }
   }
   return (bit);
+#endif
 }
 #endif
@@ -39,19 +39,104 @@
 # include <config.h>
 #endif
 
+#include <stdint.h>
+
+#include "compiler.h"
 #include "strnlen.h"
 
+/*
+ * The scan works on whole blocks (16-byte vectors with SSE2, or machine
+ * words otherwise), and never reads a block unless at least one of its
+ * bytes is within the caller's limit and not beyond the terminator.
+ *
+ * With SSE2, all loads are aligned, so the first block may include bytes
+ * before the string, and the last block may include bytes past the
+ * terminator or the limit.  This is safe, since an aligned block can't
+ * span a page boundary, and it contains at least one byte of the string.
+ * The excess bytes are masked off or ignored.
+ *
+ * Without SSE2, the unaligned head is scanned bytewise, then aligned words
+ * are checked with the usual "has a zero byte" test, and the remainder is
+ * scanned bytewise.  This never reads outside the limit at all.  The zero
+ * test is exact as to whether there's any zero byte, though not as to
+ * where, so the word containing it is rescanned bytewise, which also makes
+ * it independent of byte order.
+ *
+ * STRNLEN_NO_SIMD may be defined to use the word version even with SSE2.
+ */
+
+#if defined(__SSE2__) && !defined(STRNLEN_NO_SIMD)
+#define STRNLEN_SSE2 1
+#include <emmintrin.h>
+#endif
+
 /* Find the length of STRING, but scan at most MAXLEN characters.
    If no '\0' terminator is found in that many characters, return MAXLEN.  */
 
+#ifdef STRNLEN_SSE2
+
+size_t
+strnlen (const char *s, size_t len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t off = (uintptr_t) s & 15, done, n;
+    const __m128i *vp = (const __m128i *) (s - off);
+    unsigned int mask;
+
+    if (MPLS_SLOWPATH(!len)) return 0;
+
+    /* First (partial) block, ignoring the bytes before the string */
+    mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(vp), zero));
+    mask >>= off;
+    if (mask) {
+        n = __builtin_ctz(mask);
+        return n < len ? n : len;
+    }
+    done = 16 - off;
+
+    while (done < len) {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(++vp), zero));
+        if (mask) {
+            n = done + __builtin_ctz(mask);
+            return n < len ? n : len;
+        }
+        done += 16;
+    }
+    return len;
+}
+
+#else /* !STRNLEN_SSE2 */
+
+typedef unsigned long word_t;
+
+#define WORD_ONES  ((word_t) -1 / 0xFF)
+#define WORD_HIGHS (WORD_ONES * 0x80)
+#define HAS_ZERO(x) (((x) - WORD_ONES) & ~(x) & WORD_HIGHS)
+
 size_t
 strnlen (const char *s, size_t len)
 {
-    size_t i;
+    const char *p = s;
+    const word_t *wp;
+    size_t left = len;
 
-    for(i = 0; i < len && s[i]; i++)
+    /* Bytewise up to word alignment */
+    for (; (uintptr_t) p & (sizeof(word_t) - 1); ++p, --left) {
+        if (!left || !*p) return p - s;
+    }
+
+    /* Whole words within the limit */
+    for (wp = (const word_t *) p; left >= sizeof(word_t);
+         ++wp, left -= sizeof(word_t)) {
+        if (HAS_ZERO(*wp)) break;
+    }
+
+    /* Bytewise for the word containing the zero, or the remainder */
+    for (p = (const char *) wp; left && *p; ++p, --left)
         ;
-    return i;
+    return p - s;
 }
 
+#endif /* !STRNLEN_SSE2 */
+
 #endif /* __MPLS_LIB_SUPPORT_STRNLEN__ */
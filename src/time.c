@@ -41,7 +41,7 @@ uint64_t mach_approximate_time(void)
 
 #if __MPLS_LIB_SUPPORT_CONTINUOUS_TIME__
 
-#include <pthread.h>
+#include <sched.h>
 
 #include <mach/mach_time.h>
 
@@ -92,25 +92,36 @@ uint64_t mach_approximate_time(void)
  * up to one second (from this source), all programs will agree on that
  * error, and it will not cause a discrepancy across programs.
  *
- * The present implementation only accounts for the "static" sleep offset,
- * i.e. sleeps occuring before the program was launched.  There is no
- * provision for tracking "dynamic" sleep offsets, i.e. sleeps occurring
- * while the program is running.
+ * Sleeps occurring while the program is running ("dynamic" sleep offsets)
+ * are picked up by a periodic recheck.  Since mach time doesn't advance
+ * during sleep, the recheck is rate-limited in mach time, i.e. it happens
+ * at most once per SLEEP_RECHECK_MS milliseconds of running time, and only
+ * when the offset is actually being used.  The recheck is normally just a
+ * single gettimeofday(), giving the apparent offset relative to the known
+ * boottime.  Only if that shows a sufficient increase is the full (and
+ * slower) offset computation repeated.  Thus a wakeup is noticed within
+ * SLEEP_RECHECK_MS of subsequent running time.  Since boottime isn't
+ * adjusted prior to 10.12, a large forward step in the time of day looks
+ * the same as a sleep, just as it would have before the program started.
  *
- * In spite of the above, the code is written to allow for the possibility
- * of recomputing the sleep offset later.  To avoid excessive "churn", it
- * does not update the actual offset unless it's been increased by at least
- * MIN_SLEEP_OFFSET_ADVANCE seconds, or the drift-based limit if larger.
- * Since the initial offset is zero, this also has the effect of excluding
- * negative offsets as noted above.
+ * To avoid excessive "churn", the actual offset isn't updated unless it's
+ * been increased by at least MIN_SLEEP_OFFSET_ADVANCE seconds, or the
+ * drift-based limit if larger.  Since the initial offset is zero, this also
+ * has the effect of excluding negative offsets as noted above.  Nor is it
+ * ever decreased, so continuous time remains monotonic.
  *
  * If the first "raw" offset is negative, it's retained to use as a baseline
- * for any subsequent adjustments (not currently implemented), thereby removing
- * the "boottime delay" from any subsequent adjustments.
+ * for subsequent adjustments, thereby removing the "boottime delay" from
+ * them.
  *
- * Unlike the mach scale factor setup, attempting to set up the sleep offset
- * simultaneously from multiple threads can cause trouble, so we protect
- * the setup code with a mutex.
+ * The offset is published together with the info it was computed from and
+ * the time of the next recheck, as a record with a sequence count, which is
+ * odd while an update is in progress.  Readers retry until they see an
+ * even and unchanged count, so that they always get a consistent record,
+ * including a 64-bit offset on 32-bit platforms, without locking.  Only one
+ * thread at a time computes a new offset.  Other threads needing a recheck
+ * meanwhile just continue with the current offset, except before the first
+ * valid offset, when they wait for it.
  *
  * To maximize consistency, we use a "constructor" function to initialize
  * the sleep offset at program launch, rather than waiting for the first
@@ -124,6 +135,10 @@ uint64_t mach_approximate_time(void)
 #define MIN_SLEEP_OFFSET_ADVANCE 5
 #define MAX_DRIFT_PPM 100
 
+#ifndef SLEEP_RECHECK_MS
+#define SLEEP_RECHECK_MS 100
+#endif
+
 typedef struct sleepofs_info_s {
   struct timeval boottime;
   struct timeval timeofday;
@@ -132,11 +147,21 @@ typedef struct sleepofs_info_s {
   uint64_t mach_diff;
 } sleepofs_info_t;
 
-static int sleep_offset_valid = 0;
-static uint64_t sleep_offset = 0;
+/* The published sleep offset record */
+typedef struct sleepofs_rec_s {
+  uint64_t offset;          /* Sleep offset in mach units */
+  uint64_t next_check;      /* Mach time of next recheck */
+  sleepofs_info_t info;     /* Info from which offset was computed */
+} sleepofs_rec_t;
+
+static sleepofs_rec_t sleepofs_rec = {0};
+static volatile uint32_t sleepofs_seq = 0;  /* Odd if updating, 0 if invalid */
+static volatile int sleepofs_busy = 0;
+
+/* Private to the thread computing the offset */
 static int64_t raw_offset = 0, first_offset = 0;
-static sleepofs_info_t sleep_info_raw, sleep_info = {.mach_before = 0};
-static pthread_mutex_t sleepofs_lock = PTHREAD_MUTEX_INITIALIZER;
+static sleepofs_info_t sleep_info_raw;
+static uint64_t recheck_interval = 0;
 
 /*
  * Get the system boot time, via sysctl.  The comm-page method of obtaining
@@ -225,55 +250,171 @@ get_sleepofs_info(sleepofs_info_t *si)
   return 0;
 }
 
-/*
- * Compute the sleep offset.  Do nothing on failure, leaving the offset as is.
- */
+/* Get a consistent copy of the sleep offset record, returning its count */
+static inline uint32_t
+read_sleepofs(uint64_t *offset, uint64_t *next_check)
+{
+  uint32_t seq;
+
+  do {
+    seq = sleepofs_seq;
+    MPLS_READ_BARRIER();
+    *offset = sleepofs_rec.offset;
+    *next_check = sleepofs_rec.next_check;
+    MPLS_READ_BARRIER();
+  } while (MPLS_SLOWPATH((seq & 1) || seq != sleepofs_seq));
+
+  return seq;
+}
+
+/* Publish an updated record (caller must own sleepofs_busy) */
+static void
+publish_sleepofs(const sleepofs_rec_t *rec)
+{
+  uint32_t seq = sleepofs_seq;
+
+  sleepofs_seq = seq + 1;
+  MPLS_WRITE_BARRIER();
+  sleepofs_rec = *rec;
+  MPLS_WRITE_BARRIER();
+  seq += 2;
+  sleepofs_seq = seq ? seq : 2;  /* Skip the "invalid" value on wraparound */
+}
+
 static int get_mach_scale(void);
 static int64_t tvdiff2mach(const struct timeval *tv1,
                            const struct timeval *tv2);
 
-static void get_sleep_offset(void)
+/* Get the minimum offset increase to accept, as of the given mach time */
+static int64_t
+get_min_advance(uint64_t mach_time)
 {
-  int ret;
-  int64_t toddiff, offset, minsleepadj, maxdrift;
-  sleepofs_info_t si;
+  int64_t minsleepadj, maxdrift;
   static const struct timeval tv5a = {MIN_SLEEP_OFFSET_ADVANCE, 0},
                               tv5b = {0, 0};
 
-  if (get_mach_scale()) return;
+  minsleepadj = tvdiff2mach(&tv5a, &tv5b);
+  maxdrift = (mach_time - sleepofs_rec.info.mach_before)
+             / (1000000 / MAX_DRIFT_PPM);
+  return maxdrift > minsleepadj ? maxdrift : minsleepadj;
+}
+
+/*
+ * Compute the sleep offset.  Do nothing on failure, leaving the offset as is,
+ * and return nonzero if it's worth retrying.  The caller must own
+ * sleepofs_busy.
+ */
+static int get_sleep_offset(void)
+{
+  int ret;
+  int64_t toddiff, offset;
+  sleepofs_info_t si;
+  sleepofs_rec_t rec = sleepofs_rec;
+  static const struct timeval tvrca = {SLEEP_RECHECK_MS / 1000,
+                                       SLEEP_RECHECK_MS % 1000 * 1000},
+                              tvrcb = {0, 0};
+
+  if (get_mach_scale()) return -1;
+  recheck_interval = tvdiff2mach(&tvrca, &tvrcb);
+
   if ((ret = get_sleepofs_info(&si))) {
     /* If boottime is broken, retries are useless */
-    if (ret == BAD_BT_LEN) sleep_offset_valid = 1;
-    return;
+    if (ret == BAD_BT_LEN) {
+      rec.next_check = ~0ULL;
+      publish_sleepofs(&rec);
+      return 0;
+    }
+    return -1;
   }
 
   toddiff = tvdiff2mach(&si.timeofday, &si.boottime);
   /* boottime later than tod is garbage */
   if (toddiff < 0) {
-    sleep_offset_valid = 1;  /* It's permanent garbage, so don't retry this */
-    return;
+    /* It's permanent garbage, so don't retry this */
+    rec.next_check = ~0ULL;
+    publish_sleepofs(&rec);
+    return 0;
   }
   offset = toddiff - (si.mach_before + si.mach_after) / 2;
-  minsleepadj = tvdiff2mach(&tv5a, &tv5b);
-  maxdrift = (si.mach_before - sleep_info.mach_before)
-             / (1000000 / MAX_DRIFT_PPM);
-  if (maxdrift > minsleepadj) minsleepadj = maxdrift;
-
-  if (pthread_mutex_lock(&sleepofs_lock)) return;
 
   raw_offset = offset;
-  if (!first_offset && offset < 0) first_offset = offset;
+  if (!sleepofs_seq && offset < 0) first_offset = offset;
   sleep_info_raw = si;
 
-  if (offset - first_offset > sleep_offset + minsleepadj) {
-    sleep_offset = offset - first_offset;
-    sleep_info = si;
+  if (offset - first_offset
+      > (int64_t) rec.offset + get_min_advance(si.mach_before)) {
+    rec.offset = offset - first_offset;
+    rec.info = si;
   }
 
   /* The offset is now valid, whether we decided to change it or not. */
-  sleep_offset_valid = 1;
+  rec.next_check = si.mach_after + recheck_interval;
+  publish_sleepofs(&rec);
+  return 0;
+}
+
+/*
+ * Recheck the sleep offset, with a quick check for a possible sleep
+ * before doing the full computation.  The caller must own sleepofs_busy.
+ */
+static void
+recheck_sleep_offset(uint64_t mach_time)
+{
+  struct timeval tod;
+  int64_t offset;
+  sleepofs_rec_t rec = sleepofs_rec;
+
+  if (!gettimeofday(&tod, NULL)) {
+    offset = tvdiff2mach(&tod, &sleep_info_raw.boottime) - mach_time;
+    if (offset - first_offset
+        > (int64_t) rec.offset + get_min_advance(mach_time)
+        && !get_sleep_offset()) {
+      return;
+    }
+  }
 
-  (void) pthread_mutex_unlock(&sleepofs_lock);
+  /* No sleep, or failed to compute new offset - try again later */
+  rec.next_check = mach_time + recheck_interval;
+  publish_sleepofs(&rec);
+}
+
+/*
+ * Slow path for the sleep offset, when there's no valid offset yet, or
+ * a recheck is due.
+ */
+static uint64_t
+update_sleep_offset(uint64_t mach_time)
+{
+  uint64_t offset, next_check;
+
+  if (!sleepofs_seq) {
+    /* No offset yet - wait for anyone else computing it */
+    while (!__sync_bool_compare_and_swap(&sleepofs_busy, 0, 1)) {
+      (void) sched_yield();
+    }
+    if (!sleepofs_seq) (void) get_sleep_offset();
+    __sync_lock_release(&sleepofs_busy);
+  } else if (__sync_bool_compare_and_swap(&sleepofs_busy, 0, 1)) {
+    (void) read_sleepofs(&offset, &next_check);
+    if (mach_time >= next_check) recheck_sleep_offset(mach_time);
+    __sync_lock_release(&sleepofs_busy);
+  }
+
+  (void) read_sleepofs(&offset, &next_check);
+  return offset;
+}
+
+/* Get the sleep offset applicable to the given mach time */
+static inline uint64_t
+get_offset(uint64_t mach_time)
+{
+  uint64_t offset, next_check;
+
+  if (MPLS_SLOWPATH(!read_sleepofs(&offset, &next_check)
+                    || mach_time >= next_check)) {
+    return update_sleep_offset(mach_time);
+  }
+  return offset;
 }
 
 /*
@@ -284,25 +425,23 @@ static void get_sleep_offset(void)
 static void __attribute__((constructor))
 startup_sleep_offset(void)
 {
-  get_sleep_offset();
+  (void) update_sleep_offset(0);
 }
 
 uint64_t mach_continuous_time(void)
 {
   uint64_t mach_time;
 
-  if (MPLS_SLOWPATH(!sleep_offset_valid)) get_sleep_offset();
   mach_time = mach_absolute_time();
-  return mach_time + sleep_offset;
+  return mach_time + get_offset(mach_time);
 }
 
 uint64_t mach_continuous_approximate_time(void)
 {
   uint64_t mach_time;
 
-  if (MPLS_SLOWPATH(!sleep_offset_valid)) get_sleep_offset();
   mach_time = mach_approximate_time();
-  return mach_time + sleep_offset;
+  return mach_time + get_offset(mach_time);
 }
 
 #endif /* __MPLS_LIB_SUPPORT_CONTINUOUS_TIME__ */
@@ -311,7 +450,10 @@ uint64_t mach_continuous_approximate_time(void)
 
 #include <errno.h>
 #include <math.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -321,11 +463,11 @@ uint64_t mach_continuous_approximate_time(void)
 #include <mach/mach_init.h>
 #include <mach/mach_port.h>
 #include <mach/mach_time.h>
+#include <mach/task.h>
 #include <mach/thread_act.h>
 
-/* Constants for scaling time values */
-#define BILLION32 1000000000U
-#define BILLION64 1000000000ULL
+#include "time_conv.h"
+#include "util.h"
 
 /*
  * CLOCK_MONOTONIC
@@ -446,10 +588,14 @@ uint64_t mach_continuous_approximate_time(void)
  * separate seconds and nanoseconds.  The straightforward mutiply-only
  * approach doesn't work out so well in this case, either in range or in
  * error magnitude, so we just compute nanoseconds as in the former case,
- * and then divide to get seconds.  To get the nanosecond remainder, we
- * multiply back and subtract, which is faster than using the modulo operator,
- * and none of the *div() functions provdes the needed mixed-precision
- * operation needed here.
+ * and then divide to get seconds.  The divide is actually a multiply by a
+ * precomputed reciprocal, since a 64-bit divide is a slow library call on
+ * 32-bit platforms.  To get the nanosecond remainder, we multiply back and
+ * subtract, which is faster than using the modulo operator, and none of the
+ * *div() functions provdes the needed mixed-precision operation needed here.
+ *
+ * The arithmetic itself is in time_conv.h, which uses native 128-bit
+ * multiplies where available.
  *
  * The other use of mach_time scaling is for clock_getres(), where the
  * scale factor actually represents the resolution of all clocks based on
@@ -465,16 +611,11 @@ uint64_t mach_continuous_approximate_time(void)
  * to ensure that the time obtained is as close as possible to the function's
  * return, even though the scale factor is cached.  It also avoids obtaining
  * the scale factor for clocks that don't need it, in spite of the cacheing.
- * Here we just always do the setup first, regardless of clock type, but
- * defer the reporting of any related error until the need is known.
+ * Here we just always do the setup first, regardless of clock type (other
+ * than CLOCK_REALTIME, as described below), but defer the reporting of any
+ * related error until the need is known.
  */
 
-#define EXTRA_SHIFT 2
-#define HIGH_SHIFT (32 + EXTRA_SHIFT)
-#define HIGH_BITS (64 - HIGH_SHIFT)
-#define NUMERATOR_MASK (~0U << HIGH_BITS)
-#define NULL_SCALE (1ULL << HIGH_SHIFT)
-
 /* The cached mach_time scale factors */
 static mach_timebase_info_data_t mach_scale = {0};
 static uint64_t mach_mult = 0;
@@ -504,13 +645,7 @@ setup_mach_mult(void)
   int ret = get_mach_scale();
 
   /* Set up main multiplier (0 if error getting scale) */
-  if (!(mach_scale.numer & NUMERATOR_MASK)) {
-    mach_mult = (((uint64_t) mach_scale.numer << HIGH_SHIFT)
-                 + mach_scale.denom / 2) / mach_scale.denom;
-  } else {
-    mach_mult = ((((uint64_t) mach_scale.numer << 32)
-                 + mach_scale.denom / 2) / mach_scale.denom) << EXTRA_SHIFT;
-  }
+  mach_mult = mach_mult_from_scale(mach_scale.numer, mach_scale.denom);
 
   /* Also set up resolution as nanos/count rounded up */
   res_mach.tv_nsec = (mach_mult + (NULL_SCALE - 1)) >> HIGH_SHIFT;
@@ -518,70 +653,11 @@ setup_mach_mult(void)
   return ret;
 }
 
-#define MASK64LOW 0xFFFFFFFFULL
-
-/*
- * 64x64->128 multiply, returning middle 64
- *
- * This code has been verified with a floating-zeroes/ones test, comparing
- * the results to Python's built-in multiprecision arithmetic.
- */
-static inline uint64_t
-mmul64(uint64_t a, uint64_t b)
-{
-  /* Split the operands into halves */
-  uint32_t a_hi = a >> 32, a_lo = a;
-  uint32_t b_hi = b >> 32, b_lo = b;
-  uint64_t high, mid1, mid2, low;
-
-  /* Compute the four cross products */
-  low = (uint64_t) a_lo * b_lo;
-  mid1 = (uint64_t) a_lo * b_hi;
-  mid2 = (uint64_t) a_hi * b_lo;
-  high = (uint64_t) a_hi * b_hi;
-
-  /* Fold the results (must be in carry-propagation order) */
-  mid1 += (mid2 & MASK64LOW) + (low >> 32);
-  high += (mid1 >> 32) + (mid2 >> 32);  /* Shifts must precede add */
-
-  /* Combine and return the two middle chunks */
-  return (high << 32) + (mid1 & MASK64LOW);
-}
-
 /* Convert mach units to nanoseconds */
 static inline uint64_t
 mach2nanos(uint64_t mach_time)
 {
-  /* If 1:1 scaling (x86), return as is */
-  if (mach_mult == NULL_SCALE) return mach_time;
-
-  /* Otherwise, return appropriately scaled value */
-  return mmul64(mach_time, mach_mult) >> EXTRA_SHIFT;
-}
-
-/* Convert nanoseconds to timespec */
-static inline void
-nanos2timespec(uint64_t nanos, struct timespec *ts)
-{
-  uint64_t secs;
-  uint32_t lownanos, lowsecs, nanorem;
-
-  /* Divide nanoseconds to get seconds */
-  secs = nanos / BILLION32;
-
-  /*
-   * Multiply & subtract (all 32-bit) to get nanosecond remainder.
-   *
-   * This is more efficient than using the '%' operator on all platforms,
-   * and there's no version of *div() for a 64-bit dividend and 32-bit
-   * divisor.  Since the divisor, and hence the remainder, are known to
-   * fit in 32 bits, the entire computation can be done in 32 bits.
-   */
-  lownanos = nanos; lowsecs = secs;
-  nanorem = lownanos - lowsecs * BILLION32;
-
-  /* Return values as a timespec */
-  ts->tv_sec = secs; ts->tv_nsec = nanorem;
+  return mach2nanos_mult(mach_time, mach_mult);
 }
 
 /* Convert mach units to timespec */
@@ -614,6 +690,274 @@ tvdiff2mach(const struct timeval *tv1, const struct timeval *tv2)
   return tvdiff * mach_scale.denom / mach_scale.numer;
 }
 
+/*
+ * Fast CLOCK_REALTIME
+ *
+ * The only source for the time of day is gettimeofday(), with microsecond
+ * resolution.  To get nanosecond resolution, and to avoid calling it on
+ * every read, we derive CLOCK_REALTIME from mach_absolute_time(), using a
+ * calibration pair of a mach time and the corresponding time of day.  This
+ * is essentially what the 10.12+ commpage code does, except that there the
+ * kernel maintains the pair, while here we have to recalibrate it ourselves.
+ *
+ * The two clocks run at the same rate, except while the time of day is being
+ * slewed by adjtime(), which the kernel does at up to 40us per 10ms tick, or
+ * 4000ppm.  A step (settimeofday()) by some other process isn't seen at all
+ * until the next recalibration.  Hence a calibration is only used for a
+ * limited interval, which is the tolerated error divided by the maximum slew
+ * rate.  The tolerance (in microseconds) is REALTIME_TOLERANCE_US, or the
+ * value of the MPLS_CLOCK_REALTIME_TOL environment variable if set.  The
+ * default of 100us gives a 25ms interval.  A tolerance of zero disables the
+ * fast path, making CLOCK_REALTIME just a wrapper around gettimeofday(), as
+ * it was previously.
+ *
+ * Since mach time doesn't advance during system sleep, a calibration made
+ * before a sleep lags by the length of the sleep.  Nothing cheap enough for
+ * the fast path notices a wakeup directly, and both the calibration's expiry
+ * and the recheck of the sleep offset (see mach_continuous_time() above) are
+ * measured in mach time.  So after a wakeup, CLOCK_REALTIME can lag by the
+ * length of the sleep until one of them comes due.  To bound that, each
+ * calibration records the sleep offset in effect, and is only used while
+ * the offset is unchanged, making the window the lesser of the calibration
+ * interval (25ms by default) and SLEEP_RECHECK_MS (100ms) of running time.
+ * A sleep too short to change the offset (see MIN_SLEEP_OFFSET_ADVANCE)
+ * lasts until the calibration expires, which with the maximum tolerance is
+ * up to 250 seconds of running time.
+ *
+ * Within the tolerance, an extrapolation may run ahead of the time of day,
+ * so a new calibration could otherwise step back from times already
+ * returned.  So when a recalibration would step back by no more than twice
+ * the tolerance (allowing for the calibration error), the new calibration
+ * gets a floor at the old extrapolated time, and holds the clock there until
+ * the time of day catches up.  The same applies to gettimeofday() in the
+ * slow path.  Larger backward steps are real steps of the time of day, and
+ * are followed, as is any clock_settime() from this process.
+ *
+ * A calibration point is a change in the time of day, sandwiched by mach
+ * time reads, taking the tightest of a few samples, as in get_todmach().
+ * This normally locates the point to well within a microsecond.
+ *
+ * The pair is too large to update atomically (especially on 32-bit
+ * platforms), so it's published with a sequence count, which is odd while
+ * an update is in progress, and zero if there's no valid calibration.
+ * A reader that sees an update in progress, a changed count, or an expired
+ * calibration takes the slow path, which recalibrates if no other thread is
+ * already doing so, and otherwise just uses gettimeofday().  Hence readers
+ * never wait.  A clock_settime() of CLOCK_REALTIME forces a recalibration,
+ * so that the caller sees its own step immediately.
+ *
+ * The CLOCK_REALTIME path doesn't need the usual mach scaling check, since
+ * a valid calibration implies that the scale factor was set up.
+ */
+
+#ifndef REALTIME_TOLERANCE_US
+#define REALTIME_TOLERANCE_US 100
+#endif
+
+#define REALTIME_TOLERANCE_VAR "MPLS_CLOCK_REALTIME_TOL"
+#define REALTIME_TOLERANCE_MAX 1000000  /* One second */
+#define REALTIME_MAX_SLEW_PPM  4000
+#define REALTIME_CAL_SAMPLES   3
+
+typedef struct realtime_cal_s {
+  uint64_t mach_base;     /* Mach time of calibration point */
+  uint64_t nanos_base;    /* Time of day (ns) at calibration point */
+  uint64_t sleep_offset;  /* Sleep offset when calibrated */
+  uint64_t nanos_floor;   /* Minimum time (ns) to report */
+} realtime_cal_t;
+
+static realtime_cal_t rt_cal;
+static volatile uint32_t rt_seq = 0;
+static uint64_t rt_interval = 0;  /* In mach units, 0 if disabled */
+static uint64_t rt_maxback = 0;   /* Largest step back to hold (ns) */
+static volatile int rt_busy = 0;
+static pthread_once_t rt_once = PTHREAD_ONCE_INIT;
+
+/* Set up the calibration interval from the tolerance */
+static void
+realtime_getpolicy(void)
+{
+  size_t tol = __mpls_getenv_size(REALTIME_TOLERANCE_VAR, 0,
+                                  REALTIME_TOLERANCE_MAX,
+                                  REALTIME_TOLERANCE_US);
+
+  /* Without the scale factor, there's no fast path */
+  if (get_mach_scale()) return;
+  rt_maxback = tol * 2000ULL;
+  rt_interval = (double) tol * 1000 * (1000000 / REALTIME_MAX_SLEW_PPM)
+                * mach_scale.denom / mach_scale.numer;
+}
+
+/* Get the time from a calibration, not going back before its floor */
+static inline uint64_t
+realtime_from_cal(const realtime_cal_t *cal, uint64_t mach_time)
+{
+  uint64_t nanos = cal->nanos_base + mach2nanos(mach_time - cal->mach_base);
+
+  return MPLS_FASTPATH(nanos >= cal->nanos_floor) ? nanos : cal->nanos_floor;
+}
+
+/*
+ * Hold a time from going back before the current calibration (if still
+ * applicable), when the step is small enough to be calibration error.
+ */
+static uint64_t
+realtime_hold(const realtime_cal_t *cal, uint64_t mach_time, uint64_t nanos)
+{
+  uint64_t prev;
+
+  if (cal->sleep_offset != get_offset(mach_time)) return nanos;
+  prev = realtime_from_cal(cal, mach_time);
+  return prev > nanos && prev - nanos <= rt_maxback ? prev : nanos;
+}
+
+/* Capture one time of day edge, with its mach time uncertainty */
+static int
+realtime_sample(realtime_cal_t *cal, uint64_t *window)
+{
+  struct timeval tv1, tv2;
+  uint64_t mt1, mt2;
+
+  if (gettimeofday(&tv1, NULL)) return -1;
+  mt2 = mach_absolute_time();
+  do {
+    mt1 = mt2;
+    if (gettimeofday(&tv2, NULL)) return -1;
+    mt2 = mach_absolute_time();
+  } while (tv2.tv_usec == tv1.tv_usec);
+
+  cal->mach_base = mt1 + (mt2 - mt1) / 2;
+  cal->nanos_base = tv2.tv_sec * BILLION64 + tv2.tv_usec * 1000;
+  *window = mt2 - mt1;
+  return 0;
+}
+
+/*
+ * Calibrate and publish the result (caller must own rt_busy).  Unless
+ * following a step, the result is held to the previous calibration.
+ */
+static int
+realtime_calibrate(realtime_cal_t *cal, int step)
+{
+  realtime_cal_t sample;
+  uint64_t window, best = ~0ULL, mach_time, nanos, held;
+  uint32_t seq;
+  int tries;
+
+  if (MPLS_SLOWPATH(!mach_mult) && setup_mach_mult()) return -1;
+
+  for (tries = 0; tries < REALTIME_CAL_SAMPLES; ++tries) {
+    if (realtime_sample(&sample, &window)) return -1;
+    if (window < best) {
+      *cal = sample;
+      best = window;
+    }
+  }
+  cal->sleep_offset = get_offset(cal->mach_base);
+  cal->nanos_floor = 0;
+
+  /* We're the only writer, so the current calibration is stable */
+  seq = rt_seq;
+  if (seq && !step) {
+    mach_time = mach_absolute_time();
+    nanos = realtime_from_cal(cal, mach_time);
+    held = realtime_hold(&rt_cal, mach_time, nanos);
+    if (held > nanos) cal->nanos_floor = held;
+  }
+
+  rt_seq = seq + 1;
+  MPLS_WRITE_BARRIER();
+  rt_cal = *cal;
+  MPLS_WRITE_BARRIER();
+  seq += 2;
+  rt_seq = seq ? seq : 2;  /* Skip the "invalid" value on wraparound */
+  return 0;
+}
+
+/* Get a consistent copy of the calibration, returning its count */
+static inline uint32_t
+read_realtime_cal(realtime_cal_t *cal)
+{
+  uint32_t seq;
+
+  do {
+    seq = rt_seq;
+    MPLS_READ_BARRIER();
+    *cal = rt_cal;
+    MPLS_READ_BARRIER();
+  } while (MPLS_SLOWPATH((seq & 1) || seq != rt_seq));
+  return seq;
+}
+
+/* Slow path for CLOCK_REALTIME, returning nanoseconds or 0 on error */
+static uint64_t
+get_realtime_slow(void)
+{
+  struct timeval tod;
+  realtime_cal_t cal;
+  uint64_t mach_time, nanos;
+  int ret;
+
+  (void) pthread_once(&rt_once, realtime_getpolicy);
+
+  if (rt_interval && __sync_bool_compare_and_swap(&rt_busy, 0, 1)) {
+    ret = realtime_calibrate(&cal, 0);
+    __sync_lock_release(&rt_busy);
+    if (!ret) return realtime_from_cal(&cal, mach_absolute_time());
+  }
+
+  /* Recalibration in progress or failed - use the time of day, held */
+  mach_time = mach_absolute_time();
+  if (gettimeofday(&tod, NULL)) return 0;
+  nanos = tod.tv_sec * BILLION64 + tod.tv_usec * 1000;
+  if (rt_interval && read_realtime_cal(&cal)) {
+    nanos = realtime_hold(&cal, mach_time, nanos);
+  }
+  return nanos;
+}
+
+/*
+ * Get a consistent calibration, if there's one valid at the given time.
+ * The readers here don't wait for an update; they take the slow path.
+ */
+static inline int
+get_realtime_cal(realtime_cal_t *cal, uint64_t mach_time)
+{
+  uint32_t seq;
+
+  seq = rt_seq;
+  MPLS_READ_BARRIER();
+  *cal = rt_cal;
+  MPLS_READ_BARRIER();
+  return seq && !(seq & 1) && rt_seq == seq
+         && mach_time - cal->mach_base < rt_interval
+         && cal->sleep_offset == get_offset(mach_time);
+}
+
+/* Get CLOCK_REALTIME in nanoseconds, or 0 on error */
+static inline uint64_t
+get_realtime_ns(void)
+{
+  realtime_cal_t cal;
+  uint64_t mach_time = mach_absolute_time();
+
+  if (MPLS_FASTPATH(get_realtime_cal(&cal, mach_time))) {
+    return realtime_from_cal(&cal, mach_time);
+  }
+  return get_realtime_slow();
+}
+
+/* Force a recalibration (if there's a calibration), after a step */
+static void
+realtime_reset(void)
+{
+  realtime_cal_t cal;
+
+  while (!__sync_bool_compare_and_swap(&rt_busy, 0, 1)) (void) sched_yield();
+  if (rt_seq && realtime_calibrate(&cal, 1)) rt_seq = 0;
+  __sync_lock_release(&rt_busy);
+}
+
 /*
  * Get the best available thread time, using __thread_selfusage() on 10.10+,
  * but falling back to thread_info() on <10.10.
@@ -632,14 +976,85 @@ tvdiff2mach(const struct timeval *tv1, const struct timeval *tv2)
 
 #if __MPLS_TARGET_OSVER < 101000
 
+/*
+ * Each mach_thread_self() adds a reference to the thread's port, which has
+ * to be released, so getting the port for each call would cost two extra
+ * traps.  Instead, we keep one reference per thread in thread-specific data,
+ * released by the key's destructor at thread exit.  A forked child's thread
+ * has a different port, and the inherited name isn't valid there, so the
+ * child just discards it.  If the key can't be set up, we fall back to
+ * getting the port on every call.
+ */
+static pthread_key_t thread_port_key;
+static pthread_once_t thread_port_once = PTHREAD_ONCE_INIT;
+static volatile int thread_port_ok = 0;  /* 1 if key set up, -1 if failed */
+
+static void
+release_thread_port(void *value)
+{
+  (void) mach_port_deallocate(mach_task_self(),
+                              (thread_port_t) (uintptr_t) value);
+}
+
+static void
+forget_thread_port(void)
+{
+  (void) pthread_setspecific(thread_port_key, NULL);
+}
+
+static void
+setup_thread_port(void)
+{
+  if (pthread_key_create(&thread_port_key, release_thread_port)) {
+    thread_port_ok = -1;
+    return;
+  }
+  if (pthread_atfork(NULL, NULL, forget_thread_port)) {
+    (void) pthread_key_delete(thread_port_key);
+    thread_port_ok = -1;
+    return;
+  }
+  MPLS_WRITE_BARRIER();
+  thread_port_ok = 1;
+}
+
+/* Get the cached thread port, or MACH_PORT_NULL if not possible */
+static inline thread_port_t
+get_thread_port(void)
+{
+  thread_port_t thread;
+
+  if (MPLS_SLOWPATH(thread_port_ok <= 0)) {
+    (void) pthread_once(&thread_port_once, setup_thread_port);
+    if (thread_port_ok < 0) return MACH_PORT_NULL;
+  }
+  MPLS_READ_BARRIER();
+
+  thread = (thread_port_t) (uintptr_t) pthread_getspecific(thread_port_key);
+  if (MPLS_SLOWPATH(thread == MACH_PORT_NULL)) {
+    thread = mach_thread_self();
+    if (pthread_setspecific(thread_port_key, (void *) (uintptr_t) thread)) {
+      (void) mach_port_deallocate(mach_task_self(), thread);
+      return MACH_PORT_NULL;
+    }
+  }
+  return thread;
+}
+
 /* Common thread usage code */
 static int
 get_thread_usage(thread_basic_info_data_t *info)
 {
   int ret;
   mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
-  thread_port_t thread = mach_thread_self();
+  thread_port_t thread = get_thread_port();
 
+  if (MPLS_FASTPATH(thread != MACH_PORT_NULL)) {
+    return thread_info(thread, THREAD_BASIC_INFO, (thread_info_t) info,
+                       &count);
+  }
+
+  thread = mach_thread_self();
   ret = thread_info(thread, THREAD_BASIC_INFO, (thread_info_t) info, &count);
   mach_port_deallocate(mach_task_self(), thread);
   return ret;
@@ -710,28 +1125,241 @@ get_thread_usage_ts(struct timespec *ts)
 
 #endif /* __MPLS_TARGET_OSVER >= 101000 */
 
+/*
+ * Get the CPU usage of the process.
+ *
+ * The TASK_ABSOLUTETIME_INFO flavor of task_info() (available since 10.4)
+ * provides this in mach time units, with separate totals for user and
+ * system time, each including both the live threads and those that have
+ * terminated.  That's a single trap with mach resolution, whereas
+ * getrusage() has only microsecond resolution, and fills in a lot of other
+ * data that we don't need.  Hence getrusage() is only a fallback, in case
+ * task_info() fails for some reason.
+ */
+static inline int
+get_process_usage(uint64_t *mach_time)
+{
+  task_absolutetime_info_data_t info;
+  mach_msg_type_number_t count = TASK_ABSOLUTETIME_INFO_COUNT;
+
+  if (task_info(mach_task_self(), TASK_ABSOLUTETIME_INFO,
+                (task_info_t) &info, &count) != KERN_SUCCESS) {
+    return -1;
+  }
+  *mach_time = info.total_user + info.total_system;
+  return 0;
+}
+
+/* Fallback for the above */
+static int
+get_process_rusage(struct timeval *tv)
+{
+  struct rusage ru;
+
+  if (getrusage(RUSAGE_SELF, &ru)) return -1;
+  timeradd(&ru.ru_utime, &ru.ru_stime, tv);
+  return 0;
+}
+
+/* Get the CPU usage of the process, in nanoseconds */
+static inline uint64_t
+get_process_usage_ns(void)
+{
+  uint64_t mach_time;
+  struct timeval tv;
+
+  if (MPLS_FASTPATH(!get_process_usage(&mach_time))) {
+    return mach2nanos(mach_time);
+  }
+  if (get_process_rusage(&tv)) return 0;
+  return tv.tv_sec * BILLION64 + tv.tv_usec * 1000;
+}
+
+/*
+ * Coarse clocks (legacy-support extension)
+ *
+ * CLOCK_REALTIME_COARSE and CLOCK_MONOTONIC_COARSE are for callers that
+ * read the time very frequently but only need it to the nearest few
+ * milliseconds, such as loggers.  When clock_coarse_start_np() has been
+ * called, a helper thread publishes both times every given number of
+ * milliseconds, so that a read is just a load of the published value.
+ * Otherwise, they're read directly from the CLOCK_REALTIME and
+ * CLOCK_MONOTONIC_RAW sources, and the only saving is the quantization
+ * of CLOCK_MONOTONIC.
+ *
+ * The published values are zero when the helper thread isn't running, so
+ * that a single load suffices to check it.  On 64-bit platforms, that load
+ * is atomic, but on 32-bit platforms, the pair is published with a sequence
+ * count as for CLOCK_REALTIME, and a reader that catches an update in
+ * progress just uses the direct read.  Successive ticks are monotonic, but
+ * the first tick after a start can be up to a few microseconds behind a
+ * direct read made while it was being computed.  The helper thread doesn't
+ * run during system sleep, and its sleep between ticks is measured in mach
+ * time, so the values are stale after a wakeup until the rest of that
+ * interval (up to COARSE_MAX_MS) has run.  Since the fast CLOCK_REALTIME
+ * path can still be using a pre-sleep calibration at that point (see
+ * above), the helper reads CLOCK_REALTIME via the slow path, recalibrating
+ * on every tick, so as not to publish a stale value for another whole
+ * interval.  CLOCK_MONOTONIC_COARSE takes up the sleep time when
+ * CLOCK_MONOTONIC does, at the first tick after the sleep offset recheck.
+ *
+ * The helper thread isn't inherited by a forked child, so the child reverts
+ * to the direct reads until it starts its own.  The mutex is held across
+ * fork(), so that the helper isn't in the middle of a tick, and the child
+ * resets the state before releasing it.
+ */
+
+#define COARSE_MAX_MS 1000
+
+/* These are only defined by our time.h with a pre-10.12 SDK */
+#ifndef CLOCK_REALTIME_COARSE
+#define CLOCK_REALTIME_COARSE ((clockid_t) 32)
+#define CLOCK_MONOTONIC_COARSE ((clockid_t) 33)
+#endif
+
+#define IS_COARSE(clk_id) \
+  ((clk_id) == CLOCK_REALTIME_COARSE || (clk_id) == CLOCK_MONOTONIC_COARSE)
+
+typedef struct coarse_rec_s {
+  uint64_t realtime;   /* CLOCK_REALTIME_COARSE (ns), 0 if not running */
+  uint64_t monotonic;  /* CLOCK_MONOTONIC_COARSE (ns), 0 if not running */
+} coarse_rec_t;
+
+static volatile coarse_rec_t coarse_rec = {0, 0};
+#ifndef __LP64__
+static volatile uint32_t coarse_seq = 0;
+#endif
+
+/* Helper thread control, protected by the mutex */
+static pthread_mutex_t coarse_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t coarse_once = PTHREAD_ONCE_INIT;
+static uint32_t coarse_gen = 0;  /* Incremented to stop the thread */
+static int coarse_running = 0;
+static struct timespec coarse_interval = {0, 0};
+
+/* Publish new coarse values (caller must hold the mutex) */
+static void
+coarse_publish(uint64_t realtime, uint64_t monotonic)
+{
+#ifdef __LP64__
+  coarse_rec.realtime = realtime;
+  coarse_rec.monotonic = monotonic;
+#else
+  uint32_t seq = coarse_seq;
+
+  coarse_seq = seq + 1;
+  MPLS_WRITE_BARRIER();
+  coarse_rec.realtime = realtime;
+  coarse_rec.monotonic = monotonic;
+  MPLS_WRITE_BARRIER();
+  coarse_seq = seq + 2;
+#endif
+}
+
+/* Update the coarse values from the precise clocks (mutex held) */
+static void
+coarse_tick(void)
+{
+  uint64_t realtime = get_realtime_slow();
+  uint64_t monotonic = mach2nanos(mach_continuous_time());
+
+  /* Keep the monotonic clock monotonic, and never publish zeroes */
+  if (monotonic < coarse_rec.monotonic) monotonic = coarse_rec.monotonic;
+  if (realtime && monotonic) coarse_publish(realtime, monotonic);
+}
+
+static void *
+coarse_thread(void *arg)
+{
+  uint32_t gen = (uint32_t) (uintptr_t) arg;
+  struct timespec interval;
+
+  while (1) {
+    (void) pthread_mutex_lock(&coarse_mutex);
+    if (gen != coarse_gen) break;
+    coarse_tick();
+    interval = coarse_interval;
+    (void) pthread_mutex_unlock(&coarse_mutex);
+    (void) nanosleep(&interval, NULL);
+  }
+  (void) pthread_mutex_unlock(&coarse_mutex);
+  return NULL;
+}
+
+static void
+coarse_fork_prepare(void)
+{
+  (void) pthread_mutex_lock(&coarse_mutex);
+}
+
+static void
+coarse_fork_parent(void)
+{
+  (void) pthread_mutex_unlock(&coarse_mutex);
+}
+
+/* In a forked child, there's no helper thread */
+static void
+coarse_fork_child(void)
+{
+  ++coarse_gen;
+  coarse_running = 0;
+  coarse_publish(0, 0);
+  (void) pthread_mutex_unlock(&coarse_mutex);
+}
+
+static void
+coarse_setup(void)
+{
+  (void) pthread_atfork(coarse_fork_prepare, coarse_fork_parent,
+                        coarse_fork_child);
+}
+
+/* Get a coarse clock in nanoseconds, or 0 on error */
+static inline uint64_t
+get_coarse_ns(int monotonic)
+{
+  uint64_t nanos;
+#ifndef __LP64__
+  uint32_t seq;
+
+  seq = coarse_seq;
+  MPLS_READ_BARRIER();
+  nanos = monotonic ? coarse_rec.monotonic : coarse_rec.realtime;
+  MPLS_READ_BARRIER();
+  if (MPLS_SLOWPATH((seq & 1) || coarse_seq != seq)) nanos = 0;
+#else
+  nanos = monotonic ? coarse_rec.monotonic : coarse_rec.realtime;
+#endif
+  if (MPLS_FASTPATH(nanos)) return nanos;
+
+  if (!monotonic) return get_realtime_ns();
+  if (MPLS_SLOWPATH(!mach_mult)) (void) setup_mach_mult();
+  return mach2nanos(mach_continuous_time());
+}
+
 /* Now the actual public functions */
 
 uint64_t
 clock_gettime_nsec_np(clockid_t clk_id)
 {
-  struct timeval tod;
-  struct rusage ru;
   uint64_t mach_time;
 
+  /* CLOCK_REALTIME does its own setup, only in its slow path. */
+  if (clk_id == CLOCK_REALTIME) return get_realtime_ns();
+
+  /* As do the coarse clocks. */
+  if (IS_COARSE(clk_id)) {
+    return get_coarse_ns(clk_id == CLOCK_MONOTONIC_COARSE);
+  }
+
   /* Set up mach scaling early, whether we need it or not. */
   if (MPLS_SLOWPATH(!mach_mult)) setup_mach_mult();
 
   switch (clk_id) {
 
-  case CLOCK_REALTIME:
-    if (gettimeofday(&tod, NULL)) return 0;
-    return tod.tv_sec * BILLION64 + tod.tv_usec * 1000;
-
   case CLOCK_PROCESS_CPUTIME_ID:
-    if (getrusage(RUSAGE_SELF, &ru)) return 0;
-    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * BILLION64
-           + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000;
+    return get_process_usage_ns();
 
   case CLOCK_THREAD_CPUTIME_ID:
     return get_thread_usage_ns();
@@ -768,26 +1396,34 @@ clock_gettime_nsec_np(clockid_t clk_id)
 int
 clock_gettime(clockid_t clk_id, struct timespec *ts)
 {
-  int ret, mserr = 0;
-  struct timeval tod;
-  struct rusage ru;
+  int mserr = 0;
+  struct timeval tv;
   uint64_t mach_time, nanos;
 
+  /* CLOCK_REALTIME does its own setup, only in its slow path. */
+  if (clk_id == CLOCK_REALTIME) {
+    if (!(nanos = get_realtime_ns())) return -1;
+    nanos2timespec(nanos, ts);
+    return 0;
+  }
+
+  /* As do the coarse clocks. */
+  if (IS_COARSE(clk_id)) {
+    if (!(nanos = get_coarse_ns(clk_id == CLOCK_MONOTONIC_COARSE))) return -1;
+    nanos2timespec(nanos, ts);
+    return 0;
+  }
+
   /* Set up mach scaling early, whether we need it or not. */
   if (MPLS_SLOWPATH(!mach_mult)) mserr = setup_mach_mult();
 
   switch (clk_id) {
 
-  case CLOCK_REALTIME:
-    ret = gettimeofday(&tod, NULL);
-    ts->tv_sec = tod.tv_sec; ts->tv_nsec = tod.tv_usec * 1000;
-    return ret;
-
   case CLOCK_PROCESS_CPUTIME_ID:
-    ret = getrusage(RUSAGE_SELF, &ru);
-    timeradd(&ru.ru_utime, &ru.ru_stime, &ru.ru_utime);
-    TIMEVAL_TO_TIMESPEC(&ru.ru_utime, ts);
-    return ret;
+    if (MPLS_FASTPATH(!get_process_usage(&mach_time))) break;
+    if (get_process_rusage(&tv)) return -1;
+    TIMEVAL_TO_TIMESPEC(&tv, ts);
+    return 0;
 
   case CLOCK_THREAD_CPUTIME_ID:
     return get_thread_usage_ts(ts);
@@ -827,16 +1463,32 @@ clock_gettime(clockid_t clk_id, struct timespec *ts)
 int
 clock_getres(clockid_t clk_id, struct timespec *res)
 {
-  int mserr = 0;
+  int mserr = 0, running;
 
   /* Set up mach scale factor, whether we need it or not. */
   if (MPLS_SLOWPATH(!res_mach.tv_nsec)) mserr = setup_mach_mult();
 
+  /* The coarse clocks have the tick interval, if running. */
+  if (IS_COARSE(clk_id)) {
+    (void) pthread_mutex_lock(&coarse_mutex);
+    running = coarse_running;
+    if (running) *res = coarse_interval;
+    (void) pthread_mutex_unlock(&coarse_mutex);
+    if (running) return 0;
+    clk_id = clk_id == CLOCK_REALTIME_COARSE ? CLOCK_REALTIME
+                                             : CLOCK_MONOTONIC_RAW;
+  }
+
   switch (clk_id) {
 
-  /* Everything based on timeval has microsecond resolution. */
+  /* Realtime has mach resolution, unless the fast path is disabled. */
   case CLOCK_REALTIME:
-  case CLOCK_PROCESS_CPUTIME_ID:
+    (void) pthread_once(&rt_once, realtime_getpolicy);
+    if (rt_interval) break;
+    *res = res_micros;
+    return 0;
+
+  /* Everything based on timeval has microsecond resolution. */
 #if !HIRES_THREAD_TIME
   case CLOCK_THREAD_CPUTIME_ID:
 #endif
@@ -849,6 +1501,7 @@ clock_getres(clockid_t clk_id, struct timespec *res)
   case CLOCK_MONOTONIC_RAW_APPROX:
   case CLOCK_UPTIME_RAW:
   case CLOCK_UPTIME_RAW_APPROX:
+  case CLOCK_PROCESS_CPUTIME_ID:  /* Unless using the getrusage() fallback */
 #if HIRES_THREAD_TIME
   case CLOCK_THREAD_CPUTIME_ID:
 #endif
@@ -874,7 +1527,9 @@ clock_settime(clockid_t clk_id, const struct timespec *ts)
   case CLOCK_REALTIME:
     tv.tv_sec = ts->tv_sec;
     tv.tv_usec = ts->tv_nsec / 1000;
-    return settimeofday(&tv, NULL);
+    if (settimeofday(&tv, NULL)) return -1;
+    realtime_reset();
+    return 0;
 
   default:
     errno = EINVAL;
@@ -882,6 +1537,180 @@ clock_settime(clockid_t clk_id, const struct timespec *ts)
   }
 }
 
+/*
+ * Batch clock sampling (legacy-support extension)
+ *
+ * This reads several clocks as nearly simultaneously as possible, so that
+ * they can be correlated.  All clocks derived from mach_absolute_time() are
+ * computed from a single mach time, taken as the midpoint of a pair of reads
+ * bracketing everything that needs its own read (the CPU-time clocks, and
+ * CLOCK_REALTIME when it's due for recalibration).  The span of that pair,
+ * rounded up by one mach unit as in get_todmach(), is returned as the
+ * window, which bounds the skew between any two of the samples.  With only
+ * mach-derived clocks, it's just the cost of one mach_absolute_time().
+ *
+ * Each result is in nanoseconds, as from clock_gettime_nsec_np().  A clock
+ * that can't be read (including an invalid one) gets a zero result, and
+ * the function returns -1 with errno set, but the other clocks are still
+ * sampled.  The errno is EINVAL if any clock is invalid, otherwise whatever
+ * the failing call reported, or EIO if it didn't report anything (as with
+ * Mach calls).
+ */
+int
+clock_sample_np(int count, const clockid_t *clk_ids, uint64_t *nanos,
+                uint64_t *window)
+{
+  int i, ret = 0, have_cal = -1, err = 0, saved_errno;
+  uint64_t mach_before, mach_after, mach_time, sleep_offset = 0;
+  realtime_cal_t cal = {0, 0, 0, 0};
+
+  if (count < 0 || (count && (!clk_ids || !nanos))) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* Clear errno to catch any reported failure, restoring it on success */
+  saved_errno = errno;
+  errno = 0;
+
+  if (MPLS_SLOWPATH(!mach_mult)) (void) setup_mach_mult();
+
+  /* First pass: everything needing its own read, between the mach reads */
+  mach_before = mach_absolute_time();
+  for (i = 0; i < count; ++i) {
+    if (IS_COARSE(clk_ids[i])) {
+      nanos[i] = get_coarse_ns(clk_ids[i] == CLOCK_MONOTONIC_COARSE);
+      continue;
+    }
+    switch (clk_ids[i]) {
+
+    case CLOCK_REALTIME:
+      if (have_cal < 0) have_cal = get_realtime_cal(&cal, mach_before);
+      if (!have_cal) nanos[i] = get_realtime_slow();
+      continue;
+
+    case CLOCK_PROCESS_CPUTIME_ID:
+      nanos[i] = get_process_usage_ns();
+      continue;
+
+    case CLOCK_THREAD_CPUTIME_ID:
+      nanos[i] = get_thread_usage_ns();
+      continue;
+
+    case CLOCK_MONOTONIC:
+    case CLOCK_MONOTONIC_RAW:
+    case CLOCK_MONOTONIC_RAW_APPROX:
+      sleep_offset = get_offset(mach_before);
+      continue;
+
+    case CLOCK_UPTIME_RAW:
+    case CLOCK_UPTIME_RAW_APPROX:
+      continue;
+
+    default:
+      nanos[i] = 0;
+      err = EINVAL;
+      continue;
+    }
+  }
+  mach_after = mach_absolute_time();
+  mach_time = mach_before + (mach_after - mach_before) / 2;
+
+  /* Second pass: the mach-derived clocks, and error checks */
+  for (i = 0; i < count; ++i) {
+    if (IS_COARSE(clk_ids[i])) {
+      if (!nanos[i]) ret = -1;
+      continue;
+    }
+    switch (clk_ids[i]) {
+
+    case CLOCK_REALTIME:
+      if (have_cal > 0) nanos[i] = realtime_from_cal(&cal, mach_time);
+      break;
+
+    case CLOCK_MONOTONIC:
+      nanos[i] = mach2nanos(mach_time + sleep_offset) / 1000 * 1000;
+      break;
+
+    case CLOCK_MONOTONIC_RAW:
+    case CLOCK_MONOTONIC_RAW_APPROX:
+      nanos[i] = mach2nanos(mach_time + sleep_offset);
+      break;
+
+    case CLOCK_UPTIME_RAW:
+    case CLOCK_UPTIME_RAW_APPROX:
+      nanos[i] = mach2nanos(mach_time);
+      break;
+
+    default:
+      break;
+    }
+    if (!nanos[i]) ret = -1;
+  }
+
+  if (!ret) errno = saved_errno;
+  else if (err || !errno) errno = err ? err : EIO;
+  if (window) *window = mach2nanos(mach_after - mach_before + 1);
+  return ret;
+}
+
+/*
+ * Start (or retime) the coarse clock helper thread (legacy-support
+ * extension), with the given tick interval in milliseconds, or stop it if
+ * the interval is zero.  See the coarse clock description above.
+ */
+int
+clock_coarse_start_np(unsigned int interval_ms)
+{
+  pthread_attr_t attr;
+  pthread_t thread;
+  int ret = 0;
+
+  if (interval_ms > COARSE_MAX_MS) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  (void) pthread_once(&coarse_once, coarse_setup);
+  if (MPLS_SLOWPATH(!mach_mult)) (void) setup_mach_mult();
+
+  (void) pthread_mutex_lock(&coarse_mutex);
+
+  if (!interval_ms) {
+    if (coarse_running) {
+      ++coarse_gen;
+      coarse_running = 0;
+      coarse_publish(0, 0);
+    }
+    (void) pthread_mutex_unlock(&coarse_mutex);
+    return 0;
+  }
+
+  coarse_interval.tv_sec = interval_ms / 1000;
+  coarse_interval.tv_nsec = interval_ms % 1000 * 1000000;
+
+  if (!coarse_running) {
+    ++coarse_gen;
+    if (!(ret = pthread_attr_init(&attr))) {
+      (void) pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+      ret = pthread_create(&thread, &attr, coarse_thread,
+                           (void *) (uintptr_t) coarse_gen);
+      (void) pthread_attr_destroy(&attr);
+    }
+    if (!ret) {
+      coarse_running = 1;
+      coarse_tick();  /* So that the values are valid on return */
+    }
+  }
+
+  (void) pthread_mutex_unlock(&coarse_mutex);
+  if (ret) {
+    errno = ret;
+    return -1;
+  }
+  return 0;
+}
+
 #endif /* __MPLS_LIB_SUPPORT_GETTIME__ */
 
 #if __MPLS_LIB_SUPPORT_TIMESPEC_GET__
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __MACPORTS_TIME_CONV_H
+#define __MACPORTS_TIME_CONV_H
+
+/*
+ * Division-free time conversions, for the clock functions in time.c.
+ *
+ * The mach_time scaling is described in time.c.  Here we provide the
+ * arithmetic, in a form that can also be tested directly:
+ *
+ *   mmul64() returns the middle 64 bits of a 64x64->128 multiply, used to
+ *   apply the fixed-point mach_time multiplier.
+ *
+ *   umulh64() returns the high 64 bits of a 64x64->128 multiply, used to
+ *   divide nanoseconds by one billion via a precomputed reciprocal.
+ *
+ * Both use the compiler's 128-bit integer type where available (64-bit
+ * targets with gcc 4.6+ or clang), which typically compiles to a single
+ * multiply instruction.  Otherwise (including all 32-bit targets, and the
+ * gcc 4.2 builds) they use the portable four-multiply versions, which are
+ * always provided, so that they can be checked against each other.
+ *
+ * For the seconds split, compilers already replace a 64-bit divide by a
+ * constant with a reciprocal multiply on 64-bit targets, but on 32-bit
+ * targets it's a call to a library divide routine, which is much slower
+ * than the portable high multiply.  Since 1E9 = 2^9 * 1953125, we shift
+ * out the factor of two first, after which the reciprocal:
+ *   M = ceil(2^75 / 1953125) = 0x44B82FA09B5A53
+ * with a final 11-bit shift gives the exact quotient for all 55-bit
+ * dividends, i.e. for all 64-bit nanosecond values.  On a 64-bit target
+ * without the 128-bit type (i.e. gcc 4.2 x86_64), the compiler's version
+ * of this is faster than the portable multiply, so we leave it to that.
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+/* Constants for scaling time values */
+#define BILLION32 1000000000U
+#define BILLION64 1000000000ULL
+
+/* Format of the mach_time multiplier (see time.c) */
+#define EXTRA_SHIFT 2
+#define HIGH_SHIFT (32 + EXTRA_SHIFT)
+#define HIGH_BITS (64 - HIGH_SHIFT)
+#define NUMERATOR_MASK (~0U << HIGH_BITS)
+#define NULL_SCALE (1ULL << HIGH_SHIFT)
+
+/* Reciprocal for dividing by 1E9 */
+#define BILLION_PRESHIFT 9
+#define BILLION_RECIP    0x44B82FA09B5A53ULL
+#define BILLION_SHIFT    11
+
+#define MASK64LOW 0xFFFFFFFFULL
+
+#if defined(__SIZEOF_INT128__)
+#define MPLS_HAVE_UINT128 1
+#else
+#define MPLS_HAVE_UINT128 0
+#endif
+
+/*
+ * 64x64->128 multiply, returning middle 64 (portable version)
+ *
+ * This code has been verified with a floating-zeroes/ones test, comparing
+ * the results to Python's built-in multiprecision arithmetic.
+ */
+static inline uint64_t
+mmul64_portable(uint64_t a, uint64_t b)
+{
+  /* Split the operands into halves */
+  uint32_t a_hi = a >> 32, a_lo = a;
+  uint32_t b_hi = b >> 32, b_lo = b;
+  uint64_t high, mid1, mid2, low;
+
+  /* Compute the four cross products */
+  low = (uint64_t) a_lo * b_lo;
+  mid1 = (uint64_t) a_lo * b_hi;
+  mid2 = (uint64_t) a_hi * b_lo;
+  high = (uint64_t) a_hi * b_hi;
+
+  /* Fold the results (must be in carry-propagation order) */
+  mid1 += (mid2 & MASK64LOW) + (low >> 32);
+  high += (mid1 >> 32) + (mid2 >> 32);  /* Shifts must precede add */
+
+  /* Combine and return the two middle chunks */
+  return (high << 32) + (mid1 & MASK64LOW);
+}
+
+/* 64x64->128 multiply, returning high 64 (portable version) */
+static inline uint64_t
+umulh64_portable(uint64_t a, uint64_t b)
+{
+  uint32_t a_hi = a >> 32, a_lo = a;
+  uint32_t b_hi = b >> 32, b_lo = b;
+  uint64_t high, mid1, mid2, low;
+
+  low = (uint64_t) a_lo * b_lo;
+  mid1 = (uint64_t) a_lo * b_hi;
+  mid2 = (uint64_t) a_hi * b_lo;
+  high = (uint64_t) a_hi * b_hi;
+
+  /* As above, but only the carry out of the middle is kept */
+  mid1 += (mid2 & MASK64LOW) + (low >> 32);
+  return high + (mid1 >> 32) + (mid2 >> 32);
+}
+
+#if MPLS_HAVE_UINT128
+
+static inline uint64_t
+mmul64(uint64_t a, uint64_t b)
+{
+  return ((unsigned __int128) a * b) >> 32;
+}
+
+static inline uint64_t
+umulh64(uint64_t a, uint64_t b)
+{
+  return ((unsigned __int128) a * b) >> 64;
+}
+
+#else /* !MPLS_HAVE_UINT128 */
+
+#define mmul64 mmul64_portable
+#define umulh64 umulh64_portable
+
+#endif /* !MPLS_HAVE_UINT128 */
+
+/* Compute the mach->nanoseconds multiplier from the mach scale factor */
+static inline uint64_t
+mach_mult_from_scale(uint32_t numer, uint32_t denom)
+{
+  if (!(numer & NUMERATOR_MASK)) {
+    return (((uint64_t) numer << HIGH_SHIFT) + denom / 2) / denom;
+  }
+  return ((((uint64_t) numer << 32) + denom / 2) / denom) << EXTRA_SHIFT;
+}
+
+/* Convert mach units to nanoseconds, with the given multiplier */
+static inline uint64_t
+mach2nanos_mult(uint64_t mach_time, uint64_t mult)
+{
+  /* If 1:1 scaling (x86), return as is */
+  if (mult == NULL_SCALE) return mach_time;
+
+  /* Otherwise, return appropriately scaled value */
+  return mmul64(mach_time, mult) >> EXTRA_SHIFT;
+}
+
+/* Divide nanoseconds by one billion */
+static inline uint64_t
+nanos2secs(uint64_t nanos)
+{
+#if !MPLS_HAVE_UINT128 && defined(__LP64__)
+  /* The compiler's own reciprocal beats the portable multiply here */
+  return nanos / BILLION64;
+#else
+  return umulh64(nanos >> BILLION_PRESHIFT, BILLION_RECIP) >> BILLION_SHIFT;
+#endif
+}
+
+/* Convert nanoseconds to timespec */
+static inline void
+nanos2timespec(uint64_t nanos, struct timespec *ts)
+{
+  uint64_t secs;
+  uint32_t lownanos, lowsecs, nanorem;
+
+  /* Divide nanoseconds to get seconds */
+  secs = nanos2secs(nanos);
+
+  /*
+   * Multiply & subtract (all 32-bit) to get nanosecond remainder.
+   *
+   * This is more efficient than using the '%' operator on all platforms,
+   * and there's no version of *div() for a 64-bit dividend and 32-bit
+   * divisor.  Since the divisor, and hence the remainder, are known to
+   * fit in 32 bits, the entire computation can be done in 32 bits.
+   */
+  lownanos = nanos; lowsecs = secs;
+  nanorem = lownanos - lowsecs * BILLION32;
+
+  /* Return values as a timespec */
+  ts->tv_sec = secs; ts->tv_nsec = nanorem;
+}
+
+#endif /* __MACPORTS_TIME_CONV_H */
@@ -20,7 +20,10 @@
 #include "MacportsLegacySupport.h"
 
 #include <dlfcn.h>
+#include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "compiler.h"
 
@@ -51,6 +54,31 @@
 /* Obtain the address of an OS function, without an optional suffix */
 #define GET_OS_FUNC(name) GET_OS_ALT_FUNC(name,)
 
+/*
+ * Get a numeric tuning setting from the environment
+ *
+ * Returns the default if the variable is absent, malformed, or out of
+ * range, or if the program is setuid or setgid, where the environment
+ * belongs to a less privileged caller.  The caller's errno is left
+ * unchanged.
+ */
+static inline size_t
+__mpls_getenv_size(const char *name, size_t minval, size_t maxval,
+                   size_t defval)
+{
+  const char *str;
+  char *end;
+  unsigned long long val;
+  int saved_errno = errno;
+
+  if (issetugid() || !(str = getenv(name)) || !*str) return defval;
+
+  val = strtoull(str, &end, 0);
+  errno = saved_errno;
+  if (*end || val < minval || val > maxval) return defval;
+  return (size_t) val;
+}
+
 #if __MPLS_NEED_CHECK_ACCESS__
 
 #include <mach/mach_vm.h>
@@ -32,11 +32,70 @@
 #include "MacportsLegacySupport.h"
 #if __MPLS_LIB_SUPPORT_WCSNLEN__
 
+#include <stdint.h>
 #include <wchar.h>
 
+#include "compiler.h"
+
+/*
+ * With SSE2, this compares four characters at a time, using aligned loads
+ * in the same way as strnlen(), so that it can't read across a page
+ * boundary beyond the string.  This requires the usual wchar_t alignment,
+ * and misaligned strings just use the generic version.
+ *
+ * WCSNLEN_NO_SIMD may be defined to use only the generic version.
+ */
+
+#if defined(__SSE2__) && !defined(WCSNLEN_NO_SIMD)
+#define WCSNLEN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef WCSNLEN_SSE2
+
+#define VCHARS (16 / sizeof(wchar_t))
+
+static size_t
+wcsnlen_sse2(const wchar_t *s, size_t n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t off = (uintptr_t) s & 15, done, len;
+    const __m128i *vp = (const __m128i *) ((const char *) s - off);
+    unsigned int mask;
+
+    /* First (partial) block, ignoring the characters before the string */
+    mask = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_load_si128(vp), zero));
+    mask >>= off;
+    if (mask) {
+        len = __builtin_ctz(mask) / sizeof(wchar_t);
+        return len < n ? len : n;
+    }
+    done = (16 - off) / sizeof(wchar_t);
+
+    while (done < n) {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_load_si128(++vp), zero));
+        if (mask) {
+            len = done + __builtin_ctz(mask) / sizeof(wchar_t);
+            return len < n ? len : n;
+        }
+        done += VCHARS;
+    }
+    return n;
+}
+
+#endif /* WCSNLEN_SSE2 */
+
 size_t wcsnlen(const wchar_t *s, size_t n)
 {
-    const wchar_t *z = wmemchr(s, 0, n);
+    const wchar_t *z;
+
+#ifdef WCSNLEN_SSE2
+    if (MPLS_FASTPATH(sizeof(wchar_t) == 4
+                      && !((uintptr_t) s & (sizeof(wchar_t) - 1)))) {
+        return n ? wcsnlen_sse2(s, n) : 0;
+    }
+#endif
+    z = wmemchr(s, 0, n);
     if (z) n = z-s;
     return n;
 }
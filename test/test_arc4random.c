@@ -1,13 +1,15 @@
 /*
  * Simple test harness and benchmark for MT Arc4Random
  *
- * Note that this is almost entirely just a benchmark, and not an actual
- * test of the randomness of the result, which would be complicated.  The
- * only thing really being "tested" is that the function can be called.
+ * Note that this is mostly just a benchmark, and not an actual test of
+ * the randomness of the result, which would be complicated.  Beyond checking
+ * that the function can be called, there's only a crude sanity check of
+ * large requests: that they stay within bounds and look plausibly random.
  */
 #include <errno.h>
 #include <fcntl.h>
 #include <libgen.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -89,6 +91,284 @@ bench(int fd, size_t siz, size_t niter, int verbose)
     free(buf);
 }
 
+/*
+ * Sanity-check large (bulk-path) requests at an odd alignment and length.
+ * The guard bytes around the request must be untouched, and the byte
+ * histogram must be roughly flat (the bounds are many sigmas wide).
+ */
+#define BULKSIZE    (1024 * 1024 + 13)
+#define GUARDSIZE   64
+#define GUARDBYTE   0xA5
+
+static int
+check_bulk(int verbose)
+{
+    uint8_t *buf = malloc(BULKSIZE + 2 * GUARDSIZE);
+    uint8_t *req = buf + GUARDSIZE;
+    size_t counts[256] = {0};
+    size_t i, expect = BULKSIZE / 256;
+    int err = 0;
+
+    if (!buf) {
+        printf("  Unable to allocate bulk buffer\n");
+        return 1;
+    }
+    memset(buf, GUARDBYTE, BULKSIZE + 2 * GUARDSIZE);
+    arc4random_buf(req, BULKSIZE);
+
+    for (i = 0; i < GUARDSIZE; ++i) {
+        if (buf[i] != GUARDBYTE || req[BULKSIZE + i] != GUARDBYTE) {
+            printf("  Bulk request wrote outside its buffer\n");
+            err = 1;
+            break;
+        }
+    }
+    for (i = 0; i < BULKSIZE; ++i) ++counts[req[i]];
+    for (i = 0; i < 256; ++i) {
+        if (counts[i] < expect * 3 / 4 || counts[i] > expect * 5 / 4) {
+            printf("  Bulk byte value %d occurs %d times, expected ~%d\n",
+                   (int) i, (int) counts[i], (int) expect);
+            err = 1;
+            break;
+        }
+    }
+    if (verbose && !err) printf("  Bulk request check passed\n");
+
+    free(buf);
+    return err;
+}
+
+#if __MPLS_SDK_SUPPORT_ARC4RANDOM__
+
+#include <mach/mach.h>
+
+/*
+ * Check that per-thread states don't leak when threads exit.  Many
+ * short-lived threads each use arc4random, and the resident size after
+ * all of them must stay close to that after a warmup round.  A leak of
+ * the state would be over 1KB per thread, or several MB in total.
+ */
+#define RSS_BATCH     16
+#define RSS_ROUNDS    512
+#define RSS_MAXGROWTH (2 * 1024 * 1024)
+
+static long
+resident_size(void)
+{
+    struct task_basic_info info;
+    mach_msg_type_number_t count = TASK_BASIC_INFO_COUNT;
+
+    if (task_info(mach_task_self(), TASK_BASIC_INFO,
+                  (task_info_t) &info, &count) != KERN_SUCCESS) {
+        return -1;
+    }
+    return info.resident_size;
+}
+
+static void *
+rss_thread(void *arg)
+{
+    uint8_t buf[16];
+
+    (void) arg;
+    arc4random_buf(buf, sizeof(buf));
+    return NULL;
+}
+
+static int
+rss_round(void)
+{
+    pthread_t threads[RSS_BATCH];
+    int i;
+
+    for (i = 0; i < RSS_BATCH; ++i) {
+        if (pthread_create(&threads[i], NULL, rss_thread, NULL)) {
+            perror("  pthread_create");
+            return 1;
+        }
+    }
+    for (i = 0; i < RSS_BATCH; ++i) (void) pthread_join(threads[i], NULL);
+    return 0;
+}
+
+static int
+check_thread_rss(int verbose)
+{
+    long start, end;
+    int round;
+
+    if (rss_round()) return 1;
+    if ((start = resident_size()) < 0) {
+        printf("  Unable to get resident size\n");
+        return 1;
+    }
+    for (round = 0; round < RSS_ROUNDS; ++round) {
+        if (rss_round()) return 1;
+    }
+    end = resident_size();
+
+    if (end - start > RSS_MAXGROWTH) {
+        printf("  Resident size grew by %ld bytes over %d threads\n",
+               end - start, RSS_BATCH * RSS_ROUNDS);
+        return 1;
+    }
+    if (verbose) {
+        printf("  Resident size change over %d threads: %ld bytes\n",
+               RSS_BATCH * RSS_ROUNDS, end - start);
+    }
+    return 0;
+}
+
+/*
+ * Check that the per-thread counters track what was requested.
+ */
+static int
+check_stats(int verbose)
+{
+    struct arc4random_stats_np before, after;
+    uint8_t buf[64];
+    uint32_t val;
+    int err = 0;
+
+    arc4random_stats_np(&before);
+    arc4random_buf(buf, sizeof(buf));
+    val = arc4random_uniform(2); (void) val;
+    arc4random_stats_np(&after);
+
+    if (before.stirs < 1) {
+        printf("  Stir count is %llu, expected at least 1\n", before.stirs);
+        err = 1;
+    }
+    if (after.bytes - before.bytes < sizeof(buf) + sizeof(val)) {
+        printf("  Byte count advanced by %llu, expected at least %d\n",
+               after.bytes - before.bytes, (int) (sizeof(buf) + sizeof(val)));
+        err = 1;
+    }
+    if (after.rekeys < before.rekeys || after.stirs < before.stirs) {
+        printf("  Rekey or stir count went backwards\n");
+        err = 1;
+    }
+    if (verbose) {
+        printf("  Counters: %llu rekeys, %llu stirs, %llu bytes\n",
+               after.rekeys, after.stirs, after.bytes);
+    }
+    return err;
+}
+
+/*
+ * Check that a small reseed interval (set in main(), before first use) is
+ * honored by large (bulk) and medium (buffered) requests, rather than
+ * reseeding once and then never again.
+ */
+#define RESEED_BYTES  4096
+#define _s(x)         #x
+#define _xs(x)        _s(x)
+#define RESEED_BULK   (1024 * 1024)
+#define RESEED_MEDIUM 1000
+#define RESEED_NMED   200
+
+static int
+check_reseed(int verbose)
+{
+    struct arc4random_stats_np s0, s1, s2;
+    uint8_t *buf = malloc(RESEED_BULK);
+    unsigned long long stirs, minstirs;
+    int i, err = 0;
+
+    if (!buf) {
+        printf("  Unable to allocate reseed buffer\n");
+        return 1;
+    }
+
+    arc4random_stats_np(&s0);
+    arc4random_buf(buf, RESEED_BULK);
+    arc4random_stats_np(&s1);
+    for (i = 0; i < RESEED_NMED; ++i) arc4random_buf(buf, RESEED_MEDIUM);
+    arc4random_stats_np(&s2);
+
+    stirs = s1.stirs - s0.stirs;
+    minstirs = RESEED_BULK / RESEED_BYTES - 1;
+    if (stirs < minstirs || stirs > 2 * (minstirs + 1)) {
+        printf("  %d-byte request reseeded %llu times, expected ~%llu\n",
+               RESEED_BULK, stirs, minstirs + 1);
+        err = 1;
+    }
+    stirs = s2.stirs - s1.stirs;
+    minstirs = RESEED_NMED * RESEED_MEDIUM / RESEED_BYTES - 1;
+    if (stirs < minstirs || stirs > RESEED_NMED) {
+        printf("  %d %d-byte requests reseeded %llu times, expected ~%llu\n",
+               RESEED_NMED, RESEED_MEDIUM, stirs, minstirs + 1);
+        err = 1;
+    }
+    if (verbose) {
+        printf("  Reseeds every %d bytes: %llu bulk, %llu buffered\n",
+               RESEED_BYTES, s1.stirs - s0.stirs, s2.stirs - s1.stirs);
+    }
+
+    free(buf);
+    return err;
+}
+
+/*
+ * Check the batched uniform function: all values must be in range, and
+ * for a small bound the counts must be roughly equal (the bounds are many
+ * sigmas wide).
+ */
+#define UNIFORM_NUM   1000000
+#define UNIFORM_SMALL 10
+
+static int
+check_uniform_buf(int verbose)
+{
+    static const uint32_t bounds[] = {
+        0, 1, 2, 3, 7, UNIFORM_SMALL, 1000, 0x10000, 0x7FFFFFFF,
+        0x80000001U, 0xFFFFFFFEU, 0xFFFFFFFFU,
+    };
+    uint32_t *buf = malloc(UNIFORM_NUM * sizeof(*buf));
+    size_t counts[UNIFORM_SMALL] = {0};
+    size_t i, bi, expect = UNIFORM_NUM / UNIFORM_SMALL;
+    uint32_t bound;
+    int err = 0;
+
+    if (!buf) {
+        printf("  Unable to allocate uniform buffer\n");
+        return 1;
+    }
+
+    for (bi = 0; bi < sizeof(bounds) / sizeof(bounds[0]); ++bi) {
+        bound = bounds[bi];
+        for (i = 0; i < UNIFORM_NUM; ++i) buf[i] = 0xFFFFFFFFU;
+        arc4random_uniform_buf(bound, buf, UNIFORM_NUM);
+        for (i = 0; i < UNIFORM_NUM; ++i) {
+            if (bound < 2 ? buf[i] != 0 : buf[i] >= bound) {
+                printf("  arc4random_uniform_buf(%u) returned %u\n",
+                       bound, buf[i]);
+                err = 1;
+                break;
+            }
+            if (bound == UNIFORM_SMALL) ++counts[buf[i]];
+        }
+    }
+    for (i = 0; i < UNIFORM_SMALL; ++i) {
+        if (counts[i] < expect * 98 / 100 || counts[i] > expect * 102 / 100) {
+            printf("  Uniform value %d occurs %d times, expected ~%d\n",
+                   (int) i, (int) counts[i], (int) expect);
+            err = 1;
+            break;
+        }
+    }
+    /* Empty requests mustn't touch the buffer, even if it's NULL */
+    arc4random_uniform_buf(UNIFORM_SMALL, NULL, 0);
+    arc4random_uniform_buf(1, NULL, 0);
+    arc4random_uniform_buf(0, NULL, 0);
+    if (verbose && !err) printf("  Batched uniform check passed\n");
+
+    free(buf);
+    return err;
+}
+
+#endif /* __MPLS_SDK_SUPPORT_ARC4RANDOM__ */
+
 #define NITER       8192
 
 int
@@ -96,16 +376,21 @@ main(int argc, char *argv[])
 {
   int verbose = 0;
   char *progname = basename(argv[0]);
-  int i;
+  int i, err;
 
   if (argc > 1 && !strcmp(argv[1], "-v")) verbose = 1;
 
   if (verbose) printf("%s started\n", progname);
 
+#if __MPLS_SDK_SUPPORT_ARC4RANDOM__
+  /* The policy is read once, so this must precede any use */
+  setenv("MPLS_ARC4RANDOM_RESEED", _xs(RESEED_BYTES), 1);
+#endif
+
   int fd = open("/dev/urandom", O_RDONLY);
 
-  int args[]  = { 16, 32, 64, 256, 512 };
-  int nargs = 5;
+  int args[]  = { 16, 32, 64, 256, 512, 1024, 4096 };
+  int nargs = sizeof(args) / sizeof(args[0]);
 
   if (verbose) printf("  size,\t arc4rand,\t  sysrand,\tspeedup\n");
   for (i = 0; i < nargs; ++i) {
@@ -116,6 +401,14 @@ main(int argc, char *argv[])
 
   close(fd);
 
-  printf("%s completed.\n", progname);
-  return 0;
+  err = check_bulk(verbose);
+#if __MPLS_SDK_SUPPORT_ARC4RANDOM__
+  err |= check_thread_rss(verbose);
+  err |= check_stats(verbose);
+  err |= check_reseed(verbose);
+  err |= check_uniform_buf(verbose);
+#endif
+
+  printf("%s %s.\n", progname, err ? "failed" : "completed");
+  return err;
 }
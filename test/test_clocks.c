@@ -54,6 +54,7 @@
 #include <sys/param.h>
 #include <sys/sysctl.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 
 /*
  * To determine the number of samples we collect, we *very* generously
@@ -447,6 +448,268 @@ check_invalid(void)
   return ret;
 }
 
+#if __MPLS_SDK_SUPPORT_GETTIME__
+
+/* Clocks for the clock_sample_np() test (REALTIME must be first) */
+static const clockid_t sample_clocks[] = {
+  CLOCK_REALTIME, CLOCK_MONOTONIC, CLOCK_MONOTONIC_RAW, CLOCK_UPTIME_RAW,
+  CLOCK_PROCESS_CPUTIME_ID, CLOCK_THREAD_CPUTIME_ID,
+};
+#define NUM_SAMPLE_CLOCKS ((int) (sizeof(sample_clocks) \
+                                  / sizeof(sample_clocks[0])))
+
+/*
+ * Verify clock_sample_np(), by bracketing each of its samples with
+ * individual reads of the same clock.  CLOCK_REALTIME may be recalibrated
+ * between reads, so it gets some slack.  Since preemption can widen the
+ * window or the brackets, failures are retried.
+ */
+static int
+check_sample(int verbose)
+{
+  int i, ret, tries = MAX_RETRIES, bad;
+  sns_time_t before[NUM_SAMPLE_CLOCKS], after[NUM_SAMPLE_CLOCKS], slack;
+  uint64_t sample[NUM_SAMPLE_CLOCKS], window;
+  clockid_t badclocks[2] = {CLOCK_UPTIME_RAW, -1};
+  clockid_t badfirst[NUM_SAMPLE_CLOCKS];
+
+  badfirst[0] = -1;
+  for (i = 1; i < NUM_SAMPLE_CLOCKS; ++i) badfirst[i] = sample_clocks[i];
+
+  do {
+    bad = 0;
+    for (i = 0; i < NUM_SAMPLE_CLOCKS; ++i) {
+      before[i] = clock_gettime_nsec_np(sample_clocks[i]);
+    }
+    ret = clock_sample_np(NUM_SAMPLE_CLOCKS, sample_clocks, sample, &window);
+    for (i = NUM_SAMPLE_CLOCKS - 1; i >= 0; --i) {
+      after[i] = clock_gettime_nsec_np(sample_clocks[i]);
+    }
+    if (ret || window > MAX_STEP_NS) bad = -1;
+    for (i = 0; !bad && i < NUM_SAMPLE_CLOCKS; ++i) {
+      slack = sample_clocks[i] == CLOCK_REALTIME ? MAX_STEP_NS : 0;
+      if ((sns_time_t) sample[i] < before[i] - slack
+          || (sns_time_t) sample[i] > after[i] + slack) {
+        bad = i + 1;
+      }
+    }
+  } while (bad && --tries);
+
+  if (bad < 0) {
+    printf("  *** clock_sample_np() = %d, errno = %d (%s), window = %llu\n",
+           ret, errno, get_errstr(errno), ULL window);
+    return 1;
+  }
+  if (bad) {
+    printf("  *** clock_sample_np() clock %d = %lld, not in %lld-%lld\n",
+           sample_clocks[bad - 1], LL sample[bad - 1],
+           LL before[bad - 1], LL after[bad - 1]);
+    return 1;
+  }
+  if (verbose) {
+    printf("  clock_sample_np() of %d clocks has window %llu ns\n",
+           NUM_SAMPLE_CLOCKS, ULL window);
+  }
+
+  errno = -err_noerrno;
+  ret = clock_sample_np(2, badclocks, sample, NULL);
+  if (ret != -1 || errno != EINVAL || !sample[0] || sample[1]) {
+    printf("  *** clock_sample_np() with bad clock = %d, errno = %d (%s),"
+           " values %llu, %llu\n", ret, errno, get_errstr(errno),
+           ULL sample[0], ULL sample[1]);
+    return 1;
+  }
+
+  /* The error survives the reads of later (valid) clocks */
+  errno = -err_noerrno;
+  ret = clock_sample_np(NUM_SAMPLE_CLOCKS, badfirst, sample, &window);
+  if (ret != -1 || errno != EINVAL || sample[0]) {
+    printf("  *** clock_sample_np() with bad first clock = %d,"
+           " errno = %d (%s), value %llu\n", ret, errno, get_errstr(errno),
+           ULL sample[0]);
+    return 1;
+  }
+  for (i = 1; i < NUM_SAMPLE_CLOCKS; ++i) {
+    if (!sample[i]) {
+      printf("  *** clock_sample_np() with bad first clock: clock %d = 0\n",
+             badfirst[i]);
+      return 1;
+    }
+  }
+
+  /* Bad arguments */
+  errno = -err_noerrno;
+  ret = clock_sample_np(-1, sample_clocks, sample, NULL);
+  if (ret != -1 || errno != EINVAL) {
+    printf("  *** clock_sample_np() with count -1 = %d, errno = %d (%s)\n",
+           ret, errno, get_errstr(errno));
+    return 1;
+  }
+  errno = -err_noerrno;
+  ret = clock_sample_np(1, NULL, sample, NULL);
+  if (ret != -1 || errno != EINVAL) {
+    printf("  *** clock_sample_np() with no clocks = %d, errno = %d (%s)\n",
+           ret, errno, get_errstr(errno));
+    return 1;
+  }
+
+  /* Success leaves errno alone */
+  errno = -err_noerrno;
+  ret = clock_sample_np(NUM_SAMPLE_CLOCKS, sample_clocks, sample, NULL);
+  if (ret || errno != -err_noerrno) {
+    printf("  *** clock_sample_np() = %d, changed errno to %d (%s)\n",
+           ret, errno, get_errstr(errno));
+    return 1;
+  }
+  return 0;
+}
+
+#define COARSE_TICK_MS         1  /* Coarse clock tick for test (ms) */
+#define COARSE_RUN_US      20000  /* Time to watch coarse clocks (us) */
+#define COARSE_MAX_LAG  50000000  /* Maximum coarse clock lag (ns) */
+#define COARSE_FORKS         200  /* Forks while the helper is ticking */
+#define COARSE_FORK_SECS       5  /* Time limit for a forked child (s) */
+
+/* Check one pair of coarse clock reads against the precise clocks */
+static int
+check_coarse_reads(const char *mode, ns_time_t *lastmono, int verbose)
+{
+  ns_time_t rt, mono, prt, pmono;
+
+  rt = clock_gettime_nsec_np(CLOCK_REALTIME_COARSE);
+  mono = clock_gettime_nsec_np(CLOCK_MONOTONIC_COARSE);
+  prt = clock_gettime_nsec_np(CLOCK_REALTIME);
+  pmono = clock_gettime_nsec_np(CLOCK_MONOTONIC);
+
+  if (!rt || !mono || mono < *lastmono
+      || rt > prt + MAX_STEP_NS || rt + COARSE_MAX_LAG < prt
+      || mono > pmono + MAX_STEP_NS || mono + COARSE_MAX_LAG < pmono) {
+    printf("  *** Coarse clocks (%s) = %llu, %llu (last %llu),"
+           " precise %llu, %llu\n", mode, ULL rt, ULL mono, ULL *lastmono,
+           ULL prt, ULL pmono);
+    return 1;
+  }
+  if (verbose > 1) {
+    printf("  Coarse clocks (%s) lag by %lld, %lld ns\n",
+           mode, LL (prt - rt), LL (pmono - mono));
+  }
+  *lastmono = mono;
+  return 0;
+}
+
+/* Child side of the fork check, returning the exit status */
+static int
+coarse_fork_child(void)
+{
+  timespec_t res, rawres;
+
+  (void) alarm(COARSE_FORK_SECS);
+
+  /* No helper thread here, so the precise clock's resolution */
+  if (clock_getres(CLOCK_MONOTONIC_COARSE, &res)
+      || clock_getres(CLOCK_MONOTONIC_RAW, &rawres)
+      || res.tv_sec != rawres.tv_sec || res.tv_nsec != rawres.tv_nsec) {
+    return 2;
+  }
+  if (clock_coarse_start_np(COARSE_TICK_MS)) return 3;
+  if (clock_coarse_start_np(0)) return 4;
+  return 0;
+}
+
+/*
+ * Fork repeatedly while the helper thread is ticking, to check that a child
+ * never inherits the helper's lock or running state.  A child that gets
+ * stuck is killed by its alarm.
+ */
+static int
+check_coarse_fork(int verbose)
+{
+  int i, status;
+  pid_t pid;
+
+  for (i = 0; i < COARSE_FORKS; ++i) {
+    if ((pid = fork()) < 0) {
+      printf("  *** fork() failed: %s\n", get_errstr(errno));
+      return 1;
+    }
+    if (!pid) _exit(coarse_fork_child());
+    if (waitpid(pid, &status, 0) != pid) {
+      printf("  *** waitpid() failed: %s\n", get_errstr(errno));
+      return 1;
+    }
+    if (WIFSIGNALED(status)) {
+      printf("  *** Forked child %s with coarse clocks running\n",
+             WTERMSIG(status) == SIGALRM ? "deadlocked" : "crashed");
+      return 1;
+    }
+    if (WEXITSTATUS(status)) {
+      printf("  *** Forked child failed step %d with coarse clocks running\n",
+             WEXITSTATUS(status));
+      return 1;
+    }
+  }
+  if (verbose) printf("  Forked %d children with coarse clocks running\n", i);
+  return 0;
+}
+
+/*
+ * Verify the coarse clocks, both read directly and with the helper thread,
+ * and verify that the helper thread is reflected in the resolution.
+ */
+static int
+check_coarse(int verbose)
+{
+  int err = 0, changes = 0;
+  ns_time_t lastmono = 0, startmono;
+  mach_time_t end;
+  timespec_t res;
+
+  err |= check_coarse_reads("direct", &lastmono, verbose);
+
+  errno = -err_noerrno;
+  if (clock_coarse_start_np(100000) != -1 || errno != EINVAL) {
+    printf("  *** clock_coarse_start_np(100000) didn't fail with EINVAL\n");
+    err = 1;
+  }
+  if (clock_coarse_start_np(COARSE_TICK_MS)) {
+    printf("  *** clock_coarse_start_np(%d) failed: %s\n",
+           COARSE_TICK_MS, get_errstr(errno));
+    return 1;
+  }
+  if (clock_getres(CLOCK_MONOTONIC_COARSE, &res)
+      || res.tv_sec || res.tv_nsec != COARSE_TICK_MS * 1000000L) {
+    printf("  *** Coarse clock resolution is %lld.%09ld, not %d ms\n",
+           LL res.tv_sec, (long) res.tv_nsec, COARSE_TICK_MS);
+    err = 1;
+  }
+
+  startmono = lastmono;
+  end = mach_absolute_time() + (mach_time_t) (COARSE_RUN_US / mach2usecs);
+  while (!err && mach_absolute_time() < end) {
+    err |= check_coarse_reads("ticking", &lastmono, 0);
+    if (lastmono != startmono) {
+      ++changes;
+      startmono = lastmono;
+    }
+  }
+  if (!err && !changes) {
+    printf("  *** Coarse clocks didn't advance in %d us\n", COARSE_RUN_US);
+    err = 1;
+  }
+  if (verbose) printf("  Coarse clocks advanced %d times\n", changes);
+
+  if (!err) err |= check_coarse_fork(verbose);
+
+  if (clock_coarse_start_np(0)) {
+    printf("  *** clock_coarse_start_np(0) failed: %s\n", get_errstr(errno));
+    return 1;
+  }
+  err |= check_coarse_reads("stopped", &lastmono, verbose);
+  return err;
+}
+
+#endif /* __MPLS_SDK_SUPPORT_GETTIME__ */
+
 /* Conversions from different time formats to nanoseconds */
 
 static ns_time_t
@@ -2185,6 +2448,11 @@ main(int argc, char *argv[])
 
   err |= check_invalid();
 
+#if __MPLS_SDK_SUPPORT_GETTIME__
+  err |= check_sample(verbose && !quiet);
+  err |= check_coarse(quiet ? 0 : verbose);
+#endif
+
   err |= check_boottime(verbose && !quiet);
 
   get_sleepofs(&lastsleep);
@@ -15,19 +15,29 @@
  */
 
 /*
- * This provides functional tests for dprintf and vdprintf, including
- * *not* closing the provided fd.
+ * This provides functional tests for dprintf and vdprintf, and the
+ * dprintf_atomic extension, including *not* closing the provided fd.
  */
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 
 #define BUF_SIZE 256
+#define LONG_SIZE 8192  /* Must fit in the pipe buffer */
+
+#define ATOMIC_CHILDREN 4
+#define ATOMIC_LINES    500
+
+#define NOMEM_SIZE (256 << 20)  /* Output size for the out-of-memory test */
 
 #define TEST_ARGS "%s output is %d\n", name, 42
 
@@ -81,6 +91,159 @@ test_vdprintf(int fd, const char * __restrict format, ...)
   return ret;
 }
 
+/* Test output longer than the local buffer, in one piece */
+static void
+test_long(int pipes[], int verbose)
+{
+  static char expbuf[LONG_SIZE], actbuf[LONG_SIZE];
+  int ret, explen, len;
+  ssize_t actlen;
+
+  if (verbose) {
+    printf("Testing long output...\n");
+    fflush(stdout);
+  }
+
+  for (len = 1; len < LONG_SIZE - 8; len = len * 3 + 1) {
+    explen = snprintf(expbuf, sizeof(expbuf), "%*d|\n", len, len);
+    assert(explen == len + 2 && "snprintf failed creating expected");
+
+    errno = 0;
+    ret = dprintf(pipes[1], "%*d|\n", len, len);
+    assert(ret == explen && "Bad return value with long output");
+    assert(errno == 0 && "Bad errno with long output");
+
+    actlen = 0;
+    while (actlen < explen) {
+      ssize_t n = read(pipes[0], actbuf + actlen, sizeof(actbuf) - actlen);
+      assert(n > 0 && "Read from pipe failed");
+      actlen += n;
+    }
+    assert(actlen == explen && "Incorrect length read from pipe");
+    assert(!memcmp(actbuf, expbuf, explen) && "Long result doesn't match");
+  }
+}
+
+#if __MPLS_SDK_SUPPORT_DPRINTF__
+
+int
+test_vdprintf_atomic(int fd, const char * __restrict format, ...)
+{
+  va_list args;
+
+  va_start(args, format);
+  int ret = vdprintf_atomic(fd, format, args);
+  va_end(args);
+  return ret;
+}
+
+/*
+ * Test that concurrent dprintf_atomic() lines of up to PIPE_BUF bytes
+ * from several processes arrive intact.
+ */
+static void
+test_atomic_pipe(int verbose)
+{
+  int pipes[2], child, line, status, len, i;
+  int counts[ATOMIC_CHILDREN] = {0};
+  char buf[PIPE_BUF + 1], *cp;
+  FILE *in;
+  pid_t pid;
+
+  if (verbose) {
+    printf("Testing dprintf_atomic with %d writers...\n", ATOMIC_CHILDREN);
+    fflush(stdout);
+  }
+
+  assert(!pipe(pipes) && "Unable to create pipe");
+  for (child = 0; child < ATOMIC_CHILDREN; ++child) {
+    pid = fork();
+    assert(pid >= 0 && "fork failed");
+    if (pid == 0) {
+      (void) close(pipes[0]);
+      for (line = 0; line < ATOMIC_LINES; ++line) {
+        /* Lines of PIPE_BUF bytes, including the child letter and newline */
+        len = PIPE_BUF - 2;
+        if (dprintf_atomic(pipes[1], "%c%.*d\n", 'a' + child, len, 0)
+            != PIPE_BUF) {
+          _exit(1);
+        }
+      }
+      _exit(0);
+    }
+  }
+  (void) close(pipes[1]);
+
+  in = fdopen(pipes[0], "r");
+  assert(in && "fdopen failed");
+  while (fgets(buf, sizeof(buf), in)) {
+    len = strlen(buf);
+    assert(len == PIPE_BUF && "Interleaved or short line");
+    assert(buf[0] >= 'a' && buf[0] < 'a' + ATOMIC_CHILDREN && "Bad line");
+    for (cp = buf + 1, i = 0; i < PIPE_BUF - 2; ++i, ++cp) {
+      assert(*cp == '0' && "Interleaved line");
+    }
+    ++counts[buf[0] - 'a'];
+  }
+  (void) fclose(in);
+
+  for (child = 0; child < ATOMIC_CHILDREN; ++child) {
+    assert(wait(&status) > 0 && WIFEXITED(status) && !WEXITSTATUS(status)
+           && "Writer failed");
+    assert(counts[child] == ATOMIC_LINES && "Missing lines");
+  }
+}
+
+/*
+ * Test that dprintf_atomic() writes nothing, and fails with ENOMEM, when
+ * its buffer can't be allocated, rather than falling back to piecemeal
+ * output as dprintf() does.  This runs in a child with a reduced memory
+ * limit, and is skipped if the limit doesn't make a large malloc() fail.
+ */
+static void
+test_atomic_nomem(int verbose)
+{
+  int pipes[2], status, ret;
+  struct rlimit rl;
+  char buf[BUF_SIZE];
+  void *mem;
+  pid_t pid;
+
+  if (verbose) {
+    printf("Testing dprintf_atomic without memory...\n");
+    fflush(stdout);
+  }
+
+  assert(!pipe(pipes) && "Unable to create pipe");
+  pid = fork();
+  assert(pid >= 0 && "fork failed");
+  if (pid == 0) {
+    (void) close(pipes[0]);
+    rl.rlim_cur = rl.rlim_max = NOMEM_SIZE;
+    (void) setrlimit(RLIMIT_AS, &rl);
+    (void) setrlimit(RLIMIT_DATA, &rl);
+    if ((mem = malloc(NOMEM_SIZE)) != NULL) {
+      free(mem);
+      _exit(2);
+    }
+    errno = 0;
+    ret = dprintf_atomic(pipes[1], "%*d", NOMEM_SIZE - 1, 0);
+    _exit(ret != -1 || errno != ENOMEM);
+  }
+  (void) close(pipes[1]);
+
+  assert(read(pipes[0], buf, sizeof(buf)) == 0 && "Output without memory");
+  (void) close(pipes[0]);
+  assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status)
+         && "Child failed");
+  assert(WEXITSTATUS(status) != 1 && "Bad result without memory");
+  if (verbose && WEXITSTATUS(status) == 2) {
+    printf("  (skipped - memory limit not enforced)\n");
+  }
+}
+
+#endif /* __MPLS_SDK_SUPPORT_DPRINTF__ */
+
 int
 main(int argc, const char *argv[]) {
   int verbose = 0, pipes[2];
@@ -94,6 +257,11 @@ main(int argc, const char *argv[]) {
 
   test_xdprintf("dprintf", dprintf, pipes, verbose);
   test_xdprintf("vdprintf", test_vdprintf, pipes, verbose);
+  test_long(pipes, verbose);
+#if __MPLS_SDK_SUPPORT_DPRINTF__
+  test_xdprintf("dprintf_atomic", dprintf_atomic, pipes, verbose);
+  test_xdprintf("vdprintf_atomic", test_vdprintf_atomic, pipes, verbose);
+#endif
 
   if (close(pipes[1])) {
     perror("Unable to close write pipe");
@@ -104,6 +272,11 @@ main(int argc, const char *argv[]) {
     return 1;
   }
 
+#if __MPLS_SDK_SUPPORT_DPRINTF__
+  test_atomic_pipe(verbose);
+  test_atomic_nomem(verbose);
+#endif
+
   printf("dprintf/vdprintf test succeeded\n");
   return 0;
 }
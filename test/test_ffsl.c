@@ -20,43 +20,97 @@
 #include <string.h>
 #include <strings.h>
 
-int
-main(int argc, char *argv[])
+#define RAND_MASKS 100000
+
+static int verbose = 0;
+static int errors = 0;
+
+/* Deterministic generator, so failures are reproducible */
+static unsigned long long rand_state = 1;
+
+static unsigned long long
+next_rand(void)
 {
-  int ret = 0, verbose = 0;
-  const int offset = 4;
+  rand_state = rand_state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return rand_state;
+}
 
-  if (argc > 1 && !strcmp(argv[1], "-v")) verbose = 1;
+/* Random mask with a random number of low (or high) bits cleared */
+static unsigned long long
+rand_mask(void)
+{
+  unsigned long long mask = next_rand() ^ (next_rand() >> 32);
+  int shift = (int) (next_rand() >> 58);
 
-  /* FIXME: Actually check the results for correctness */
+  return (next_rand() & 1) ? mask << shift : mask >> shift;
+}
 
-  if (verbose) printf( "testing ffsl :-\n" );
-  for ( int i = 0; i <= 8*sizeof(int)-offset; i+=offset ) {
-    const int ii = i+offset;
-    long int test = ( i>0  ? 1UL << (i-1)  : 0 );
-    test |=         ( ii>0 ? 1UL << (ii-1) : 0 );
-    const int j = ffs(test);
-    if (verbose) printf( "  Set bits %i,%i - Found bit %i\n", i, ii, j );
+static void
+report(const char *name, const char *how, unsigned long long mask,
+       int got, int expected)
+{
+  if (got == expected) return;
+  if (verbose || errors < 10) {
+    printf("  %s (%s) of 0x%llX returned %d, expected %d\n",
+           name, how, mask, got, expected);
   }
+  ++errors;
+}
 
-  if (verbose) printf( "testing ffsl :-\n" );
-  for ( int i = 0; i <= 8*sizeof(long int)-offset; i+=offset ) {
-    const int ii = i+offset;
-    long int test = ( i>0  ? 1UL << (i-1)  : 0 );
-    test |=         ( ii>0 ? 1UL << (ii-1) : 0 );
-    const int j = ffsl(test);
-    if (verbose) printf( "  Set bits %i,%i - Found bit %i\n", i, ii, j );
-  }
+/* Reference versions, one bit at a time */
+static int
+ref_ffs(unsigned long long mask, int bits)
+{
+  int bit;
 
-  if (verbose) printf( "testing ffsll :-\n" );
-  for ( int i = 0; i <= 8*sizeof(long long int)-offset; i+=offset ) {
-    const int ii = i+offset;
-    long long int test = ( i>0  ? 1UL << (i-1)  : 0 );
-    test |=              ( ii>0 ? 1UL << (ii-1) : 0 );
-    const int j = ffsll(test);
-    if (verbose) printf( "  Set bits %i,%i - Found bit %i\n", i, ii, j );
+  for (bit = 0; bit < bits; ++bit) {
+    if (mask & (1ULL << bit)) return bit + 1;
   }
-  
-  printf("%s %s.\n", basename(argv[0]), ret ? "failed" : "succeeded");
-  return ret;
+  return 0;
+}
+
+/*
+ * Each function is tested both with a direct call, which may use the inline
+ * version from strings.h, and via a function pointer, which uses the library
+ * (or OS) version.
+ */
+
+#define CHECK_FFS(func, type, utype, mask) \
+  do { \
+    int (* volatile fp)(type) = &func; \
+    type m = (type) (utype) (mask); \
+    int exp = ref_ffs((utype) m, (int) sizeof(type) * 8); \
+    report(#func, "direct", (utype) m, func(m), exp); \
+    report(#func, "pointer", (utype) m, (*fp)(m), exp); \
+  } while (0)
+
+#define TEST_FFS(func, type, utype) \
+  do { \
+    const int bits = (int) sizeof(type) * 8; \
+    if (verbose) printf("testing " #func " :-\n"); \
+    CHECK_FFS(func, type, utype, 0); \
+    CHECK_FFS(func, type, utype, ~(utype) 0); \
+    for (int i = 0; i < bits; ++i) { \
+      CHECK_FFS(func, type, utype, (utype) 1 << i); \
+      CHECK_FFS(func, type, utype, ~(utype) 0 << i); \
+      CHECK_FFS(func, type, utype, \
+                ((utype) 1 << i) | ((utype) 1 << (bits - 1))); \
+    } \
+    for (int i = 0; i < RAND_MASKS; ++i) { \
+      CHECK_FFS(func, type, utype, rand_mask()); \
+    } \
+    if (verbose) printf("  %d errors so far\n", errors); \
+  } while (0)
+
+int
+main(int argc, char *argv[])
+{
+  if (argc > 1 && !strcmp(argv[1], "-v")) verbose = 1;
+
+  TEST_FFS(ffs, int, unsigned int);
+  TEST_FFS(ffsl, long int, unsigned long);
+  TEST_FFS(ffsll, long long int, unsigned long long);
+
+  printf("%s %s.\n", basename(argv[0]), errors ? "failed" : "succeeded");
+  return errors ? 1 : 0;
 }
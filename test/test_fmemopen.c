@@ -33,6 +33,7 @@ SUCH DAMAGE.
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 
@@ -238,6 +239,10 @@ test_binary()
     nofw = fwrite(str, 1, strlen(str), fp);
     assert(nofw == strlen(str));
 
+    /* Writes are buffered, so make sure the data has reached the buffer. */
+    rc = fflush(fp);
+    assert(rc == 0);
+
     /* Make sure that the buffer doesn't contain any NULL bytes. */
     for (i = 0; i < sizeof(buf); i++)
         assert(buf[i] != '\0');
@@ -285,6 +290,191 @@ test_size_0()
     assert(errno == EINVAL);
 }
 
+void
+test_read_buffered()
+{
+    /*
+     * Read-only streams are buffered, so check reads from all positions,
+     * both by character and in blocks, and that writes are rejected.
+     */
+
+    char buf[3000];
+    char buf2[sizeof(buf)];
+    FILE *fp;
+    size_t nofr, i;
+    int rc, c;
+
+    for (i = 0; i < sizeof(buf); i++)
+        buf[i] = i * 7 + i / 251;
+
+    fp = fmemopen(buf, sizeof(buf), "r");
+    assert(fp != NULL);
+
+    /* Read it all by character. */
+    for (i = 0; i < sizeof(buf); i++) {
+        c = fgetc(fp);
+        assert(c == (unsigned char) buf[i]);
+    }
+    assert(fgetc(fp) == EOF);
+    assert(feof(fp));
+
+    /* Read blocks from various positions. */
+    for (i = 0; i < sizeof(buf); i += 997) {
+        rc = fseek(fp, i, SEEK_SET);
+        assert(rc == 0);
+        assert(ftell(fp) == (long) i);
+        nofr = fread(buf2, 1, sizeof(buf2), fp);
+        assert(nofr == sizeof(buf) - i);
+        assert(memcmp(buf2, buf + i, nofr) == 0);
+    }
+
+    /* Read relative to the end. */
+    rc = fseek(fp, -10, SEEK_END);
+    assert(rc == 0);
+    nofr = fread(buf2, 1, sizeof(buf2), fp);
+    assert(nofr == 10);
+    assert(memcmp(buf2, buf + sizeof(buf) - 10, 10) == 0);
+
+    /* Writes must fail, and leave the buffer alone. */
+    rc = fseek(fp, 0, SEEK_SET);
+    assert(rc == 0);
+    assert(fputc('x', fp) == EOF || fflush(fp) == EOF);
+    assert(buf[0] == 0);
+
+    rc = fclose(fp);
+    assert(rc == 0);
+}
+
+void
+test_write_buffered()
+{
+    /*
+     * With buffered writes, an overrun must be reported when the data
+     * is flushed, with the region filled and nothing beyond it touched.
+     */
+
+    char buf[16];
+    char str[] = "0123456789abcdefghij";
+    FILE *fp;
+    int rc;
+
+    memset(buf, 'A', sizeof(buf));
+    fp = fmemopen(buf, 10, "w");
+    assert(fp != NULL);
+    rc = setvbuf(fp, NULL, _IOFBF, BUFSIZ);
+    assert(rc == 0);
+
+    /* This fits. */
+    rc = fprintf(fp, "%.5s", str);
+    assert(rc == 5);
+    rc = fflush(fp);
+    assert(rc == 0);
+    assert(memcmp(buf, str, 5) == 0 && buf[5] == '\0');
+
+    /* This doesn't, and fails at the latest when flushed. */
+    rc = fprintf(fp, "%s", str + 5);
+    if (rc >= 0) {
+        rc = fflush(fp);
+        assert(rc == EOF);
+        assert(errno == ENOSPC);
+    }
+    assert(ferror(fp));
+    assert(memcmp(buf, str, 10) == 0);
+    assert(memcmp(buf + 10, "AAAAAA", 6) == 0);
+
+    fclose(fp);
+}
+
+void
+test_write_counts()
+{
+    /*
+     * Writable streams are buffered, but must still return exact short
+     * counts, so compare random sequences of writes and seeks against a
+     * simple model of the region.  Sizes span the stdio buffer size.
+     */
+
+    static const size_t sizes[] = {1, 2, 7, 64, 1000, 1500, 5000};
+    static const char digits[] = "0123456789012345678901234567890123456789";
+    char buf[5000 + 16];
+    char model[5000];
+    char data[2 * 5000];
+    FILE *fp;
+    size_t si, size, pos, len, room, k, exp;
+    long off;
+    int op, i, rc;
+
+    srandom(1);
+    for (k = 0; k < sizeof(data); k++)
+        data[k] = random();
+
+    for (si = 0; si < sizeof(sizes) / sizeof(sizes[0]); si++) {
+        size = sizes[si];
+        memset(buf, 'A', sizeof(buf));
+        memset(model, 'A', size);
+        model[0] = '\0';
+        pos = len = 0;
+
+        fp = fmemopen(buf, size, "w+b");
+        assert(fp != NULL);
+
+        for (i = 0; i < 2000; i++) {
+            room = size - pos;
+            op = random() % 8;
+            switch (op) {
+            case 0: case 1: case 2:
+                k = random() % (size * 2 + 1);
+                exp = k < room ? k : room;
+                assert(fwrite(data + (i % size), 1, k, fp) == exp);
+                break;
+            case 3:
+                if (!room)
+                    continue;
+                k = 1;
+                exp = 1;
+                assert(fputc(data[i % size], fp) == (unsigned char) data[i % size]);
+                break;
+            case 4:
+                k = random() % 40;
+                exp = k < room ? k : room;
+                rc = fprintf(fp, "%.*s", (int) k, digits);
+                assert(k <= room ? rc == (int) k : rc < 0);
+                break;
+            case 5:
+                off = random() % (size + 1);
+                assert(fseek(fp, off, SEEK_SET) == 0);
+                pos = off;
+                continue;
+            case 6:
+                off = -(long) (random() % (len + 1));
+                assert(fseek(fp, off, SEEK_END) == 0);
+                pos = len + off;
+                continue;
+            default:
+                assert(ftell(fp) == (long) pos);
+                assert(fflush(fp) == 0);
+                assert(memcmp(buf, model, size) == 0);
+                continue;
+            }
+
+            /* Apply the write to the model. */
+            memcpy(model + pos, op == 4 ? digits : data + (i % size), exp);
+            pos += exp;
+            if (pos > len)
+                len = pos;
+            if (exp < k) {
+                assert(ferror(fp));
+                clearerr(fp);
+            }
+        }
+
+        rc = fclose(fp);
+        assert(rc == 0);
+        assert(memcmp(buf, model, size) == 0);
+        assert(memcmp(buf + size, "AAAAAAAAAAAAAAAA", 16) == 0);
+    }
+}
+
 int
 main(void)
 {
@@ -294,5 +484,8 @@ main(void)
     test_binary();
     test_append_binary_pos();
     test_size_0();
+    test_read_buffered();
+    test_write_buffered();
+    test_write_counts();
     return (0);
 }
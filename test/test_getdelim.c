@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Tests for getline() and getdelim().
+ *
+ * This writes a file of "lines" with a variety of lengths (including empty
+ * lines and lines much longer than the stdio buffer), with contents that
+ * include NULs and high-bit bytes, and an unterminated last line.  It then
+ * reads it back with getdelim() and checks every line, for several
+ * delimiters, with the stream fully buffered, unbuffered, and with a small
+ * buffer, and with ungetc() data in the middle.  It also does the same via
+ * fmemopen(), which isn't an ordinary file stream.
+ *
+ * Where available, the getdelim_view() extension gets the same checks.
+ */
+
+#include <errno.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#define NUM_LINES    400
+#define LONG_LINE    (64 * 1024)
+
+static int verbose = 0;
+static int errors = 0;
+
+static unsigned char *data;
+static size_t data_len;
+static size_t line_lens[NUM_LINES];
+
+/* Deterministic generator, so failures are reproducible */
+static unsigned long rand_state = 1;
+
+static unsigned long
+next_rand(void)
+{
+  rand_state = rand_state * 1103515245UL + 12345UL;
+  return (rand_state >> 16) & 0x7FFF;
+}
+
+static size_t
+pick_len(int i)
+{
+  switch (i % 8) {
+  case 0: return 0;
+  case 1: return 1;
+  case 2: return next_rand() % 100;
+  case 3: return BUFSIZ - 2 + next_rand() % 4;
+  case 4: return next_rand() % (BUFSIZ * 3);
+  case 5: return (i % 40 == 5) ? LONG_LINE + next_rand() % 1000 : 10;
+  default: return next_rand() % 1000;
+  }
+}
+
+/*
+ * Build the data for the given delimiter.  Each line body avoids the
+ * delimiter, and all lines but the last are terminated with it.
+ */
+static void
+build_data(int delim)
+{
+  size_t total = 0, pos = 0, j;
+  unsigned char c;
+  int i;
+
+  rand_state = 1;
+  for (i = 0; i < NUM_LINES; ++i) {
+    line_lens[i] = pick_len(i);
+    total += line_lens[i] + 1;
+  }
+  free(data);
+  if (!(data = malloc(total))) {
+    perror("malloc");
+    exit(1);
+  }
+  for (i = 0; i < NUM_LINES; ++i) {
+    for (j = 0; j < line_lens[i]; ++j) {
+      do {
+        c = next_rand() & 0xFF;
+      } while (c == delim);
+      data[pos++] = c;
+    }
+    if (i < NUM_LINES - 1) data[pos++] = delim;
+  }
+  data_len = pos;
+}
+
+static FILE *
+make_file(int mode, char *iobuf)
+{
+  FILE *fp;
+
+  if (mode == 3) {
+    if (!(fp = fmemopen(data, data_len, "r"))) {
+      perror("fmemopen");
+      exit(1);
+    }
+    return fp;
+  }
+  if (!(fp = tmpfile())) {
+    perror("tmpfile");
+    exit(1);
+  }
+  if (fwrite(data, 1, data_len, fp) != data_len || fflush(fp)) {
+    perror("fwrite");
+    exit(1);
+  }
+  rewind(fp);
+  switch (mode) {
+  case 1: (void) setvbuf(fp, NULL, _IONBF, 0); break;
+  case 2: (void) setvbuf(fp, iobuf, _IOFBF, 7); break;
+  }
+  return fp;
+}
+
+static const char *mode_names[] = {
+  "buffered", "unbuffered", "small buffer", "fmemopen",
+};
+
+static int use_view = 0;
+
+static void
+fail(int delim, int mode, int line, const char *msg)
+{
+  if (verbose || errors < 10) {
+    printf("  %s, delim 0x%02X, %s, line %d: %s\n",
+           use_view ? "getdelim_view" : "getdelim",
+           delim, mode_names[mode], line, msg);
+  }
+  ++errors;
+}
+
+#if __MPLS_SDK_SUPPORT_GETLINE__
+/* Check one line from getdelim_view() */
+static int
+check_view(FILE *fp, int delim, int mode, int i, size_t pos, size_t expect)
+{
+  const char *start;
+  size_t len;
+
+  if (getdelim_view(fp, delim, &start, &len) || len != expect) {
+    fail(delim, mode, i, "wrong length");
+    return 1;
+  }
+  if (memcmp(start, data + pos, expect)) {
+    fail(delim, mode, i, "wrong contents");
+  }
+  return 0;
+}
+#endif
+
+static void
+check_read(int delim, int mode)
+{
+  char iobuf[8], *line = NULL;
+  size_t linecap = 0, pos = 0, expect;
+  ssize_t got;
+  FILE *fp = make_file(mode, iobuf);
+  int i, c;
+#if __MPLS_SDK_SUPPORT_GETLINE__
+  const char *start;
+  size_t len;
+#endif
+
+  for (i = 0; i < NUM_LINES; ++i) {
+    /* Occasionally push back the first character of the line */
+    if (i % 7 == 3 && line_lens[i] > 0) {
+      if ((c = getc(fp)) != data[pos] || ungetc(c, fp) != c) {
+        fail(delim, mode, i, "getc/ungetc failed");
+      }
+    }
+
+    expect = line_lens[i] + (i < NUM_LINES - 1);
+#if __MPLS_SDK_SUPPORT_GETLINE__
+    if (use_view) {
+      if (check_view(fp, delim, mode, i, pos, expect)) break;
+      pos += expect;
+      continue;
+    }
+#endif
+    got = (delim == '\n') ? getline(&line, &linecap, fp)
+                          : getdelim(&line, &linecap, delim, fp);
+    if (got < 0 || (size_t) got != expect) {
+      fail(delim, mode, i, "wrong length");
+      break;
+    }
+    if (memcmp(line, data + pos, expect) || line[expect] != '\0') {
+      fail(delim, mode, i, "wrong contents");
+    }
+    if (linecap <= (size_t) got) fail(delim, mode, i, "bad capacity");
+    pos += expect;
+  }
+
+#if __MPLS_SDK_SUPPORT_GETLINE__
+  if (use_view) {
+    if (getdelim_view(fp, delim, &start, &len) != -1 || !feof(fp)) {
+      fail(delim, mode, i, "missing EOF");
+    }
+    (void) fclose(fp);
+    return;
+  }
+#endif
+  errno = 0;
+  if (getdelim(&line, &linecap, delim, fp) != -1 || !feof(fp)) {
+    fail(delim, mode, i, "missing EOF");
+  }
+  if (line[0] != '\0') fail(delim, mode, i, "EOF result not empty");
+
+  free(line);
+  (void) fclose(fp);
+}
+
+static void
+check_args(void)
+{
+  FILE *fp;
+  char *line = NULL;
+  size_t linecap = 0;
+
+  if (!(fp = tmpfile())) {
+    perror("tmpfile");
+    exit(1);
+  }
+  errno = 0;
+  if (getdelim(NULL, &linecap, '\n', fp) != -1 || errno != EINVAL) {
+    fail('\n', 0, 0, "NULL line pointer not rejected");
+  }
+  errno = 0;
+  if (getdelim(&line, NULL, '\n', fp) != -1 || errno != EINVAL) {
+    fail('\n', 0, 0, "NULL capacity pointer not rejected");
+  }
+  /* Empty file */
+  if (getline(&line, &linecap, fp) != -1 || !line || linecap == 0) {
+    fail('\n', 0, 0, "empty file mishandled");
+  }
+  free(line);
+  (void) fclose(fp);
+}
+
+int
+main(int argc, char *argv[])
+{
+  static const int delims[] = { '\n', '\0', 0xFF, 'x' };
+  int di, mode;
+
+  if (argc > 1 && !strcmp(argv[1], "-v")) verbose = 1;
+
+  check_args();
+  for (di = 0; di < (int) (sizeof(delims) / sizeof(delims[0])); ++di) {
+    build_data(delims[di]);
+    for (mode = 0; mode < 4; ++mode) {
+      use_view = 0;
+      check_read(delims[di], mode);
+#if __MPLS_SDK_SUPPORT_GETLINE__
+      use_view = 1;
+      check_read(delims[di], mode);
+#endif
+      if (verbose) {
+        printf("  delim 0x%02X, %s: %d errors so far\n",
+               delims[di], mode_names[mode], errors);
+      }
+    }
+  }
+  free(data);
+
+  printf("%s %s.\n", basename(argv[0]), errors ? "failed" : "succeeded");
+  return errors ? 1 : 0;
+}
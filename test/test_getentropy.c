@@ -1,19 +1,122 @@
 /*
- * Simple test harness and benchmark for MT Arc4Random
+ * Simple test harness for getentropy()
+ *
+ * Besides checking basic operation, this checks the 256-byte request limit,
+ * and that getentropy() survives the caller closing its fds, or dup2()ing
+ * something else over them, behind its back.
  */
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/random.h>
-#include <assert.h>
+
+#define MAXBUF  256
+#define MAXFD   64
+
+static int verbose = 0;
+
+/* Get a full-size buffer, and check it's not all zeros */
+static int
+check_get(const char *when)
+{
+  unsigned char buf[MAXBUF];
+  int i;
+
+  memset(buf, 0, sizeof(buf));
+  if (getentropy(buf, sizeof(buf))) {
+    printf("  getentropy(%d) %s failed: %s\n",
+           (int) sizeof(buf), when, strerror(errno));
+    return 1;
+  }
+  for (i = 0; i < (int) sizeof(buf); ++i) {
+    if (buf[i]) break;
+  }
+  if (i >= (int) sizeof(buf)) {
+    printf("  getentropy(%d) %s returned all zeros\n", (int) sizeof(buf), when);
+    return 1;
+  }
+  if (verbose) printf("  getentropy(%d) %s OK\n", (int) sizeof(buf), when);
+  return 0;
+}
+
+static int
+check_limits(void)
+{
+  unsigned char buf[MAXBUF + 1];
+  int err = 0;
+
+  errno = 0;
+  if (getentropy(buf, 0) || errno) {
+    printf("  getentropy(0) failed or set errno: %s\n", strerror(errno));
+    err = 1;
+  }
+  errno = 0;
+  if (getentropy(buf, MAXBUF + 1) != -1 || errno != EIO) {
+    printf("  getentropy(%d) didn't fail with EIO: %s\n",
+           MAXBUF + 1, strerror(errno));
+    err = 1;
+  }
+  if (verbose && !err) printf("  getentropy limits OK\n");
+  return err;
+}
+
+/* Any random-device fds left open by getentropy must be close-on-exec */
+static int
+check_cloexec(void)
+{
+  int fd, flags;
+  struct stat st, rst;
+
+  if (stat("/dev/urandom", &rst)) {
+    perror("  stat /dev/urandom");
+    return 1;
+  }
+  for (fd = 3; fd < MAXFD; ++fd) {
+    if (fstat(fd, &st) || !S_ISCHR(st.st_mode)) continue;
+    if (st.st_rdev != rst.st_rdev) continue;
+    if ((flags = fcntl(fd, F_GETFD)) < 0) continue;
+    if (!(flags & FD_CLOEXEC)) {
+      printf("  fd %d (random device) is not close-on-exec\n", fd);
+      return 1;
+    }
+  }
+  if (verbose) printf("  close-on-exec OK\n");
+  return 0;
+}
 
 int
-main()
+main(int argc, char *argv[])
 {
-  char buf[8];
-  int r = getentropy(&buf, sizeof buf);
-  assert(r == 0);
-  printf( "getentropy : %i\n", r );
-  return r;
+  char *progname = basename(argv[0]);
+  int fd, nullfd, err = 0;
+
+  if (argc > 1 && !strcmp(argv[1], "-v")) verbose = 1;
+
+  err |= check_get("initially");
+  err |= check_limits();
+  err |= check_cloexec();
+
+  /* Close everything behind its back */
+  for (fd = 3; fd < MAXFD; ++fd) (void) close(fd);
+  err |= check_get("after closing fds");
+
+  /* Replace everything with /dev/null behind its back */
+  if ((nullfd = open("/dev/null", O_RDONLY)) < 0) {
+    perror("  open /dev/null");
+    return 1;
+  }
+  for (fd = 3; fd < MAXFD; ++fd) {
+    if (fd != nullfd) (void) dup2(nullfd, fd);
+  }
+  err |= check_get("after dup2 over fds");
+  err |= check_cloexec();
+
+  printf("%s %s.\n", progname, err ? "failed" : "succeeded");
+  return err;
 }
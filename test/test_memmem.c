@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Differential test of memmem() against the original naive implementation.
+ *
+ * This runs three sets of cases:
+ *
+ *   1) Exhaustive: every haystack up to EXH_HAYMAX bytes and every needle up
+ *      to EXH_NEEDMAX bytes over a two-letter alphabet, which covers all the
+ *      periodicity cases for the short-needle code.
+ *
+ *   2) Random: haystacks and needles from small alphabets, with needles
+ *      often taken from the haystack, long enough to exercise the long-needle
+ *      (Two-Way) code and the SIMD prefilter blocks.
+ *
+ *   3) Pathological: long runs of one byte with needles that almost match
+ *      everywhere, to exercise the prefilter's fallback to Two-Way.
+ *
+ * Every case is run at each of several haystack alignments.
+ */
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EXH_HAYMAX   10
+#define EXH_NEEDMAX  7
+#define RAND_CASES   200000
+#define RAND_HAYMAX  600
+#define RAND_NEEDMAX 100
+#define PATH_HAYLEN  5000
+#define ALIGNMENTS   4
+
+static int verbose = 0;
+static unsigned long errors = 0, cases = 0;
+
+/* The original implementation, as the reference */
+static void *
+ref_memmem(const void *l, size_t l_len, const void *s, size_t s_len)
+{
+  register char *cur, *last;
+  const char *cl = (const char *)l;
+  const char *cs = (const char *)s;
+
+  if (l_len == 0 || s_len == 0)
+    return NULL;
+  if (l_len < s_len)
+    return NULL;
+  if (s_len == 1)
+    return memchr(l, (int)*cs, l_len);
+
+  last = (char *)cl + l_len - s_len;
+  for (cur = (char *)cl; cur <= last; cur++)
+    if (cur[0] == cs[0] && memcmp(cur, cs, s_len) == 0)
+      return cur;
+
+  return NULL;
+}
+
+static unsigned char haybuf[PATH_HAYLEN + ALIGNMENTS];
+
+/* Compare memmem() to the reference, at all alignments */
+static void
+check(const unsigned char *hay, size_t hlen,
+      const unsigned char *needle, size_t nlen)
+{
+  unsigned char *h;
+  void *got, *want;
+  int align;
+
+  for (align = 0; align < ALIGNMENTS; ++align) {
+    h = haybuf + align;
+    memcpy(h, hay, hlen);
+    ++cases;
+    got = memmem(h, hlen, needle, nlen);
+    want = ref_memmem(h, hlen, needle, nlen);
+    if (got != want) {
+      if (verbose || !errors) {
+        printf("  Mismatch: haylen %d, needlelen %d, align %d:"
+               " got %ld, expected %ld\n",
+               (int) hlen, (int) nlen, align,
+               got ? (long) ((unsigned char *) got - h) : -1L,
+               want ? (long) ((unsigned char *) want - h) : -1L);
+      }
+      ++errors;
+    }
+  }
+}
+
+/* Fill a buffer with the binary representation of a value over "ab" */
+static void
+fill_ab(unsigned char *buf, size_t len, unsigned long val)
+{
+  size_t i;
+
+  for (i = 0; i < len; ++i) buf[i] = 'a' + ((val >> i) & 1);
+}
+
+static void
+test_exhaustive(void)
+{
+  unsigned char hay[EXH_HAYMAX], needle[EXH_NEEDMAX];
+  size_t hlen, nlen;
+  unsigned long hv, nv;
+
+  for (hlen = 0; hlen <= EXH_HAYMAX; ++hlen) {
+    for (hv = 0; hv < (1UL << hlen); ++hv) {
+      fill_ab(hay, hlen, hv);
+      for (nlen = 0; nlen <= EXH_NEEDMAX; ++nlen) {
+        for (nv = 0; nv < (1UL << nlen); ++nv) {
+          fill_ab(needle, nlen, nv);
+          check(hay, hlen, needle, nlen);
+        }
+      }
+    }
+  }
+}
+
+/* Deterministic generator, so failures are reproducible */
+static unsigned long rand_state = 12345;
+
+static unsigned long
+next_rand(void)
+{
+  rand_state = rand_state * 1103515245UL + 12345UL;
+  return (rand_state >> 16) & 0x7FFF;
+}
+
+static void
+test_random(void)
+{
+  unsigned char hay[RAND_HAYMAX], needle[RAND_NEEDMAX];
+  size_t hlen, nlen, i, pos;
+  int n, alpha;
+
+  for (n = 0; n < RAND_CASES; ++n) {
+    alpha = 1 + next_rand() % 4;
+    hlen = next_rand() % (RAND_HAYMAX + 1);
+    nlen = next_rand() % (RAND_NEEDMAX + 1);
+    for (i = 0; i < hlen; ++i) hay[i] = 'a' + next_rand() % alpha;
+    if (nlen <= hlen && next_rand() % 2) {
+      /* Take the needle from the haystack, maybe with a change */
+      pos = next_rand() % (hlen - nlen + 1);
+      memcpy(needle, hay + pos, nlen);
+      if (nlen && next_rand() % 2) {
+        needle[next_rand() % nlen] = 'a' + next_rand() % alpha;
+      }
+    } else {
+      for (i = 0; i < nlen; ++i) needle[i] = 'a' + next_rand() % alpha;
+    }
+    check(hay, hlen, needle, nlen);
+  }
+}
+
+static void
+test_pathological(void)
+{
+  static unsigned char hay[PATH_HAYLEN], needle[PATH_HAYLEN];
+  size_t nlen, pos;
+
+  memset(hay, 'a', sizeof(hay));
+  for (nlen = 2; nlen <= 300; nlen += (nlen < 40 ? 1 : 37)) {
+    /* Mismatch at the end, the start, and the middle */
+    for (pos = 0; pos < 3; ++pos) {
+      memset(needle, 'a', nlen);
+      needle[pos == 0 ? nlen - 1 : pos == 1 ? 0 : nlen / 2] = 'b';
+      check(hay, sizeof(hay), needle, nlen);
+      /* And with a match at the very end */
+      memcpy(hay + sizeof(hay) - nlen, needle, nlen);
+      check(hay, sizeof(hay), needle, nlen);
+      memset(hay + sizeof(hay) - nlen, 'a', nlen);
+    }
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *progname = basename(argv[0]);
+
+  if (argc > 1 && !strcmp(argv[1], "-v")) verbose = 1;
+
+  test_exhaustive();
+  if (verbose) printf("  Exhaustive: %lu cases, %lu errors\n", cases, errors);
+  test_random();
+  if (verbose) printf("  +Random: %lu cases, %lu errors\n", cases, errors);
+  test_pathological();
+  if (verbose) printf("  +Pathological: %lu cases, %lu errors\n", cases, errors);
+
+  printf("%s %s.\n", progname, errors ? "failed" : "succeeded");
+  return errors ? 1 : 0;
+}
@@ -2,18 +2,26 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 int main()
 {
-    char *buffer = 0;
+    char *buffer = 0, *junk;
     size_t size = 0;
-    FILE *fp = open_memstream(&buffer, &size);
+    FILE *fp;
     int i;
+
+    /* Start small, to exercise the growth code */
+    setenv("MPLS_MEMSTREAM_INITCAP", "16", 1);
+    setenv("MPLS_MEMSTREAM_GROWTH", "150", 1);
+
+    fp = open_memstream(&buffer, &size);
     for (i = 0; i < 10240; ++i) {
         static char c = 42;
         fflush(fp);
         assert(size == i);
+        assert(buffer[size] == 0);
         fwrite(&c, 1, 1, fp);
     }
     fclose(fp);
@@ -25,5 +33,37 @@ int main()
     fputs(buffer, stdout);
     free(buffer);
 
+    /* Records, checked against the expected contents */
+    fp = open_memstream(&buffer, &size);
+    for (i = 0; i < 100000; ++i) fprintf(fp, "%d,", i);
+    fclose(fp);
+    assert(size == strlen(buffer));
+    {
+        char *p = buffer;
+        for (i = 0; i < 100000; ++i) {
+            assert(strtol(p, &p, 10) == i && *p == ',');
+            ++p;
+        }
+        assert(*p == 0);
+    }
+    free(buffer);
+
+    /* Leave some dirty memory around for the allocator to reuse */
+    junk = malloc(1 << 20);
+    memset(junk, 0xFF, 1 << 20);
+    free(junk);
+
+    /* Seeking past the end must zero-fill the gap */
+    fp = open_memstream(&buffer, &size);
+    fputs("abc", fp);
+    fseek(fp, 100000, SEEK_SET);
+    fputs("xyz", fp);
+    fclose(fp);
+    assert(size == 100003);
+    assert(!memcmp(buffer, "abc", 3));
+    for (i = 3; i < 100000; ++i) assert(buffer[i] == 0);
+    assert(!memcmp(buffer + 100000, "xyz", 4));
+    free(buffer);
+
     return 0;
 }
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Differential test of open_memstream() used as a read/write stream.
+ *
+ * Each sequence applies the same random mix of seeks, writes, and reads to
+ * a memstream and to a tmpfile(), checking that the results of each
+ * operation and the file positions agree.  At the end of each sequence
+ * (and at random points along the way), the memstream buffer and size are
+ * compared to the file contents.
+ *
+ * Since a memstream zero-fills immediately when seeking past the end, while
+ * a file only does so when written, a seek past the end is always followed
+ * by a write.  Every operation is preceded by a seek (possibly a null one),
+ * as required when switching between reading and writing.
+ */
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEQUENCES 200
+#define OPS       500
+#define MAXIO     5000   /* Larger than BUFSIZ, to bypass the stdio buffer */
+#define MAXFILE   20000
+
+static int verbose = 0;
+static unsigned long errors = 0, ops = 0;
+
+/* Deterministic generator, so failures are reproducible */
+static unsigned long rand_state = 12345;
+
+static unsigned long
+next_rand(void)
+{
+  rand_state = rand_state * 1103515245UL + 12345UL;
+  return (rand_state >> 16) & 0x7FFF;
+}
+
+/* Random I/O length, biased toward small values */
+static size_t
+rand_len(void)
+{
+  switch (next_rand() % 4) {
+  case 0: return next_rand() % 4;
+  case 1: return next_rand() % 64;
+  case 2: return next_rand() % 1024;
+  default: return next_rand() % (MAXIO + 1);
+  }
+}
+
+static void
+error(int seq, int op, const char *what)
+{
+  if (verbose || !errors) {
+    printf("  Mismatch in sequence %d, op %d: %s\n", seq, op, what);
+  }
+  ++errors;
+}
+
+/* Compare the memstream buffer to the file contents */
+static void
+check_contents(int seq, int op, FILE *mfp, FILE *tfp,
+               char **bufp, size_t *sizep)
+{
+  static char fbuf[MAXFILE + MAXIO];
+  long mpos, tpos;
+  size_t flen;
+
+  mpos = ftell(mfp); tpos = ftell(tfp);
+  if (fflush(mfp)) error(seq, op, "fflush");
+  if (fseek(tfp, 0, SEEK_SET)) error(seq, op, "tmpfile fseek");
+  flen = fread(fbuf, 1, sizeof(fbuf), tfp);
+  if (*sizep != flen) {
+    if (verbose) {
+      printf("    memstream size %lu, file size %lu\n",
+             (unsigned long) *sizep, (unsigned long) flen);
+    }
+    error(seq, op, "size");
+  } else if (memcmp(*bufp, fbuf, flen)) {
+    error(seq, op, "contents");
+  }
+  if ((*bufp)[*sizep]) error(seq, op, "terminator");
+  /* Restore the positions */
+  if (fseek(mfp, mpos, SEEK_SET) || fseek(tfp, tpos, SEEK_SET)) {
+    error(seq, op, "restore fseek");
+  }
+}
+
+static void
+run_sequence(int seq)
+{
+  static char wbuf[MAXIO], mbuf[MAXIO], tbuf[MAXIO];
+  FILE *mfp, *tfp;
+  char *buf = NULL;
+  size_t size = 0, len, mn, tn, i;
+  long off, mpos, tpos, end;
+  int op, whence, mret, tret, past_end;
+
+  mfp = open_memstream(&buf, &size);
+  tfp = tmpfile();
+  if (!mfp || !tfp) {
+    error(seq, -1, "open");
+    if (mfp) fclose(mfp);
+    if (tfp) fclose(tfp);
+    free(buf);
+    return;
+  }
+
+  for (op = 0; op < OPS; ++op) {
+    ++ops;
+
+    /* Seek, with the end obtained from the file */
+    tpos = ftell(tfp);
+    end = (fseek(tfp, 0, SEEK_END), ftell(tfp));
+    whence = SEEK_CUR; off = 0;
+    switch (next_rand() % 4) {
+    case 0:
+      whence = SEEK_SET; off = end ? next_rand() % (end + 1) : 0; break;
+    case 1:
+      whence = SEEK_END; off = -(long) (end ? next_rand() % (end + 1) : 0);
+      break;
+    case 2:
+      if (next_rand() % 4 == 0 && end < MAXFILE) {
+        whence = SEEK_END; off = next_rand() % 100;
+      } else {
+        off = (long) (next_rand() % (end + 1)) - tpos;
+      }
+      break;
+    }
+    if (whence == SEEK_CUR) {
+      /* The file position was moved to get the end */
+      mret = fseek(mfp, off, SEEK_CUR);
+      tret = fseek(tfp, tpos + off, SEEK_SET);
+    } else {
+      mret = fseek(mfp, off, whence);
+      tret = fseek(tfp, off, whence);
+    }
+    if (mret != tret) error(seq, op, "fseek result");
+    mpos = ftell(mfp); tpos = ftell(tfp);
+    if (mpos != tpos) {
+      if (verbose) printf("    memstream pos %ld, file pos %ld\n", mpos, tpos);
+      error(seq, op, "position after fseek");
+    }
+    past_end = tpos > end;
+
+    /* Then write or read */
+    if (past_end || next_rand() % 2) {
+      len = rand_len();
+      if (past_end && !len) len = 1;
+      if (tpos + len > MAXFILE) len = tpos < MAXFILE ? MAXFILE - tpos : 1;
+      for (i = 0; i < len; ++i) wbuf[i] = next_rand();
+      mn = fwrite(wbuf, 1, len, mfp);
+      tn = fwrite(wbuf, 1, len, tfp);
+      if (mn != tn) error(seq, op, "fwrite result");
+    } else {
+      len = rand_len();
+      mn = fread(mbuf, 1, len, mfp);
+      tn = fread(tbuf, 1, len, tfp);
+      if (mn != tn) {
+        if (verbose) {
+          printf("    read %lu at %ld: memstream %lu, file %lu\n",
+                 (unsigned long) len, tpos,
+                 (unsigned long) mn, (unsigned long) tn);
+        }
+        error(seq, op, "fread result");
+      } else if (memcmp(mbuf, tbuf, mn)) {
+        error(seq, op, "fread data");
+      }
+    }
+    if (ftell(mfp) != ftell(tfp)) error(seq, op, "position after I/O");
+
+    if (next_rand() % 16 == 0) check_contents(seq, op, mfp, tfp, &buf, &size);
+  }
+  check_contents(seq, op, mfp, tfp, &buf, &size);
+
+  /*
+   * On close, the size is truncated to the position.  The fflush() makes
+   * sure the stream's position is passed down, in case the fseek() was
+   * satisfied within the read buffer.
+   */
+  tpos = ftell(tfp);
+  if (fseek(mfp, tpos, SEEK_SET)) error(seq, op, "final fseek");
+  if (fflush(mfp)) error(seq, op, "final fflush");
+  if (fclose(mfp)) error(seq, op, "fclose");
+  if (size != (size_t) tpos) error(seq, op, "size after fclose");
+  if (buf[size]) error(seq, op, "terminator after fclose");
+  fclose(tfp);
+  free(buf);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *progname = basename(argv[0]);
+  int seq;
+
+  if (argc > 1 && !strcmp(argv[1], "-v")) verbose = 1;
+
+  /* Start small, to exercise the growth code */
+  setenv("MPLS_MEMSTREAM_INITCAP", "16", 1);
+
+  for (seq = 0; seq < SEQUENCES; ++seq) run_sequence(seq);
+  if (verbose) printf("  %d sequences, %lu ops, %lu errors\n",
+                      SEQUENCES, ops, errors);
+
+  printf("%s %s.\n", progname, errors ? "failed" : "succeeded");
+  return errors ? 1 : 0;
+}
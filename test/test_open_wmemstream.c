@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Test open_wmemstream().
+ *
+ * This checks growth one character at a time, formatted records, seeking
+ * (including zero-fill past the end and truncation at close), characters
+ * the C locale can't represent, and, if a UTF-8 locale is available,
+ * non-ASCII characters, including long runs.
+ */
+
+#include <libgen.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#define GROW_CHARS 10240
+#define RECORDS    100000
+#define LONG_CHARS 20000
+
+static int verbose = 0;
+static int errors = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      if (verbose || !errors) printf("  Failed at line %d: %s\n", \
+                                     __LINE__, #cond); \
+      ++errors; \
+    } \
+  } while (0)
+
+static void
+test_growth(void)
+{
+  wchar_t *buf = NULL;
+  size_t size = 0;
+  FILE *fp;
+  int i;
+
+  CHECK((fp = open_wmemstream(&buf, &size)) != NULL);
+  if (!fp) return;
+  for (i = 0; i < GROW_CHARS; ++i) {
+    fflush(fp);
+    CHECK(size == (size_t) i);
+    CHECK(buf[size] == 0);
+    CHECK(fputwc(L'a' + i % 26, fp) != WEOF);
+  }
+  CHECK(fclose(fp) == 0);
+  CHECK(size == GROW_CHARS);
+  CHECK(wcslen(buf) == size);
+  for (i = 0; i < GROW_CHARS; ++i) CHECK(buf[i] == (wchar_t) (L'a' + i % 26));
+  free(buf);
+}
+
+static void
+test_records(void)
+{
+  wchar_t *buf = NULL, *p, *end;
+  size_t size = 0;
+  FILE *fp;
+  long i;
+
+  CHECK((fp = open_wmemstream(&buf, &size)) != NULL);
+  if (!fp) return;
+  for (i = 0; i < RECORDS; ++i) CHECK(fwprintf(fp, L"%ld,", i) > 0);
+  CHECK(fclose(fp) == 0);
+  CHECK(size == wcslen(buf));
+
+  for (p = buf, i = 0; i < RECORDS && *p; ++i, p = end + 1) {
+    if (wcstol(p, &end, 10) != i || *end != L',') break;
+  }
+  CHECK(i == RECORDS && *p == 0);
+  free(buf);
+}
+
+static void
+test_seek(void)
+{
+  wchar_t *buf = NULL;
+  size_t size = 0;
+  FILE *fp;
+  int i;
+
+  CHECK((fp = open_wmemstream(&buf, &size)) != NULL);
+  if (!fp) return;
+  CHECK(fputws(L"hello", fp) >= 0);
+
+  /* Past the end, with zero fill */
+  CHECK(fseek(fp, 10, SEEK_SET) == 0);
+  CHECK(fputws(L"world", fp) >= 0);
+  CHECK(fflush(fp) == 0);
+  CHECK(size == 15);
+  CHECK(!wmemcmp(buf, L"hello", 5));
+  for (i = 5; i < 10; ++i) CHECK(buf[i] == 0);
+  CHECK(!wmemcmp(buf + 10, L"world", 5) && buf[15] == 0);
+
+  /* Overwrite in the middle */
+  CHECK(fseek(fp, 1, SEEK_SET) == 0);
+  CHECK(fputws(L"ELL", fp) >= 0);
+  CHECK(fflush(fp) == 0);
+  CHECK(ftell(fp) == 4);
+  CHECK(size == 15 && !wmemcmp(buf, L"hELLo", 5));
+
+  /* Relative to the end */
+  CHECK(fseek(fp, -5, SEEK_END) == 0);
+  CHECK(ftell(fp) == 10);
+
+  /* Truncated to the position on close */
+  CHECK(fseek(fp, 3, SEEK_SET) == 0);
+  CHECK(fclose(fp) == 0);
+  CHECK(size == 3 && !wmemcmp(buf, L"hEL", 3) && buf[3] == 0);
+  free(buf);
+}
+
+/*
+ * Wide characters are stored as they are, regardless of the locale, and
+ * positions count wide characters even without a flush.
+ */
+static void
+test_c_locale(void)
+{
+  static const wchar_t expect[] =
+      L"\x3A9=\x4E2D\x6587 [  \x20AC] 42 -1.50 ok|abc  |%";
+  wchar_t *buf = NULL;
+  size_t size = 0;
+  FILE *fp;
+  int n = 0;
+
+  CHECK(setlocale(LC_CTYPE, "C") != NULL);
+  CHECK((fp = open_wmemstream(&buf, &size)) != NULL);
+  if (!fp) return;
+  CHECK(fputwc(0x3A9, fp) == 0x3A9);
+  CHECK(putwc(L'=', fp) == L'=');
+  CHECK(fputws(L"\x4E2D\x6587", fp) >= 0);
+  CHECK(ftell(fp) == 4);
+  CHECK(fwprintf(fp, L" [%3lc] %d %.2f %s|%-5ls|%n%%",
+                 (wint_t) 0x20AC, 42, -1.5, "ok", L"abc", &n) == 26);
+  CHECK(n == 25);
+  CHECK(ftell(fp) == 30);
+  CHECK(fflush(fp) == 0);
+  CHECK(size == 30 && !wcscmp(buf, expect));
+  CHECK(fclose(fp) == 0);
+  CHECK(size == 30 && !wcscmp(buf, expect));
+  free(buf);
+}
+
+static void
+test_multibyte(void)
+{
+  static const wchar_t chars[] = {
+    0xE9, 0x3A9, 0x4E2D, 0x20AC, L'x', 0x1F600,
+  };
+  const int nchars = sizeof(chars) / sizeof(chars[0]);
+  wchar_t *buf = NULL;
+  size_t size = 0;
+  FILE *fp;
+  int i;
+
+  if (!setlocale(LC_CTYPE, "en_US.UTF-8") && !setlocale(LC_CTYPE, "C.UTF-8")) {
+    if (verbose) printf("  No UTF-8 locale, skipping multibyte test\n");
+    return;
+  }
+
+  CHECK((fp = open_wmemstream(&buf, &size)) != NULL);
+  if (!fp) goto out;
+  CHECK(fwprintf(fp, L"%lc%ls", (wint_t) 0xE9, L"\x4E2D\x6587") == 3);
+  CHECK(fflush(fp) == 0);
+  CHECK(size == 3 && buf[0] == 0xE9 && buf[1] == 0x4E2D && buf[2] == 0x6587);
+
+  /* Enough multibyte output to be split across stdio buffers */
+  for (i = 0; i < LONG_CHARS; ++i) {
+    CHECK(fputwc(chars[i % nchars], fp) != WEOF);
+  }
+  CHECK(fclose(fp) == 0);
+  CHECK(size == 3 + LONG_CHARS);
+  for (i = 0; i < LONG_CHARS; ++i) CHECK(buf[3 + i] == chars[i % nchars]);
+  CHECK(buf[size] == 0);
+  free(buf);
+
+ out:
+  (void) setlocale(LC_CTYPE, "C");
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *progname = basename(argv[0]);
+
+  if (argc > 1 && !strcmp(argv[1], "-v")) verbose = 1;
+
+  /* Start small, to exercise the growth code */
+  setenv("MPLS_MEMSTREAM_INITCAP", "16", 1);
+  setenv("MPLS_MEMSTREAM_GROWTH", "150", 1);
+
+  test_growth();
+  test_records();
+  test_seek();
+  test_c_locale();
+  test_multibyte();
+
+  printf("%s %s.\n", progname, errors ? "failed" : "succeeded");
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Guard-page tests for strnlen(), wcsnlen(), and stpncpy().
+ *
+ * This maps a readable page between two PROT_NONE pages, and places
+ * strings right up against either end of it, at every alignment, for a
+ * range of string lengths and limits.  Any read outside the string (in the
+ * sense of crossing into a page that the string doesn't occupy) crashes
+ * the test.  The results are also checked against simple reference
+ * versions.
+ *
+ * The string contents include bytes (and wide characters) with high bits
+ * set, to catch mistakes in zero-detection tricks.
+ */
+
+#include <libgen.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wchar.h>
+
+#include <sys/mman.h>
+
+#define MAXLEN 100
+
+static int verbose = 0;
+static unsigned long errors = 0, cases = 0;
+
+static char *page;
+static size_t pagesize;
+
+static const char fill_chars[] = { 'a', 0x01, (char) 0x80, (char) 0xFF };
+static const wchar_t fill_wchars[] = {
+  L'a', 0x01, 0x100, 0x10000, 0x1000000, (wchar_t) -1,
+};
+
+/* Map the guarded page, returning nonzero on failure */
+static int
+map_page(void)
+{
+  char *base;
+
+  pagesize = getpagesize();
+  base = mmap(NULL, pagesize * 3, PROT_READ | PROT_WRITE,
+              MAP_ANON | MAP_PRIVATE, -1, 0);
+  if (base == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  if (mprotect(base, pagesize, PROT_NONE)
+      || mprotect(base + pagesize * 2, pagesize, PROT_NONE)) {
+    perror("mprotect");
+    return 1;
+  }
+  page = base + pagesize;
+  return 0;
+}
+
+static size_t
+ref_strnlen(const char *s, size_t maxlen)
+{
+  size_t len;
+
+  for (len = 0; len < maxlen && s[len]; ++len)
+    ;
+  return len;
+}
+
+static size_t
+ref_wcsnlen(const wchar_t *s, size_t maxlen)
+{
+  size_t len;
+
+  for (len = 0; len < maxlen && s[len]; ++len)
+    ;
+  return len;
+}
+
+static void
+report(const char *name, const char *where, size_t slen, size_t maxlen,
+       size_t got, size_t expected)
+{
+  ++cases;
+  if (got == expected) return;
+  if (verbose || !errors) {
+    printf("  %s, %s, string length %d, limit %d: got %d, expected %d\n",
+           name, where, (int) slen, (int) maxlen, (int) got, (int) expected);
+  }
+  ++errors;
+}
+
+/*
+ * Check one string, which is either terminated or not.  For an unterminated
+ * string, only limits up to its length are valid.
+ */
+static void
+check_str(const char *s, size_t slen, int terminated, const char *where)
+{
+  size_t maxlen, top = terminated ? slen + 2 : slen;
+
+  for (maxlen = 0; maxlen <= top; ++maxlen) {
+    report("strnlen", where, slen, maxlen,
+           strnlen(s, maxlen), ref_strnlen(s, maxlen));
+  }
+  if (terminated) {
+    report("strnlen", where, slen, SIZE_MAX, strnlen(s, SIZE_MAX), slen);
+  }
+}
+
+static void
+check_wcs(const wchar_t *s, size_t slen, int terminated, const char *where)
+{
+  size_t maxlen, top = terminated ? slen + 2 : slen;
+
+  for (maxlen = 0; maxlen <= top; ++maxlen) {
+    report("wcsnlen", where, slen, maxlen,
+           wcsnlen(s, maxlen), ref_wcsnlen(s, maxlen));
+  }
+  if (terminated) {
+    report("wcsnlen", where, slen, SIZE_MAX, wcsnlen(s, SIZE_MAX), slen);
+  }
+}
+
+static void
+fill_str(char *s, size_t slen, size_t seed)
+{
+  size_t i;
+
+  for (i = 0; i < slen; ++i) {
+    s[i] = fill_chars[(i + seed) % sizeof(fill_chars)];
+  }
+}
+
+static void
+fill_wcs(wchar_t *s, size_t slen, size_t seed)
+{
+  size_t i, n = sizeof(fill_wchars) / sizeof(fill_wchars[0]);
+
+  for (i = 0; i < slen; ++i) s[i] = fill_wchars[(i + seed) % n];
+}
+
+static void
+test_strnlen(void)
+{
+  char *s, *end = page + pagesize;
+  size_t slen, seed;
+
+  for (slen = 0; slen <= MAXLEN; ++slen) {
+    for (seed = 0; seed < sizeof(fill_chars); ++seed) {
+      /* Terminated, with the terminator in the last byte of the page */
+      s = end - slen - 1;
+      fill_str(s, slen, seed);
+      s[slen] = '\0';
+      check_str(s, slen, 1, "at end");
+
+      /* Unterminated, running right up to the end of the page */
+      s = end - slen;
+      fill_str(s, slen, seed);
+      check_str(s, slen, 0, "unterminated at end");
+
+      /* Terminated, at the start of the page */
+      s = page;
+      fill_str(s, slen, seed);
+      s[slen] = '\0';
+      check_str(s, slen, 1, "at start");
+    }
+  }
+}
+
+static void
+test_wcsnlen(void)
+{
+  wchar_t *s, *end = (wchar_t *) (page + pagesize);
+  size_t slen, seed;
+
+  for (slen = 0; slen <= MAXLEN; ++slen) {
+    for (seed = 0; seed < sizeof(fill_wchars) / sizeof(fill_wchars[0]);
+         ++seed) {
+      s = end - slen - 1;
+      fill_wcs(s, slen, seed);
+      s[slen] = L'\0';
+      check_wcs(s, slen, 1, "at end");
+
+      s = end - slen;
+      fill_wcs(s, slen, seed);
+      check_wcs(s, slen, 0, "unterminated at end");
+
+      s = (wchar_t *) page;
+      fill_wcs(s, slen, seed);
+      s[slen] = L'\0';
+      check_wcs(s, slen, 1, "at start");
+    }
+  }
+}
+
+/* stpncpy() from an unterminated source against the end of the page */
+static void
+test_stpncpy(void)
+{
+  char dst[MAXLEN + 1], *s, *ret, *end = page + pagesize;
+  size_t slen;
+
+  for (slen = 0; slen <= MAXLEN; ++slen) {
+    s = end - slen;
+    fill_str(s, slen, slen);
+    memset(dst, '*', sizeof(dst));
+    ret = stpncpy(dst, s, slen);
+    report("stpncpy", "unterminated at end", slen, slen,
+           ret - dst, slen);
+    report("stpncpy", "contents", slen, slen,
+           memcmp(dst, s, slen) || dst[slen] != '*', 0);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *progname = basename(argv[0]);
+
+  if (argc > 1 && !strcmp(argv[1], "-v")) verbose = 1;
+
+  if (map_page()) {
+    printf("%s failed.\n", progname);
+    return 1;
+  }
+
+  test_strnlen();
+  if (verbose) printf("  strnlen: %lu cases, %lu errors\n", cases, errors);
+  test_wcsnlen();
+  if (verbose) printf("  +wcsnlen: %lu cases, %lu errors\n", cases, errors);
+  test_stpncpy();
+  if (verbose) printf("  +stpncpy: %lu cases, %lu errors\n", cases, errors);
+
+  printf("%s %s.\n", progname, errors ? "failed" : "succeeded");
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Test the time conversion arithmetic used by the clock functions.
+ *
+ * This includes the private conversion header directly, and doesn't use
+ * the library.  It checks:
+ *
+ *   The (possibly native) 128-bit multiplies against an independent
+ *   16-bit schoolbook multiply, for all pairs of "floating ones" and
+ *   "floating zeroes" patterns, plus random operands.
+ *
+ *   The reciprocal seconds split against plain division and modulo, for
+ *   all values up to 2^24, the values around every multiple of one billion
+ *   up to 2^24 seconds, the patterns as above, random values, and the
+ *   top of the range.
+ *
+ *   The mach_time scaling against the portable multiply, for the known
+ *   scale factors.
+ */
+
+#include <libgen.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/time_conv.h"
+
+#define EXHAUSTIVE_BITS 24
+#define RAND_VALUES     1000000
+
+static int verbose = 0;
+static int errors = 0;
+
+/* Deterministic generator, so failures are reproducible */
+static uint64_t rand_state = 1;
+
+static uint64_t
+next_rand(void)
+{
+  rand_state = rand_state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return rand_state ^ (rand_state >> 29);
+}
+
+/* Floating ones and zeroes patterns (all runs of ones, and complements) */
+#define MAX_PATTERNS (64 * 65 + 2)
+static uint64_t patterns[MAX_PATTERNS];
+static int num_patterns;
+
+static void
+setup_patterns(void)
+{
+  int start, len;
+  uint64_t run;
+
+  patterns[num_patterns++] = 0;
+  for (len = 1; len <= 64; ++len) {
+    run = len < 64 ? (1ULL << len) - 1 : ~0ULL;
+    for (start = 0; start + len <= 64; ++start) {
+      patterns[num_patterns++] = run << start;
+      patterns[num_patterns++] = ~(run << start);
+    }
+  }
+}
+
+/* Reference 64x64->128 multiply, with 16-bit limbs */
+static void
+ref_mul128(uint64_t a, uint64_t b, uint64_t *hi, uint64_t *lo)
+{
+  uint32_t prod[8] = {0};
+  uint32_t carry;
+  int i, j;
+
+  for (i = 0; i < 4; ++i) {
+    carry = 0;
+    for (j = 0; j < 4; ++j) {
+      carry += prod[i + j]
+               + (uint32_t) ((a >> (16 * i)) & 0xFFFF)
+                 * (uint32_t) ((b >> (16 * j)) & 0xFFFF);
+      prod[i + j] = carry & 0xFFFF;
+      carry >>= 16;
+    }
+    prod[i + 4] = carry;
+  }
+  *lo = *hi = 0;
+  for (i = 3; i >= 0; --i) {
+    *lo = (*lo << 16) | prod[i];
+    *hi = (*hi << 16) | prod[i + 4];
+  }
+}
+
+static void
+check_mul(uint64_t a, uint64_t b)
+{
+  uint64_t hi, lo, mid;
+
+  ref_mul128(a, b, &hi, &lo);
+  mid = (hi << 32) | (lo >> 32);
+  if (mmul64(a, b) != mid || mmul64_portable(a, b) != mid
+      || umulh64(a, b) != hi || umulh64_portable(a, b) != hi) {
+    if (verbose || errors < 10) {
+      printf("  Multiply 0x%016llX * 0x%016llX: expected hi/mid"
+             " 0x%016llX/0x%016llX, got 0x%016llX/0x%016llX"
+             " (portable 0x%016llX/0x%016llX)\n",
+             (unsigned long long) a, (unsigned long long) b,
+             (unsigned long long) hi, (unsigned long long) mid,
+             (unsigned long long) umulh64(a, b),
+             (unsigned long long) mmul64(a, b),
+             (unsigned long long) umulh64_portable(a, b),
+             (unsigned long long) mmul64_portable(a, b));
+    }
+    ++errors;
+  }
+}
+
+static void
+test_mul(void)
+{
+  int i, j;
+  long n;
+
+  for (i = 0; i < num_patterns; ++i) {
+    for (j = 0; j < num_patterns; ++j) check_mul(patterns[i], patterns[j]);
+  }
+  for (n = 0; n < RAND_VALUES; ++n) check_mul(next_rand(), next_rand());
+}
+
+static void
+check_split(uint64_t nanos)
+{
+  struct timespec ts;
+
+  nanos2timespec(nanos, &ts);
+  if (nanos2secs(nanos) != nanos / BILLION64
+      || (uint64_t) ts.tv_sec != (uint64_t) (time_t) (nanos / BILLION64)
+      || (uint64_t) ts.tv_nsec != nanos % BILLION64) {
+    if (verbose || errors < 10) {
+      printf("  Split of %llu: expected %llu.%09llu, got %llu (%lld.%09ld)\n",
+             (unsigned long long) nanos,
+             (unsigned long long) (nanos / BILLION64),
+             (unsigned long long) (nanos % BILLION64),
+             (unsigned long long) nanos2secs(nanos),
+             (long long) ts.tv_sec, (long) ts.tv_nsec);
+    }
+    ++errors;
+  }
+}
+
+static void
+test_split(void)
+{
+  uint64_t nanos, secs;
+  int i;
+  long n;
+
+  for (nanos = 0; nanos < (1ULL << EXHAUSTIVE_BITS); ++nanos) {
+    check_split(nanos);
+  }
+  for (secs = 1; secs < (1ULL << EXHAUSTIVE_BITS); ++secs) {
+    nanos = secs * BILLION64;
+    check_split(nanos - 1);
+    check_split(nanos);
+    check_split(nanos + 1);
+  }
+  for (i = 0; i < num_patterns; ++i) check_split(patterns[i]);
+  for (n = 0; n < RAND_VALUES; ++n) {
+    nanos = next_rand();
+    check_split(nanos);
+    check_split(nanos >> (nanos & 63));
+  }
+  for (nanos = ~0ULL; nanos > ~0ULL - (1ULL << 16); --nanos) {
+    check_split(nanos);
+  }
+}
+
+/* Observed scale factors, plus one exercising the large-numerator case */
+static const struct { uint32_t numer, denom; } scales[] = {
+  {1, 1},                   /* x86 */
+  {125, 3},                 /* arm64 */
+  {1000000000, 33333333},   /* PowerPC */
+  {1000000000, 33330000},
+  {1000000000, 25000000},
+  {1000000000, 18432000},
+  {0xFFFFFFFFU, 7},         /* Paranoia case */
+};
+
+static void
+test_scale(void)
+{
+  uint64_t mult, mach_time, ref;
+  int i;
+  long n;
+
+  for (i = 0; i < (int) (sizeof(scales) / sizeof(scales[0])); ++i) {
+    mult = mach_mult_from_scale(scales[i].numer, scales[i].denom);
+    for (n = 0; n < RAND_VALUES; ++n) {
+      mach_time = next_rand() >> (n & 31);
+      ref = mult == NULL_SCALE ? mach_time
+            : mmul64_portable(mach_time, mult) >> EXTRA_SHIFT;
+      if (mach2nanos_mult(mach_time, mult) != ref) {
+        if (verbose || errors < 10) {
+          printf("  Scale %u/%u of %llu: expected %llu, got %llu\n",
+                 scales[i].numer, scales[i].denom,
+                 (unsigned long long) mach_time, (unsigned long long) ref,
+                 (unsigned long long) mach2nanos_mult(mach_time, mult));
+        }
+        ++errors;
+      }
+    }
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *progname = basename(argv[0]);
+
+  if (argc > 1 && !strcmp(argv[1], "-v")) verbose = 1;
+
+  if (verbose) {
+    printf("  Using %s 128-bit multiply\n",
+           MPLS_HAVE_UINT128 ? "native" : "portable");
+  }
+
+  setup_patterns();
+  test_mul();
+  test_split();
+  test_scale();
+
+  printf("%s %s.\n", progname, errors ? "failed" : "succeeded");
+  return errors ? 1 : 0;
+}
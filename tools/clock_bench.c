@@ -0,0 +1,435 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * This is a benchmark for clock reads, reporting the cost in ns/call and
+ * the jitter, i.e. the distribution of the deltas between consecutive reads
+ * (min, median, 99th and 99.9th percentiles, max, and standard deviation).
+ * For the CLOCK_* clocks, it also reports the reported resolution.
+ *
+ * Like clock_info, this is intended to be built without legacy-support,
+ * but can optionally load the legacy-support library from either the
+ * "system" location or the relative build-tree location.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <libgen.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <mach/mach_time.h>
+
+#include <sys/param.h>
+#include <sys/time.h>
+
+/* Allow builds with <10.12 SDK (as in clock_info) */
+#ifndef CLOCK_REALTIME
+typedef enum {
+_CLOCK_REALTIME = 0,
+#define CLOCK_REALTIME _CLOCK_REALTIME
+_CLOCK_MONOTONIC = 6,
+#define CLOCK_MONOTONIC _CLOCK_MONOTONIC
+_CLOCK_MONOTONIC_RAW = 4,
+#define CLOCK_MONOTONIC_RAW _CLOCK_MONOTONIC_RAW
+_CLOCK_MONOTONIC_RAW_APPROX = 5,
+#define CLOCK_MONOTONIC_RAW_APPROX _CLOCK_MONOTONIC_RAW_APPROX
+_CLOCK_UPTIME_RAW = 8,
+#define CLOCK_UPTIME_RAW _CLOCK_UPTIME_RAW
+_CLOCK_UPTIME_RAW_APPROX = 9,
+#define CLOCK_UPTIME_RAW_APPROX _CLOCK_UPTIME_RAW_APPROX
+_CLOCK_PROCESS_CPUTIME_ID = 12,
+#define CLOCK_PROCESS_CPUTIME_ID _CLOCK_PROCESS_CPUTIME_ID
+_CLOCK_THREAD_CPUTIME_ID = 16
+#define CLOCK_THREAD_CPUTIME_ID _CLOCK_THREAD_CPUTIME_ID
+} clockid_t;
+#endif /* CLOCK_REALTIME undef */
+
+/* RTLD_FIRST is unavailable on 10.4 - make it ignored. */
+#ifndef RTLD_FIRST
+#define RTLD_FIRST 0
+#endif
+
+#define DEF_NUM_CALLS 100000
+#define MIN_CALLS     100
+#define MAX_CALLS     10000000
+
+#ifndef MPPREFIX
+#define MPPREFIX "/opt/local"
+#endif
+#define LIBDIR "lib"
+#define LSLIB "libMacportsLegacySupport.dylib"
+#define MPLSLIB MPPREFIX "/" LIBDIR "/" LSLIB
+#define LOCALLSLIB "../" LIBDIR "/" LSLIB
+
+typedef uint64_t mach_time_t;
+typedef uint64_t ns_time_t;
+typedef int64_t sns_time_t;
+
+#define BILLION64  1000000000ULL
+#define UL (unsigned long)
+#define LL (long long)
+
+typedef mach_time_t (mach_fn_t)(void);
+typedef int (timeofday_fn_t)(struct timeval *, void *);
+typedef int (gettime_fn_t)(clockid_t, struct timespec *);
+typedef ns_time_t (gettime_ns_fn_t)(clockid_t);
+typedef int (getres_fn_t)(clockid_t, struct timespec *);
+
+typedef enum clock_type {
+  clock_type_mach,
+  clock_type_timeofday,
+  clock_type_gettime,
+  clock_type_gettime_ns,
+} clock_type_t;
+
+typedef struct clock_def_s {
+  const char *name;
+  const char *func;
+  clock_type_t type;
+  clockid_t clkid;
+} clock_def_t;
+
+#define GETTIME_CLOCKS(sfx,func,type) \
+  {"CLOCK_REALTIME" sfx, func, type, CLOCK_REALTIME}, \
+  {"CLOCK_MONOTONIC" sfx, func, type, CLOCK_MONOTONIC}, \
+  {"CLOCK_MONOTONIC_RAW" sfx, func, type, CLOCK_MONOTONIC_RAW}, \
+  {"CLOCK_MONOTONIC_RAW_APPROX" sfx, func, type, CLOCK_MONOTONIC_RAW_APPROX}, \
+  {"CLOCK_UPTIME_RAW" sfx, func, type, CLOCK_UPTIME_RAW}, \
+  {"CLOCK_UPTIME_RAW_APPROX" sfx, func, type, CLOCK_UPTIME_RAW_APPROX}, \
+  {"CLOCK_PROCESS_CPUTIME_ID" sfx, func, type, CLOCK_PROCESS_CPUTIME_ID}, \
+  {"CLOCK_THREAD_CPUTIME_ID" sfx, func, type, CLOCK_THREAD_CPUTIME_ID},
+
+static const clock_def_t clocks[] = {
+  {"timeofday", "gettimeofday", clock_type_timeofday, 0},
+  {"mach_absolute_time", "mach_absolute_time", clock_type_mach, 0},
+  {"mach_approximate_time", "mach_approximate_time", clock_type_mach, 0},
+  {"mach_continuous_time", "mach_continuous_time", clock_type_mach, 0},
+  {"mach_continuous_approximate_time", "mach_continuous_approximate_time",
+   clock_type_mach, 0},
+  GETTIME_CLOCKS("", "clock_gettime", clock_type_gettime)
+  GETTIME_CLOCKS("_ns", "clock_gettime_nsec_np", clock_type_gettime_ns)
+  {NULL, NULL, 0, 0}
+};
+
+/* Results for one clock */
+typedef struct clock_stats_s {
+  double ns_per_call;
+  ns_time_t res;
+  sns_time_t min, median, p99, p999, max;
+  double stddev;
+} clock_stats_t;
+
+/* Mach clock scale factor */
+static mach_timebase_info_data_t tbinfo;
+static long double mach2nanos;
+
+/* Sample and delta buffers */
+static ns_time_t *samples;
+static sns_time_t *deltas;
+
+static void *
+load_lib(int legacy, char *progname, int verbose)
+{
+  char *progdir;
+  char lslib[PATH_MAX], lsreal[PATH_MAX];
+  const char *libpath;
+  void *libhandle = NULL;
+
+  if (legacy > 0) {
+    libpath = MPLSLIB;
+  } else {
+    progdir = dirname(progname);
+    (void) snprintf(lslib, sizeof(lslib), "%s/" LOCALLSLIB, progdir);
+    if (!(libpath = realpath(lslib, lsreal))) {
+      fprintf(stderr, "Unable to resolve library path '%s': %s\n",
+              lslib, strerror(errno));
+      return NULL;
+    }
+  }
+  if (!(libhandle = dlopen(libpath, RTLD_FIRST))) {
+    fprintf(stderr, "Unable to open library: %s\n", dlerror());
+    return NULL;
+  }
+  if (verbose) {
+    printf("  Loaded %s, handle = 0x%0*lX\n", libpath,
+           (int) sizeof(void *) * 2, UL libhandle);
+  }
+  return libhandle;
+}
+
+static void *
+clock_lookup(const char *name, void *handle)
+{
+  void *adr;
+
+  /* Try extra library first, then general */
+  if (handle && (adr = dlsym(handle, name))) return adr;
+  return dlsym(RTLD_NEXT, name);
+}
+
+/* Collect back-to-back samples in ns, returning elapsed mach time */
+static int
+collect(const clock_def_t *cd, void *func, long calls, mach_time_t *elapsed)
+{
+  struct timeval tv;
+  struct timespec ts;
+  ns_time_t *sp = samples, *se = samples + calls;
+  mach_time_t start;
+  clockid_t clkid = cd->clkid;
+
+  switch (cd->type) {
+
+  case clock_type_mach:
+    (void) (*(mach_fn_t *) func)();
+    start = mach_absolute_time();
+    while (sp < se) *sp++ = (*(mach_fn_t *) func)();
+    *elapsed = mach_absolute_time() - start;
+    for (sp = samples; sp < se; ++sp) *sp = *sp * mach2nanos;
+    break;
+
+  case clock_type_timeofday:
+    (void) (*(timeofday_fn_t *) func)(&tv, NULL);
+    start = mach_absolute_time();
+    while (sp < se) {
+      if ((*(timeofday_fn_t *) func)(&tv, NULL)) return -1;
+      *sp++ = tv.tv_sec * BILLION64 + tv.tv_usec * 1000;
+    }
+    *elapsed = mach_absolute_time() - start;
+    break;
+
+  case clock_type_gettime:
+    (void) (*(gettime_fn_t *) func)(clkid, &ts);
+    start = mach_absolute_time();
+    while (sp < se) {
+      if ((*(gettime_fn_t *) func)(clkid, &ts)) return -1;
+      *sp++ = ts.tv_sec * BILLION64 + ts.tv_nsec;
+    }
+    *elapsed = mach_absolute_time() - start;
+    break;
+
+  case clock_type_gettime_ns:
+    (void) (*(gettime_ns_fn_t *) func)(clkid);
+    start = mach_absolute_time();
+    while (sp < se) {
+      if (!(*sp++ = (*(gettime_ns_fn_t *) func)(clkid))) return -1;
+    }
+    *elapsed = mach_absolute_time() - start;
+    break;
+  }
+
+  return 0;
+}
+
+static int
+comp_delta(const void *d1v, const void *d2v)
+{
+  sns_time_t d1 = *(const sns_time_t *) d1v, d2 = *(const sns_time_t *) d2v;
+
+  if (d1 == d2) return 0;
+  return d1 < d2 ? -1 : 1;
+}
+
+/* Compute the delta statistics */
+static void
+get_stats(long calls, clock_stats_t *st)
+{
+  long n, ndeltas = calls - 1;
+  long double mean, sqsum = 0.0;
+
+  for (n = 0; n < ndeltas; ++n) deltas[n] = samples[n + 1] - samples[n];
+  mean = (long double) (samples[ndeltas] - samples[0]) / ndeltas;
+  for (n = 0; n < ndeltas; ++n) {
+    sqsum += (deltas[n] - mean) * (deltas[n] - mean);
+  }
+  st->stddev = sqrt(sqsum / (ndeltas - 1));
+
+  qsort(deltas, ndeltas, sizeof(deltas[0]), comp_delta);
+  st->min = deltas[0];
+  st->median = deltas[ndeltas / 2];
+  st->p99 = deltas[ndeltas * 99 / 100];
+  st->p999 = deltas[ndeltas * 999 / 1000];
+  st->max = deltas[ndeltas - 1];
+}
+
+static int
+bench_clock(const clock_def_t *cd, void *libhandle, long calls,
+            int verbose, int quiet)
+{
+  void *func;
+  getres_fn_t *getres;
+  struct timespec ts;
+  mach_time_t elapsed = 0;
+  clock_stats_t st = {0};
+
+  if (!(func = clock_lookup(cd->func, libhandle))) {
+    if (verbose) printf("  %s unavailable\n", cd->name);
+    return 0;
+  }
+  if (collect(cd, func, calls, &elapsed)) {
+    if (errno == EINVAL) {
+      if (verbose) printf("  %s unsupported\n", cd->name);
+      return 0;
+    }
+    fprintf(stderr, "  %s failed: %s\n", cd->name, strerror(errno));
+    return 1;
+  }
+  st.ns_per_call = elapsed * mach2nanos / calls;
+  if (cd->type == clock_type_gettime || cd->type == clock_type_gettime_ns) {
+    getres = (getres_fn_t *) clock_lookup("clock_getres", libhandle);
+    if (getres && !(*getres)(cd->clkid, &ts)) {
+      st.res = ts.tv_sec * BILLION64 + ts.tv_nsec;
+    }
+  }
+  get_stats(calls, &st);
+
+  if (quiet) {
+    printf("%s %.1f %lld %lld %lld %lld %lld %.1f %lld\n", cd->name,
+           st.ns_per_call, LL st.min, LL st.median, LL st.p99, LL st.p999,
+           LL st.max, st.stddev, LL st.res);
+  } else {
+    printf("  %-34s %7.1f %6lld %6lld %6lld %7lld %9lld %8.1f",
+           cd->name, st.ns_per_call, LL st.min, LL st.median, LL st.p99,
+           LL st.p999, LL st.max, st.stddev);
+    if (st.res) printf(" %6lld", LL st.res);
+    printf("\n");
+  }
+  return 0;
+}
+
+static long
+getnum(const char *arg, const char *name, long minval, long maxval)
+{
+  long val;
+  char *cp;
+
+  val = strtol(arg, &cp, 0);
+  if (*cp) {
+    fprintf(stderr, "Bad %s argument.\n", name);
+    exit(20);
+  }
+  if (val < minval || val > maxval) {
+    fprintf(stderr, "Value %ld for %s out of range [%ld:%ld].\n",
+            val, name, minval, maxval);
+    exit(20);
+  }
+  return val;
+}
+
+static void
+usage(FILE *fp, const char *name)
+{
+  fprintf(fp, "Usage is: %s [<opts>] [<clock> [<num calls>]]\n", name);
+  fprintf(fp, "  Options:\n");
+  fprintf(fp, "    -h:  This text\n");
+  fprintf(fp, "    -L:  List defined clocks\n");
+  fprintf(fp, "    -q:  Quiet (one line of numbers per clock)\n");
+  fprintf(fp, "    -v:  Verbose output\n");
+  fprintf(fp, "    -y:  Load system legacy-support library\n");
+  fprintf(fp, "    -Y:  Load build-tree legacy-support library\n");
+  fprintf(fp, "  Clock '.' or none means all available clocks.\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int argn = 1;
+  int help = 0, list = 0, quiet = 0, verbose = 0, legacy = 0, err = 0;
+  const char *cp;
+  char chr;
+  char *name = basename(argv[0]);
+  void *libhandle = NULL;
+  const char *clock_name = NULL;
+  const clock_def_t *cd;
+  long calls = DEF_NUM_CALLS;
+
+  while (argn < argc && argv[argn][0] == '-') {
+    cp = argv[argn];
+    while ((chr = *++cp)) {
+      switch (chr) {
+        case 'h': help = 1; break;
+        case 'L': list = 1; break;
+        case 'q': ++quiet; break;
+        case 'v': ++verbose; break;
+        case 'y': legacy = 1; break;
+        case 'Y': legacy = -1; break;
+      }
+    }
+    ++argn;
+  }
+  if (argn < argc) {
+    clock_name = argv[argn];
+    ++argn;
+  }
+  if (argn < argc) {
+    calls = getnum(argv[argn], "num_calls", MIN_CALLS, MAX_CALLS);
+    ++argn;
+  }
+
+  if (help) usage(stdout, name);
+  if (list) {
+    for (cd = clocks; cd->name; ++cd) printf("  %s\n", cd->name);
+  }
+  if (help || list) return 0;
+
+  if (clock_name && !strcmp(clock_name, ".")) clock_name = NULL;
+  if (clock_name) {
+    for (cd = clocks; cd->name; ++cd) {
+      if (!strcmp(clock_name, cd->name)) break;
+    }
+    if (!cd->name) {
+      fprintf(stderr, "Unrecognized clock name '%s'\n", clock_name);
+      return 20;
+    }
+  }
+
+  if (mach_timebase_info(&tbinfo)) {
+    perror("Unable to get mach time scale");
+    return 10;
+  }
+  mach2nanos = (long double) tbinfo.numer / tbinfo.denom;
+
+  if (legacy) {
+    if (!(libhandle = load_lib(legacy, argv[0], verbose && !quiet))) return 10;
+  }
+
+  if (!(samples = calloc(calls, sizeof(*samples)))
+      || !(deltas = calloc(calls, sizeof(*deltas)))) {
+    perror("Unable to allocate sample buffers");
+    return 10;
+  }
+
+  if (!quiet) {
+    printf("%ld calls per clock, deltas in ns:\n", calls);
+    printf("  %-34s %7s %6s %6s %6s %7s %9s %8s %6s\n", "clock", "ns/call",
+           "min", "median", "99%", "99.9%", "max", "stddev", "res");
+  }
+  for (cd = clocks; cd->name; ++cd) {
+    if (clock_name && strcmp(clock_name, cd->name)) continue;
+    err |= bench_clock(cd, libhandle, calls, verbose && !quiet, quiet);
+  }
+
+  free(deltas);
+  free(samples);
+  if (libhandle) (void) dlclose(libhandle);
+
+  if (!quiet) printf("%s %s.\n", name, err ? "failed" : "completed");
+  return err;
+}
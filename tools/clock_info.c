@@ -17,7 +17,11 @@
 /*
  * This is an investigative tool for capturing runs of clock samples and
  * reporting a histogram of the deltas, or of diffs/deltas from an interleaved
- * capture of a test clock vs. mach_absolute_time.
+ * capture of a test clock vs. mach_absolute_time.  In the former case, it
+ * also reports the cost per call and the claimed resolution of the clock.
+ *
+ * In addition to the time clocks, the CPU-time clocks can be captured, as
+ * well as getrusage() for comparison with CLOCK_PROCESS_CPUTIME_ID.
  *
  * This tool is intended to be built without legacy-support, but can
  * optionally load the legacy-support library from either the "system"
@@ -40,6 +44,7 @@
 #include <mach/mach_time.h>
 
 #include <sys/param.h>
+#include <sys/resource.h>
 #include <sys/time.h>
 
 /*
@@ -60,6 +65,10 @@ _CLOCK_UPTIME_RAW = 8,
 #define CLOCK_UPTIME_RAW _CLOCK_UPTIME_RAW
 _CLOCK_UPTIME_RAW_APPROX = 9,
 #define CLOCK_UPTIME_RAW_APPROX _CLOCK_UPTIME_RAW_APPROX
+_CLOCK_PROCESS_CPUTIME_ID = 12,
+#define CLOCK_PROCESS_CPUTIME_ID _CLOCK_PROCESS_CPUTIME_ID
+_CLOCK_THREAD_CPUTIME_ID = 16,
+#define CLOCK_THREAD_CPUTIME_ID _CLOCK_THREAD_CPUTIME_ID
 } clockid_t;
 #endif /* CLOCK_REALTIME undef */
 
@@ -91,6 +100,7 @@ _CLOCK_UPTIME_RAW_APPROX = 9,
 typedef uint64_t mach_time_t;
 typedef struct timeval timeval_t;
 typedef struct timespec timespec_t;
+typedef struct rusage rusage_t;
 typedef uint64_t ns_time_t;
 typedef int64_t sns_time_t;
 
@@ -103,6 +113,8 @@ typedef mach_time_t (mach_fn_t)(void);
 typedef int (timeofday_fn_t)(timeval_t *, void *);
 typedef int (gettime_fn_t)(clockid_t, timespec_t *);
 typedef ns_time_t (gettime_ns_fn_t)(clockid_t);
+typedef int (rusage_fn_t)(int, rusage_t *);
+typedef int (getres_fn_t)(clockid_t, timespec_t *);
 
 /*
  * The macros setting up various tables related to clock types are based on
@@ -117,6 +129,7 @@ typedef ns_time_t (gettime_ns_fn_t)(clockid_t);
   CLOCK_TYPE(timeofday,timeval_t) \
   CLOCK_TYPE(gettime,timespec_t) \
   CLOCK_TYPE(gettime_ns,ns_time_t) \
+  CLOCK_TYPE(rusage,rusage_t) \
 
 /* Clock type enums */
 #define CLOCK_TYPE(name,buf) clock_type_##name,
@@ -125,13 +138,14 @@ typedef enum clock_type {
 } clock_type_t;
 #undef CLOCK_TYPE
 
-/* List of non-process-specific clocks */
+/* List of clocks (non-process-specific, plus the CPU-time clocks) */
 /* #define NP_CLOCK(name,type) */
 #define NP_CLOCKS \
   NP_TOD_CLOCKS \
   NP_MACH_CLOCKS \
   NP_GETTIME_CLOCKS(gettime) \
   NP_GETTIME_CLOCKS(gettime_ns) \
+  CPU_CLOCKS \
 
 /* Time of day clock */
 #define NP_TOD_CLOCKS \
@@ -153,6 +167,16 @@ typedef enum clock_type {
   NP_CLOCK(UPTIME_RAW,type) \
   NP_CLOCK(UPTIME_RAW_APPROX,type) \
 
+/* CPU-time clocks, including getrusage() as the reference */
+#define CPU_CLOCKS \
+  NP_CLOCK(rusage,rusage) \
+  CPU_GETTIME_CLOCKS(gettime) \
+  CPU_GETTIME_CLOCKS(gettime_ns) \
+
+#define CPU_GETTIME_CLOCKS(type) \
+  NP_CLOCK(PROCESS_CPUTIME_ID,type) \
+  NP_CLOCK(THREAD_CPUTIME_ID,type) \
+
 #define CALLMAC(a,b,c) a##b(c)
 
 /* Clock type codes */
@@ -160,6 +184,7 @@ typedef enum clock_type {
 #define CLOCK_IDX_mach(name) clock_idx_mach_##name
 #define CLOCK_IDX_gettime(name) clock_idx_gettime_##name
 #define CLOCK_IDX_gettime_ns(name) clock_idx_gettime_ns_##name
+#define CLOCK_IDX_rusage(name) clock_idx_##name
 #define NP_CLOCK(name,type) \
   CALLMAC(CLOCK_IDX_,type,name),
 typedef enum clock_idx {
@@ -170,6 +195,7 @@ typedef enum clock_idx {
 #undef CLOCK_IDX_mach
 #undef CLOCK_IDX_gettime
 #undef CLOCK_IDX_gettime_ns
+#undef CLOCK_IDX_rusage
 
 #define NP_CLOCK(name,type) clock_type_##type,
 static const clock_type_t clock_types[] = {
@@ -182,6 +208,7 @@ static const clock_type_t clock_types[] = {
 #define CLOCK_FUNC_mach(name) "mach_" #name "_time"
 #define CLOCK_FUNC_gettime(name) "clock_gettime"
 #define CLOCK_FUNC_gettime_ns(name) "clock_gettime_nsec_np"
+#define CLOCK_FUNC_rusage(name) "getrusage"
 #define NP_CLOCK(name,type) \
   CALLMAC(CLOCK_FUNC_,type,name),
 static const char * const clock_func_names[] = {
@@ -192,12 +219,14 @@ static const char * const clock_func_names[] = {
 #undef CLOCK_FUNC_mach
 #undef CLOCK_FUNC_gettime
 #undef CLOCK_FUNC_gettime_ns
+#undef CLOCK_FUNC_rusage
 
 /* Arguments for collector functions */
 #define CLOCK_ARG_timeofday(name) 0
 #define CLOCK_ARG_mach(name) 0
 #define CLOCK_ARG_gettime(name) CLOCK_##name
 #define CLOCK_ARG_gettime_ns(name) CLOCK_##name
+#define CLOCK_ARG_rusage(name) 0
 #define NP_CLOCK(name,type) \
   CALLMAC(CLOCK_ARG_,type,name),
 static const clockid_t clock_ids[] = {
@@ -208,12 +237,14 @@ static const clockid_t clock_ids[] = {
 #undef CLOCK_ARG_mach
 #undef CLOCK_ARG_gettime
 #undef CLOCK_ARG_gettime_ns
+#undef CLOCK_ARG_rusage
 
 /* Clock names */
 #define CLOCK_NAME_timeofday(name) "timeofday"
 #define CLOCK_NAME_mach(name) "mach_" #name "_time"
 #define CLOCK_NAME_gettime(name) "CLOCK_" #name
 #define CLOCK_NAME_gettime_ns(name) "CLOCK_" #name "_ns"
+#define CLOCK_NAME_rusage(name) "getrusage"
 #define NP_CLOCK(name,type) \
   CALLMAC(CLOCK_NAME_,type,name),
 static const char * const clock_names[] = {
@@ -225,6 +256,7 @@ static const char * const clock_names[] = {
 #undef CLOCK_NAME_mach
 #undef CLOCK_NAME_gettime
 #undef CLOCK_NAME_gettime_ns
+#undef CLOCK_NAME_rusage
 
 /* Union of clock function pointers */
 #define CLOCK_TYPE(name,valtype) name##_fn_t *name;
@@ -261,6 +293,8 @@ typedef struct clock_info_s {
   histent_t *hbuf;
   histent_t *hbufe;
   sns_time_t mean_diff;
+  double call_ns;
+  sns_time_t res_ns;
 } clock_info_t;
 
 /* Mach clock scale factors */
@@ -273,6 +307,7 @@ static volatile union scratch_u {
   timeval_t timeval;
   timespec_t timespec;
   ns_time_t ns_time;
+  rusage_t rusage;
 } time_scratch;
 
 /* Set up initial parameters in clock_info */
@@ -306,6 +341,12 @@ ts2nsec(timespec_t *ts)
   return ts->tv_sec * BILLION64 + ts->tv_nsec;
 }
 
+static ns_time_t
+ru2nsec(rusage_t *ru)
+{
+  return tv2nsec(&ru->ru_utime) + tv2nsec(&ru->ru_stime);
+}
+
 /* Plus a microsecond conversion */
 static useconds_t
 mt2usec(mach_time_t mach_time)
@@ -425,6 +466,32 @@ clock_find(clock_info_t *ci, void *libhandle, int verbose)
   return NULL;
 }
 
+/* Get the claimed resolution of the clock (-1 if unknown) */
+static void
+clock_find_res(clock_info_t *ci, void *libhandle)
+{
+  getres_fn_t *getres;
+  timespec_t res;
+
+  switch (ci->type) {
+    case clock_type_mach:
+      ci->res_ns = (tbinfo.numer + tbinfo.denom - 1) / tbinfo.denom;
+      break;
+    case clock_type_timeofday:
+    case clock_type_rusage:
+      ci->res_ns = 1000;
+      break;
+    case clock_type_gettime:
+    case clock_type_gettime_ns:
+      ci->res_ns = -1;
+      if ((getres = clock_lookup("clock_getres", &libhandle))
+          && !(*getres)(ci->clkid, &res)) {
+        ci->res_ns = ts2nsec(&res);
+      }
+      break;
+  }
+}
+
 static int
 clock_alloc(clock_info_t *ci)
 {
@@ -487,45 +554,65 @@ clock_collect(clock_info_t *ci)
   clock_bufp_t bufp = ci->b, cbufp = ci->b;
   clock_bufp_t bufe = ci->be;
   ns_time_t *nbp = ci->nsbuf;
+  mach_time_t start, end;
 
   usleepx(ci->sleepus);
 
   #define CLOCK_CALL_mach(type) \
     time_scratch.mach = (*funcp.type)(); \
+    start = mach_absolute_time(); \
     while (bufp.type <= bufe.type) { \
       *bufp.type++ = (*funcp.type)(); \
     } \
+    end = mach_absolute_time(); \
     while (cbufp.type <= bufe.type) { \
       *nbp++ = mt2nsec(*cbufp.type++); \
     } \
     break;
   #define CLOCK_CALL_timeofday(type) \
     (void) (*funcp.type)(bufp.type, NULL); \
+    start = mach_absolute_time(); \
     while (bufp.type <= bufe.type) { \
       if ((ret = (*funcp.type)(bufp.type++, NULL))) return ret; \
     } \
+    end = mach_absolute_time(); \
     while (cbufp.type <= bufe.type) { \
       *nbp++ = tv2nsec(cbufp.type++); \
     } \
     break;
   #define CLOCK_CALL_gettime(type) \
     (void) (*funcp.type)(clkid, bufp.type); \
+    start = mach_absolute_time(); \
     while (bufp.type <= bufe.type) { \
       if ((ret = (*funcp.type)(clkid, bufp.type++))) return ret; \
     } \
+    end = mach_absolute_time(); \
     while (cbufp.type <= bufe.type) { \
       *nbp++ = ts2nsec(cbufp.type++); \
     } \
     break;
   #define CLOCK_CALL_gettime_ns(type) \
     time_scratch.ns_time = (*funcp.type)(clkid); \
+    start = mach_absolute_time(); \
     while (bufp.type <= bufe.type) { \
       if (!(*bufp.type++ = (*funcp.type)(clkid))) return -1; \
     } \
+    end = mach_absolute_time(); \
     while (cbufp.type <= bufe.type) { \
       *nbp++ = *cbufp.type++; \
     } \
     break;
+  #define CLOCK_CALL_rusage(type) \
+    (void) (*funcp.type)(RUSAGE_SELF, bufp.type); \
+    start = mach_absolute_time(); \
+    while (bufp.type <= bufe.type) { \
+      if ((ret = (*funcp.type)(RUSAGE_SELF, bufp.type++))) return ret; \
+    } \
+    end = mach_absolute_time(); \
+    while (cbufp.type <= bufe.type) { \
+      *nbp++ = ru2nsec(cbufp.type++); \
+    } \
+    break;
 
   switch (ci->type) {
     #define CLOCK_TYPE(name,valtyp) case clock_type_##name: \
@@ -538,7 +625,9 @@ clock_collect(clock_info_t *ci)
   #undef CLOCK_CALL_mach
   #undef CLOCK_CALL_gettime
   #undef CLOCK_CALL_gettime_ns
+  #undef CLOCK_CALL_rusage
 
+  ci->call_ns = (double) mt2nsec(end - start) / (ci->numdiffs + 1);
   return 0;
 }
 
@@ -608,6 +697,18 @@ clock_compare(clock_info_t *ci, clock_info_t *rci)
       *nbp++ = *cbufp.type++; \
     } \
     break;
+  #define CLOCK_CALL_rusage(type) \
+    time_scratch.mach = mach_absolute_time(); \
+    (void) (*funcp.type)(RUSAGE_SELF, bufp.type); \
+    *mtrp++ = mach_absolute_time(); \
+    while (bufp.type < bufe.type) { \
+      if ((ret = (*funcp.type)(RUSAGE_SELF, bufp.type++))) return ret; \
+      *mtrp++ = mach_absolute_time(); \
+    } \
+    while (cbufp.type < bufe.type) { \
+      *nbp++ = ru2nsec(cbufp.type++); \
+    } \
+    break;
 
   switch (ci->type) {
     #define CLOCK_TYPE(name,valtyp) case clock_type_##name: \
@@ -620,6 +721,7 @@ clock_compare(clock_info_t *ci, clock_info_t *rci)
   #undef CLOCK_CALL_mach
   #undef CLOCK_CALL_gettime
   #undef CLOCK_CALL_gettime_ns
+  #undef CLOCK_CALL_rusage
 
   while (rmtrp <= mtpe) {
     *rnbp++ = mt2nsec(*rmtrp++);
@@ -810,6 +912,18 @@ dump_hist(clock_info_t *ci, int diffmode, int quiet)
   }
 }
 
+/* Print cost per call and resolution */
+static void
+dump_cost(clock_info_t *ci)
+{
+  printf("Cost of '%s' is %.1f ns/call, ", clock_names[ci->idx], ci->call_ns);
+  if (ci->res_ns < 0) {
+    printf("resolution unknown\n");
+  } else {
+    printf("resolution %lld ns\n", LL ci->res_ns);
+  }
+}
+
 /* Print dual histogram */
 static void
 dump_hist2(clock_info_t *ci, clock_info_t *rci, int quiet)
@@ -997,6 +1111,8 @@ main(int argc, char *argv[])
       if (verbose >= 2) clock_dump_ns(&tci, quiet);
       gen_hist(&tci);
       if (quiet < 2) dump_hist(&tci, 0, quiet);
+      clock_find_res(&tci, libhandle);
+      if (quiet < 2) dump_cost(&tci);
     } else {
       if ((err = clock_compare(&tci, &rci))) {
         perror("Clock compare collection failed");
@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2026 The MacPorts Project
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * This is a benchmark for thread CPU time samples, reporting samples/sec
+ * for the two ways of using thread_info() that the pre-10.10 thread CPU
+ * clock has used:
+ *
+ *   uncached:  mach_thread_self(), thread_info(), mach_port_deallocate()
+ *              for each sample (three traps).
+ *   cached:    thread_info() with a port obtained once (one trap).
+ *
+ * along with clock_gettime() and clock_gettime_nsec_np() for
+ * CLOCK_THREAD_CPUTIME_ID, if available.  On 10.10+, the system versions
+ * of the latter use __thread_selfusage(), and don't use thread_info() at all.
+ *
+ * Like clock_info, this is intended to be built without legacy-support,
+ * but can optionally load the legacy-support library from either the
+ * "system" location or the relative build-tree location.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <mach/mach_init.h>
+#include <mach/mach_port.h>
+#include <mach/mach_time.h>
+#include <mach/thread_act.h>
+
+#include <sys/param.h>
+
+/* Allow builds with <10.12 SDK (as in clock_info) */
+#ifndef CLOCK_REALTIME
+typedef enum {
+_CLOCK_THREAD_CPUTIME_ID = 16
+#define CLOCK_THREAD_CPUTIME_ID _CLOCK_THREAD_CPUTIME_ID
+} clockid_t;
+#endif /* CLOCK_REALTIME undef */
+
+/* RTLD_FIRST is unavailable on 10.4 - make it ignored. */
+#ifndef RTLD_FIRST
+#define RTLD_FIRST 0
+#endif
+
+#define DEF_KSAMPLES 200
+#define MIN_KSAMPLES 1
+#define MAX_KSAMPLES 100000
+
+#ifndef MPPREFIX
+#define MPPREFIX "/opt/local"
+#endif
+#define LIBDIR "lib"
+#define LSLIB "libMacportsLegacySupport.dylib"
+#define MPLSLIB MPPREFIX "/" LIBDIR "/" LSLIB
+#define LOCALLSLIB "../" LIBDIR "/" LSLIB
+
+typedef uint64_t mach_time_t;
+typedef uint64_t ns_time_t;
+
+#define UL (unsigned long)
+
+typedef int (gettime_fn_t)(clockid_t, struct timespec *);
+typedef ns_time_t (gettime_ns_fn_t)(clockid_t);
+
+/* Mach clock scale factor */
+static mach_timebase_info_data_t tbinfo;
+static long double mach2nanos;
+
+/* Bit bucket for results */
+static volatile ns_time_t sample_scratch;
+
+static void *
+load_lib(int legacy, char *progname, int verbose)
+{
+  char *progdir;
+  char lslib[PATH_MAX], lsreal[PATH_MAX];
+  const char *libpath;
+  void *libhandle = NULL;
+
+  if (legacy > 0) {
+    libpath = MPLSLIB;
+  } else {
+    progdir = dirname(progname);
+    (void) snprintf(lslib, sizeof(lslib), "%s/" LOCALLSLIB, progdir);
+    if (!(libpath = realpath(lslib, lsreal))) {
+      fprintf(stderr, "Unable to resolve library path '%s': %s\n",
+              lslib, strerror(errno));
+      return NULL;
+    }
+  }
+  if (!(libhandle = dlopen(libpath, RTLD_FIRST))) {
+    fprintf(stderr, "Unable to open library: %s\n", dlerror());
+    return NULL;
+  }
+  if (verbose) {
+    printf("  Loaded %s, handle = 0x%0*lX\n", libpath,
+           (int) sizeof(void *) * 2, UL libhandle);
+  }
+  return libhandle;
+}
+
+static void *
+clock_lookup(const char *name, void *handle)
+{
+  void *adr;
+
+  /* Try extra library first, then general */
+  if (handle && (adr = dlsym(handle, name))) return adr;
+  return dlsym(RTLD_NEXT, name);
+}
+
+static ns_time_t
+info2nsec(const thread_basic_info_data_t *info)
+{
+  return (info->user_time.seconds + info->system_time.seconds) * 1000000000ULL
+         + (info->user_time.microseconds + info->system_time.microseconds)
+           * 1000ULL;
+}
+
+/* Sample with a fresh port reference each time */
+static int
+sample_uncached(long samples)
+{
+  thread_basic_info_data_t info;
+  mach_msg_type_number_t count;
+  thread_port_t thread;
+  kern_return_t ret;
+
+  while (samples--) {
+    thread = mach_thread_self();
+    count = THREAD_BASIC_INFO_COUNT;
+    ret = thread_info(thread, THREAD_BASIC_INFO, (thread_info_t) &info,
+                      &count);
+    (void) mach_port_deallocate(mach_task_self(), thread);
+    if (ret != KERN_SUCCESS) return -1;
+    sample_scratch = info2nsec(&info);
+  }
+  return 0;
+}
+
+/* Sample with a port reference obtained once */
+static int
+sample_cached(long samples)
+{
+  thread_basic_info_data_t info;
+  mach_msg_type_number_t count;
+  thread_port_t thread = mach_thread_self();
+  kern_return_t ret = KERN_SUCCESS;
+
+  while (samples--) {
+    count = THREAD_BASIC_INFO_COUNT;
+    ret = thread_info(thread, THREAD_BASIC_INFO, (thread_info_t) &info,
+                      &count);
+    if (ret != KERN_SUCCESS) break;
+    sample_scratch = info2nsec(&info);
+  }
+  (void) mach_port_deallocate(mach_task_self(), thread);
+  return ret != KERN_SUCCESS ? -1 : 0;
+}
+
+static int
+sample_gettime(gettime_fn_t *func, long samples)
+{
+  struct timespec ts;
+
+  while (samples--) {
+    if ((*func)(CLOCK_THREAD_CPUTIME_ID, &ts)) return -1;
+    sample_scratch = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  }
+  return 0;
+}
+
+static int
+sample_gettime_ns(gettime_ns_fn_t *func, long samples)
+{
+  while (samples--) {
+    if (!(sample_scratch = (*func)(CLOCK_THREAD_CPUTIME_ID))) return -1;
+  }
+  return 0;
+}
+
+/* Report the rate for one method */
+static void
+report(const char *name, mach_time_t elapsed, long samples, int quiet)
+{
+  double secs = elapsed * mach2nanos / 1E9;
+  double rate = secs > 0 ? samples / secs : 0.0;
+
+  if (quiet) {
+    printf("%s %.0f\n", name, rate);
+  } else {
+    printf("  %-28s %12.0f samples/s %9.1f ns/sample\n",
+           name, rate, rate > 0 ? 1E9 / rate : 0.0);
+  }
+}
+
+static long
+getnum(const char *arg, const char *name, long minval, long maxval)
+{
+  long val;
+  char *cp;
+
+  val = strtol(arg, &cp, 0);
+  if (*cp) {
+    fprintf(stderr, "Bad %s argument.\n", name);
+    exit(20);
+  }
+  if (val < minval || val > maxval) {
+    fprintf(stderr, "Value %ld for %s out of range [%ld:%ld].\n",
+            val, name, minval, maxval);
+    exit(20);
+  }
+  return val;
+}
+
+static void
+usage(FILE *fp, const char *name)
+{
+  fprintf(fp, "Usage is: %s [<opts>] [<thousand samples>]\n", name);
+  fprintf(fp, "  Options:\n");
+  fprintf(fp, "    -h:  This text\n");
+  fprintf(fp, "    -q:  Quiet (one line of numbers per method)\n");
+  fprintf(fp, "    -v:  Verbose output\n");
+  fprintf(fp, "    -y:  Load system legacy-support library\n");
+  fprintf(fp, "    -Y:  Load build-tree legacy-support library\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int argn = 1;
+  int help = 0, quiet = 0, verbose = 0, legacy = 0, err = 0;
+  const char *cp;
+  char chr;
+  char *name = basename(argv[0]);
+  void *libhandle = NULL;
+  gettime_fn_t *gettime;
+  gettime_ns_fn_t *gettime_ns;
+  long samples = DEF_KSAMPLES;
+  mach_time_t start;
+
+  while (argn < argc && argv[argn][0] == '-') {
+    cp = argv[argn];
+    while ((chr = *++cp)) {
+      switch (chr) {
+        case 'h': help = 1; break;
+        case 'q': ++quiet; break;
+        case 'v': ++verbose; break;
+        case 'y': legacy = 1; break;
+        case 'Y': legacy = -1; break;
+      }
+    }
+    ++argn;
+  }
+  if (argn < argc) {
+    samples = getnum(argv[argn], "thousand samples",
+                     MIN_KSAMPLES, MAX_KSAMPLES);
+    ++argn;
+  }
+  samples *= 1000;
+
+  if (help) {
+    usage(stdout, name);
+    return 0;
+  }
+
+  if (mach_timebase_info(&tbinfo)) {
+    perror("Unable to get mach time scale");
+    return 10;
+  }
+  mach2nanos = (long double) tbinfo.numer / tbinfo.denom;
+
+  if (legacy) {
+    if (!(libhandle = load_lib(legacy, argv[0], verbose && !quiet))) return 10;
+  }
+  gettime = (gettime_fn_t *) clock_lookup("clock_gettime", libhandle);
+  gettime_ns = (gettime_ns_fn_t *) clock_lookup("clock_gettime_nsec_np",
+                                                libhandle);
+
+  if (!quiet) printf("%ld thread CPU time samples per method:\n", samples);
+
+  start = mach_absolute_time();
+  if (sample_uncached(samples)) {
+    perror("thread_info (uncached port) failed");
+    err = 1;
+  } else {
+    report("thread_info, uncached port", mach_absolute_time() - start,
+           samples, quiet);
+  }
+
+  start = mach_absolute_time();
+  if (sample_cached(samples)) {
+    perror("thread_info (cached port) failed");
+    err = 1;
+  } else {
+    report("thread_info, cached port", mach_absolute_time() - start,
+           samples, quiet);
+  }
+
+  if (gettime) {
+    start = mach_absolute_time();
+    if (sample_gettime(gettime, samples)) {
+      perror("clock_gettime failed");
+      err = 1;
+    } else {
+      report("clock_gettime", mach_absolute_time() - start, samples, quiet);
+    }
+  } else if (verbose && !quiet) {
+    printf("  clock_gettime is unavailable\n");
+  }
+
+  if (gettime_ns) {
+    start = mach_absolute_time();
+    if (sample_gettime_ns(gettime_ns, samples)) {
+      perror("clock_gettime_nsec_np failed");
+      err = 1;
+    } else {
+      report("clock_gettime_nsec_np", mach_absolute_time() - start,
+             samples, quiet);
+    }
+  } else if (verbose && !quiet) {
+    printf("  clock_gettime_nsec_np is unavailable\n");
+  }
+
+  if (libhandle) (void) dlclose(libhandle);
+
+  if (!quiet) printf("%s %s.\n", name, err ? "failed" : "completed");
+  return err;
+}
@@ -227,6 +227,7 @@ int wcpcpy = 0;
 int wcpncpy = 0;
 int wcscasecmp = 0;
 int wcsncasecmp = 0;
+int open_wmemstream = 0;
 #endif /* __DARWIN_C_LEVEL < 200809L */
 
 /* xlocale/_wchar.h via wchar.h */